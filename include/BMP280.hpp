@@ -44,6 +44,92 @@
 #define BMP280_REG_DIG_P9_LSB _u(0x9E)
 #define BMP280_REG_DIG_P9_MSB _u(0x9F)
 
+#define BMP280_REG_STATUS _u(0xF3)
+
+enum bmp280_oversampling
+{
+    BMP280_OVERSAMPLING_SKIP = 0,
+    BMP280_OVERSAMPLING_X1 = 1,
+    BMP280_OVERSAMPLING_X2 = 2,
+    BMP280_OVERSAMPLING_X4 = 3,
+    BMP280_OVERSAMPLING_X8 = 4,
+    BMP280_OVERSAMPLING_X16 = 5
+};
+
+enum bmp280_filter
+{
+    BMP280_FILTER_OFF = 0,
+    BMP280_FILTER_2 = 1,
+    BMP280_FILTER_4 = 2,
+    BMP280_FILTER_8 = 3,
+    BMP280_FILTER_16 = 4
+};
+
+// Inactive time between two normal mode measurements
+enum bmp280_standby
+{
+    BMP280_STANDBY_0_5MS = 0,
+    BMP280_STANDBY_62_5MS = 1,
+    BMP280_STANDBY_125MS = 2,
+    BMP280_STANDBY_250MS = 3,
+    BMP280_STANDBY_500MS = 4,
+    BMP280_STANDBY_1000MS = 5,
+    BMP280_STANDBY_2000MS = 6,
+    BMP280_STANDBY_4000MS = 7
+};
+
+enum bmp280_mode
+{
+    BMP280_MODE_SLEEP = 0,
+    BMP280_MODE_FORCED = 1,
+    BMP280_MODE_NORMAL = 3
+};
+
+struct bmp280_profile
+{
+    bmp280_oversampling temp_oversampling;
+    bmp280_oversampling pressure_oversampling;
+    bmp280_filter filter;
+    bmp280_standby standby;
+} typedef bmp280_profile_t;
+
+// Datasheet use cases: lowest latency for the boost, standard, and the most resolution for the slow phases
+constexpr bmp280_profile_t BMP280_PROFILE_ASCENT = {BMP280_OVERSAMPLING_X1, BMP280_OVERSAMPLING_X1, BMP280_FILTER_OFF, BMP280_STANDBY_0_5MS};
+constexpr bmp280_profile_t BMP280_PROFILE_STANDARD = {BMP280_OVERSAMPLING_X1, BMP280_OVERSAMPLING_X4, BMP280_FILTER_4, BMP280_STANDBY_0_5MS};
+constexpr bmp280_profile_t BMP280_PROFILE_APOGEE = {BMP280_OVERSAMPLING_X1, BMP280_OVERSAMPLING_X8, BMP280_FILTER_4, BMP280_STANDBY_0_5MS};
+constexpr bmp280_profile_t BMP280_PROFILE_PAD = {BMP280_OVERSAMPLING_X2, BMP280_OVERSAMPLING_X16, BMP280_FILTER_16, BMP280_STANDBY_0_5MS};
+
+constexpr uint32_t bmp280_oversampling_count(bmp280_oversampling oversampling) {
+    return oversampling == BMP280_OVERSAMPLING_SKIP ? 0 : 1u << (oversampling - 1);
+}
+
+// Datasheet maximum conversion time: 1.25ms + 2.3ms per temperature and pressure sample + 0.575ms with pressure
+constexpr uint32_t bmp280_measurement_time_us(const bmp280_profile_t& profile) {
+    return 1250 + 2300 * bmp280_oversampling_count(profile.temp_oversampling)
+        + 2300 * bmp280_oversampling_count(profile.pressure_oversampling)
+        + (profile.pressure_oversampling == BMP280_OVERSAMPLING_SKIP ? 0 : 575);
+}
+
+constexpr uint32_t bmp280_standby_time_us(bmp280_standby standby) {
+    return standby == BMP280_STANDBY_0_5MS ? 500 : 62500u << (standby - 1);
+}
+
+// Datasheet typical conversion time: 1ms + 2ms per temperature and pressure sample + 0.5ms with pressure
+constexpr uint32_t bmp280_measurement_time_typ_us(const bmp280_profile_t& profile) {
+    return 1000 + 2000 * bmp280_oversampling_count(profile.temp_oversampling)
+        + 2000 * bmp280_oversampling_count(profile.pressure_oversampling)
+        + (profile.pressure_oversampling == BMP280_OVERSAMPLING_SKIP ? 0 : 500);
+}
+
+// Time between two results in normal mode, at most and typically
+constexpr uint32_t bmp280_measurement_period_us(const bmp280_profile_t& profile) {
+    return bmp280_measurement_time_us(profile) + bmp280_standby_time_us(profile.standby);
+}
+
+constexpr uint32_t bmp280_measurement_period_typ_us(const bmp280_profile_t& profile) {
+    return bmp280_measurement_time_typ_us(profile) + bmp280_standby_time_us(profile.standby);
+}
+
 struct BMP280_calib_param {
     uint16_t dig_T1;
     int16_t dig_T2;
@@ -60,24 +146,161 @@ struct BMP280_calib_param {
     int16_t dig_P9;
 };
 
+// Datasheet 64 bits compensation, Pa in Q24.8. Signed shifts are multiplies to stay constexpr.
+constexpr uint32_t bmp280_compensate_pressure_64(const BMP280_calib_param& calib, int32_t raw_pressure, int32_t fine_temp) {
+    int64_t var1 = 0, var2 = 0, p = 0;
+    var1 = ((int64_t)fine_temp) - 128000;
+    var2 = (var1 * var1 * ((int64_t)calib.dig_P6));
+    var2 += var1 * ((int64_t)calib.dig_P5) * ((int64_t)1 << 17);
+    var2 += ((int64_t)calib.dig_P4) * ((int64_t)1 << 35);
+    var1 = ((var1 * var1 * (int64_t)calib.dig_P3) >> 8) + var1 * (int32_t)calib.dig_P2 * 4096;
+    var1 = (((((int64_t)1)<<47)+var1))*((int64_t)calib.dig_P1)>>33;
+    if (var1 == 0) {
+        return 0;  // avoid exception caused by division by zero
+    }
+    p = 1048576-raw_pressure;
+    p = ((p * ((int64_t)1 << 31) - var2) * 3125) / var1;
+    var1 = (((int64_t)calib.dig_P9) * (p>>13) * (p>>13)) >> 25;
+    var2 =  (((int64_t)calib.dig_P8) * p) >> 19;
+    return (uint32_t)((p + var1 + var2) >> 8) + ((int64_t)calib.dig_P7) * 16;
+}
+
+// Datasheet 32 bits compensation, whole Pa. No multi-word multiply and a single 32 bits division,
+// within 5.9Pa of the 64 bits one from 300 to 1100hPa and -25 to 62 degC (1.2Pa on average).
+constexpr uint32_t bmp280_compensate_pressure_32(const BMP280_calib_param& calib, int32_t raw_pressure, int32_t fine_temp) {
+    int32_t var1 = 0, var2 = 0;
+    uint32_t p = 0;
+    var1 = (fine_temp >> 1) - 64000;
+    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)calib.dig_P6);
+    var2 = var2 + var1 * ((int32_t)calib.dig_P5) * 2;
+    var2 = (var2 >> 2) + ((int32_t)calib.dig_P4) * 65536;
+    var1 = (((calib.dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t)calib.dig_P2) * var1) >> 1)) >> 18;
+    var1 = ((32768 + var1) * ((int32_t)calib.dig_P1)) >> 15;
+    if (var1 == 0) {
+        return 0;  // avoid exception caused by division by zero
+    }
+    p = ((uint32_t)(1048576 - raw_pressure) - (var2 >> 12)) * 3125;
+    if (p < 0x80000000) p = (p << 1) / (uint32_t)var1;
+    else p = (p / (uint32_t)var1) * 2;
+    var1 = (((int32_t)calib.dig_P9) * ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
+    var2 = (((int32_t)(p >> 2)) * ((int32_t)calib.dig_P8)) >> 13;
+    return (uint32_t)((int32_t)p + ((var1 + var2 + calib.dig_P7) >> 4));
+}
+
+// Layout of the 24 bytes calibration block starting at BMP280_REG_DIG_T1_LSB
+struct bmp280_calib_map {
+    typedef RegisterField<0, 2, REGISTER_LSB_FIRST, false> dig_T1;
+    typedef RegisterField<2, 2, REGISTER_LSB_FIRST, true> dig_T2;
+    typedef RegisterField<4, 2, REGISTER_LSB_FIRST, true> dig_T3;
+    typedef RegisterField<6, 2, REGISTER_LSB_FIRST, false> dig_P1;
+    typedef RegisterField<8, 2, REGISTER_LSB_FIRST, true> dig_P2;
+    typedef RegisterField<10, 2, REGISTER_LSB_FIRST, true> dig_P3;
+    typedef RegisterField<12, 2, REGISTER_LSB_FIRST, true> dig_P4;
+    typedef RegisterField<14, 2, REGISTER_LSB_FIRST, true> dig_P5;
+    typedef RegisterField<16, 2, REGISTER_LSB_FIRST, true> dig_P6;
+    typedef RegisterField<18, 2, REGISTER_LSB_FIRST, true> dig_P7;
+    typedef RegisterField<20, 2, REGISTER_LSB_FIRST, true> dig_P8;
+    typedef RegisterField<22, 2, REGISTER_LSB_FIRST, true> dig_P9;
+
+    static constexpr uint8_t size = 24;
+};
+
+// Layout of the burst read starting at BMP280_REG_PRESSURE_MSB, both values are 20 bits left aligned
+struct bmp280_burst_map {
+    typedef RegisterField<0, 3, REGISTER_MSB_FIRST, false, 4> pressure;
+    typedef RegisterField<3, 3, REGISTER_MSB_FIRST, false, 4> temp;
+
+    static constexpr uint8_t size = 6;
+};
+
+// Integer outputs of the datasheet compensation, the raw ADC counts mean nothing without
+// the calibration block of the part. BMP280::to_celsius and to_pascal give SI units.
 struct BMP280_DATA {
-    float temp;
-    float pressure;
+    // 0.01 degC
+    int32_t temp;
+    // Pa in Q24.8
+    uint32_t pressure;
+    // Estimated end of the conversion, us since boot
+    uint64_t timestamp;
+    // Start of a forced mode conversion, 0 in normal mode
+    uint64_t trigger_time;
+    // The last read brought a new conversion
+    bool fresh;
 };
 
+// Datasheet 32 bits pressure compensation instead of the 64 bits one: no multi-word multiplies on
+// the M0+, whole Pa resolution (~8cm at sea level, under the sensor noise)
+#ifndef BMP280_COMPENSATION_32BIT
+#define BMP280_COMPENSATION_32BIT 0
+#endif
+
+// Reads per result period, a new result is caught within a quarter period of its conversion
+#define BMP280_POLLS_PER_RESULT 4
+
 class BMP280: public I2cSensor<BMP280_DATA> {
     BMP280_calib_param calib_param;
-    
+    std::array<uint8_t, bmp280_burst_map::size> burst;
+    bmp280_profile_t profile;
+    bmp280_mode mode = BMP280_MODE_NORMAL;
+
+    // Conversion schedule, rebuilt from the reads that bring a new result
+    std::array<uint8_t, bmp280_burst_map::size> last_raw;
+    bool has_result = false;
+    uint64_t read_time = 0;
+    uint64_t last_read_time = 0;
+    // Earliest end of the last conversion, the next one cannot end before a typical period after it
+    uint64_t conversion_time = 0;
+    uint32_t stale_reads = 0;
+
+    // Forced mode conversion waiting to be read
+    bool triggered = false;
+    uint64_t trigger_time = 0;
+
+    uint8_t get_ctrl_meas();
+    void reset_schedule();
+    bool is_conversion_due();
+
+    // Compensate only a new conversion, false for a re-read of the previous one
+    bool decode_burst();
+    bool compensate_burst();
+
     public:
     BMP280();
     BMP280(uint8_t addr);
+    BMP280(uint8_t addr, I2cBus *bus);
     void init() override;
-    bool update();
+    i2c_status update();
+    bool start_update();
+    bool submit_read() override;
+    bool complete_update() override;
+    uint8_t get_burst_length() override { return this->burst.size(); }
     bool test_connection() override;
+    // Compensate a burst read by someone else at timestamp, e.g. mirrored by the MPU6050 auxiliary master
+    bool decode_mirrored(const uint8_t* burst, uint64_t timestamp);
+    // Reads that found the previous conversion again
+    uint32_t get_stale_reads() { return this->stale_reads; }
+
+    // Switch oversampling, filter and standby at runtime, three register writes. The poll rate
+    // follows the new measurement period, I2cScheduler::update_periods picks it up.
+    // Polls only turn into reads once a new conversion can be done.
+    void set_profile(const bmp280_profile_t& profile);
+    const bmp280_profile_t& get_profile() { return this->profile; }
+
+    // Normal mode free-runs. Forced mode sleeps until trigger, the result is read once it is
+    // guaranteed done and carries both the trigger and the estimated completion time.
+    void set_mode(bmp280_mode mode);
+    bmp280_mode get_mode() { return this->mode; }
+    // Start a forced conversion, I2C_BUSY until the previous one is read
+    i2c_status trigger();
+    bool is_triggered() { return this->triggered; }
+    uint32_t get_measurement_period_us() { return bmp280_measurement_period_us(this->profile); }
 
     void fetchCalibParams();
     int32_t compute_fine_res_temperature(int32_t raw_temp);
     int32_t compensate_pressure(int32_t raw_pressure, int32_t fine_temp);
+
+    static float to_celsius(int32_t temp) { return temp / 100.0f; }
+    static float to_pascal(uint32_t pressure) { return pressure / 256.0f; }
 };
 
 #endif
\ No newline at end of file
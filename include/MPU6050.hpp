@@ -1,7 +1,9 @@
 #ifndef MPU6050_HPP
 #define MPU6050_HPP
 
+#include "hardware/gpio.h"
 #include "i2c_sensor.hpp"
+#include "fixed_point.hpp"
 
 #define MPU_REG_SELF_TEST_X 0x0D
 #define MPU_REG_SELF_TEST_Y 0x0E
@@ -11,6 +13,8 @@
 #define MPU_REG_CONFIG 0x1A
 #define MPU_REG_GYRO_CONFIG 0x1B
 #define MPU_REG_ACCEL_CONFIG 0x1C
+#define MPU_REG_MOT_THR 0x1F
+#define MPU_REG_MOT_DUR 0x20
 #define MPU_REG_FIFO_EN 0x23
 #define MPU_REG_I2C_MST_CTRL 0x24
 #define MPU_REG_I2C_SLV0_ADDR 0x25
@@ -79,7 +83,6 @@
 #define MPU_REG_RL 0x67
 #define MPU_REG_SIGNAL_PATH_RES ET 0x68
 #define MPU_REG_USER_CTRL 0x6A
-#define MPU_REG_USER_CTRL 0x6A
 #define MPU_REG_PWR_MGMT_1 0x6B
 #define MPU_REG_PWR_MGMT_2 0x6C
 #define MPU_REG_FIFO_COUNTH 0x72
@@ -91,6 +94,65 @@
 #define MPU_DEFAULT_I2C_FREQ 1000
 #define MPU_AD0_I2C_ADDR 0x69
 
+#define MPU_INT_PIN_CFG_RD_CLEAR 0b00010000
+#define MPU_INT_PIN_CFG_I2C_BYPASS_EN 0b00000010
+#define MPU_INT_ENABLE_DATA_RDY 0b00000001
+#define MPU_INT_ENABLE_MOT 0b01000000
+
+// Motion wake-up: accel only cycle mode, the gyros and temperature sensor are off
+#define MPU_PWR_MGMT_1_CYCLE 0b00100000
+#define MPU_PWR_MGMT_1_TEMP_DIS 0b00001000
+#define MPU_PWR_MGMT_2_STBY_GYRO 0b00000111
+#define MPU_ACCEL_CONFIG_HPF_5HZ 0b00000001
+// MOT_THR is 2mg per LSB, MOT_DUR 1ms per LSB
+#define MPU_MOT_THR_MG_PER_LSB 2
+
+#define MPU_FIFO_SIZE 1024
+#define MPU_FIFO_EN_TEMP 0b10000000
+#define MPU_FIFO_EN_GYRO 0b01110000
+#define MPU_FIFO_EN_ACCEL 0b00001000
+#define MPU_USER_CTRL_FIFO_EN 0b01000000
+#define MPU_USER_CTRL_FIFO_RESET 0b00000100
+#define MPU_FIFO_EN_SLV0 0b00000001
+
+// Auxiliary I2C master, slave 0 mirrors up to MPU_EXT_SENS_DATA_SIZE bytes after every sample
+#define MPU_EXT_SENS_DATA_SIZE 24
+#define MPU_USER_CTRL_I2C_MST_EN 0b00100000
+#define MPU_I2C_MST_CTRL_WAIT_FOR_ES 0b01000000
+#define MPU_I2C_MST_CLK_400KHZ 13
+#define MPU_I2C_SLV_READ 0b10000000
+#define MPU_I2C_SLV_EN 0b10000000
+// Samples drained by one FIFO read, a record has the same layout as the burst read
+#define MPU_FIFO_BATCH_SAMPLES 16
+// PWR_MGMT_2 LP_WAKE_CTRL, accelerometer samples per second in cycle mode
+enum mpu_6050_wake_rate
+{
+    MPU6050_WAKE_1_25HZ = 0,
+    MPU6050_WAKE_5HZ = 1,
+    MPU6050_WAKE_20HZ = 2,
+    MPU6050_WAKE_40HZ = 3
+};
+
+// Self-test: both configs enable the three axes, the gyro at 250dps and the accel at 8g
+#define MPU_GYRO_CONFIG_SELF_TEST 0b11100000
+#define MPU_ACCEL_CONFIG_SELF_TEST 0b11110000
+#define MPU_SELF_TEST_SAMPLES 16
+#define MPU_SELF_TEST_SETTLE_US 100000
+// Largest deviation of the self-test response from the factory trim
+#define MPU_SELF_TEST_TOLERANCE_PERCENT 14
+
+// Largest gap between a stored gyro bias and the boot verification pass before a full calibration
+#define MPU_BIAS_TOLERANCE_DPS 1.0f
+// Two calibrations at least 5degC apart (340 counts per degC) give the gyro temperature drift.
+// A steeper drift than the datasheet +-20dps over -40 to 85degC means the bias moved for another reason.
+#define MPU_TEMP_COEFF_MIN_DELTA 1700
+#define MPU_TEMP_COEFF_MAX_DPS_PER_C 0.25f
+// 6-position accel calibration: a face is taken when one axis reads 1g and the others 0g, within
+// the tolerance. Results past the datasheet 3% sensitivity and 80mg zero-g offset, with margin, are refused.
+#define MPU_ACCEL_POSITION_TOLERANCE_MG 150
+#define MPU_ACCEL_SCALE_MAX_ERROR_PERCENT 10
+#define MPU_ACCEL_OFFSET_MAX_MG 200
+
 enum mpu_6050_scale
 {
     MPU6050_SCALE_250DPS = 0,
@@ -107,37 +169,287 @@ enum mpu_6050_range
     MPU6050_RANGE_16G = 3,
 };
 
+// CONFIG DLPF_CFG, named after the accelerometer bandwidth (gyro: 256, 188, 98, 42, 20, 10, 5Hz)
+enum mpu_6050_dlpf
+{
+    MPU6050_DLPF_260HZ = 0,
+    MPU6050_DLPF_184HZ = 1,
+    MPU6050_DLPF_94HZ = 2,
+    MPU6050_DLPF_44HZ = 3,
+    MPU6050_DLPF_21HZ = 4,
+    MPU6050_DLPF_10HZ = 5,
+    MPU6050_DLPF_5HZ = 6
+};
+
+// The gyro output runs at 8kHz with the filter bypassed and 1kHz otherwise, SMPLRT_DIV divides it down
+constexpr uint32_t mpu6050_gyro_rate_hz(mpu_6050_dlpf dlpf) {
+    return dlpf == MPU6050_DLPF_260HZ ? 8000 : 1000;
+}
+
+constexpr uint32_t mpu6050_sample_rate_hz(mpu_6050_dlpf dlpf, uint8_t sample_rate_div) {
+    return mpu6050_gyro_rate_hz(dlpf) / (1 + sample_rate_div);
+}
+
 struct mpu_6050_config
 {
     mpu_6050_scale scale;
     float dps_per_digit;
+    int32_t mdps_per_digit_q16;
 
     mpu_6050_range range;
     float range_per_digit;
+    int32_t mg_per_digit_q16;
+
+    mpu_6050_dlpf dlpf;
+    uint8_t sample_rate_div;
+    // Output data rate derived from dlpf and sample_rate_div
+    uint32_t sample_rate_hz;
 
-    vector3<float> gyro_offset;
+    vector3<int16_t> gyro_offset;
+    // Gyro bias drift in gyro counts per temperature count, Q16, from calibration_temp
+    vector3<int32_t> gyro_temp_coeff_q16;
+    int16_t calibration_temp;
+    // Accel zero-g offset in counts, removed before the Q16 sensitivity correction
+    vector3<int16_t> acc_offset;
+    vector3<int32_t> acc_scale_q16;
 } typedef mpu6050_config_t;
 
+// Face of the 6-position accel calibration, named after the axis pointing up
+enum mpu6050_accel_position
+{
+    MPU6050_ACCEL_X_UP,
+    MPU6050_ACCEL_X_DOWN,
+    MPU6050_ACCEL_Y_UP,
+    MPU6050_ACCEL_Y_DOWN,
+    MPU6050_ACCEL_Z_UP,
+    MPU6050_ACCEL_Z_DOWN,
+    MPU6050_ACCEL_POSITION_NONE
+};
+
+enum mpu6050_self_test_state
+{
+    MPU6050_SELF_TEST_IDLE,
+    MPU6050_SELF_TEST_SETTLE,
+    MPU6050_SELF_TEST_MEASURE,
+    MPU6050_SELF_TEST_SETTLE_ENABLED,
+    MPU6050_SELF_TEST_MEASURE_ENABLED,
+    MPU6050_SELF_TEST_DONE
+};
+
+struct mpu6050_self_test
+{
+    mpu6050_self_test_state state;
+    uint64_t next_time;
+    uint8_t samples;
+    // Output sums with the self-test off then on
+    vector3<int32_t> acc_sum[2];
+    vector3<int32_t> gyro_sum[2];
+
+    // Deviation of the self-test response from the factory trim, in percent
+    vector3<int16_t> acc_deviation;
+    vector3<int16_t> gyro_deviation;
+    bool passed;
+} typedef mpu6050_self_test_t;
+
+// Everything MPU6050::calibrate and the 6-position accel calibration measure, in counts of the
+// scale and range they were taken at. This is what the calibration store persists between boots.
+struct mpu6050_calibration
+{
+    uint8_t scale;
+    uint8_t range;
+    int16_t temp;
+    vector3<int16_t> gyro_offset;
+    vector3<int32_t> gyro_temp_coeff_q16;
+    vector3<int16_t> acc_offset;
+    vector3<int32_t> acc_scale_q16;
+} typedef mpu6050_calibration_t;
+
+// Counts, the gyro has its bias removed and the accel its offset and sensitivity error.
+// MPU6050::to_mg, to_mdps and to_centi_celsius convert them to integer mg, mdps and centi-degC.
 struct MPU6050_DATA
 {
-    vector3<float> acc;
-    vector3<float> gyro;
-    float temp;
+    vector3<int16_t> acc;
+    vector3<int16_t> gyro;
+    int16_t temp;
+    uint64_t timestamp;
 } typedef MPU6050_DATA;
 
 
+// Layout of the burst read starting at MPU_REG_ACCEL_XOUT_H
+struct mpu6050_burst_map
+{
+    typedef RegisterField<0, 2, REGISTER_MSB_FIRST, true> acc_x;
+    typedef RegisterField<2, 2, REGISTER_MSB_FIRST, true> acc_y;
+    typedef RegisterField<4, 2, REGISTER_MSB_FIRST, true> acc_z;
+    typedef RegisterField<6, 2, REGISTER_MSB_FIRST, true> temp;
+    typedef RegisterField<8, 2, REGISTER_MSB_FIRST, true> gyro_x;
+    typedef RegisterField<10, 2, REGISTER_MSB_FIRST, true> gyro_y;
+    typedef RegisterField<12, 2, REGISTER_MSB_FIRST, true> gyro_z;
+
+    static constexpr uint8_t size = 14;
+};
+
+struct mpu6050_fifo_count_map
+{
+    typedef RegisterField<0, 2, REGISTER_MSB_FIRST, false> count;
+
+    static constexpr uint8_t size = 2;
+};
+
+// Samples drained from the FIFO in one read, oldest first and evenly spaced by the sample period
+struct mpu6050_batch
+{
+    MPU6050_DATA samples[MPU_FIFO_BATCH_SAMPLES];
+    uint8_t count;
+    // Samples were lost between the previous batch and this one
+    bool overflow;
+} typedef mpu6050_batch_t;
+
 class MPU6050: public I2cSensor<MPU6050_DATA>{
     mpu6050_config_t config;
+    // Burst registers followed by the EXT_SENS_DATA mirrored by the auxiliary master
+    std::array<uint8_t, mpu6050_burst_map::size + MPU_EXT_SENS_DATA_SIZE> burst;
+    uint8_t ext_length = 0;
+    // Bytes per sample of a burst or a FIFO record, ext data included
+    uint8_t record_size = mpu6050_burst_map::size;
+    uint8_t user_ctrl = 0;
+    // Rate asked for at construction, reads never go faster than the output data rate
+    uint16_t requested_freq;
+
+    int data_ready_gpio = -1;
+    volatile bool data_ready = false;
+    // Set by the GPIO interrupt. A 64 bits value is two accesses on the M0+, it is read with
+    // interrupts masked so an interrupt cannot land between the halves.
+    volatile uint64_t data_ready_time = 0;
+    volatile uint32_t data_ready_overruns = 0;
+    int motion_gpio = -1;
+    int saved_data_ready_gpio = -1;
+    mpu_6050_wake_rate wake_rate = MPU6050_WAKE_5HZ;
+    volatile bool motion_detected = false;
+    // Read masked like data_ready_time
+    volatile uint64_t motion_time = 0;
+    uint64_t sample_time = 0;
+
+    bool fifo_enabled = false;
+    bool fifo_reading_count = false;
+    std::array<uint8_t, mpu6050_fifo_count_map::size> fifo_count;
+    std::array<uint8_t, MPU_FIFO_BATCH_SAMPLES * mpu6050_burst_map::size> fifo_records;
+    uint16_t fifo_available = 0;
+    uint32_t sample_period_us = 1000;
+    uint64_t fifo_next_time = 0;
+    bool fifo_overflowed = false;
+    uint32_t fifo_overflows = 0;
+
+    static MPU6050* irq_instance;
+    static void gpio_irq_handler(uint gpio, uint32_t events);
+
+    void take_sample_time();
+    void decode_burst();
+    void decode_acc(const uint8_t* record, MPU6050_DATA& sample);
+    void decode_temp(const uint8_t* record, MPU6050_DATA& sample);
+    void decode_gyro(const uint8_t* record, MPU6050_DATA& sample);
+
+    mpu6050_self_test_t self_test = {};
+    void accumulate_self_test(uint8_t index);
+    void finish_self_test();
+
+    // Mean gyro counts and temperature over samples, read at the output data rate
+    void measure_gyro_bias(uint16_t samples, vector3<int16_t>& bias, int16_t& temp);
+    // Mean raw accel counts over samples, read at the output data rate
+    void measure_acc_mean(uint16_t samples, vector3<int16_t>& mean);
+
+    // Reading of the axis along gravity on each captured face, bit i of accel_positions set once face i is taken
+    int16_t accel_position_means[MPU6050_ACCEL_POSITION_NONE];
+    uint8_t accel_positions = 0;
+
+    void update_read_rate();
+    uint8_t fifo_batch_samples() { return this->fifo_records.size() / this->record_size < MPU_FIFO_BATCH_SAMPLES ? this->fifo_records.size() / this->record_size : MPU_FIFO_BATCH_SAMPLES; }
+    void reset_fifo();
+    // Return how many samples to read, 0 if there are none or the FIFO overflowed
+    uint8_t decode_fifo_count();
+    void decode_fifo_batch(uint8_t samples);
 
 public:
+    // Filled by FIFO reads, data then holds the newest sample of the batch
+    mpu6050_batch_t batch = {};
+
     MPU6050();
-    MPU6050(uint8_t addr, uint8_t freq);
+    MPU6050(uint8_t addr, uint16_t freq);
     MPU6050(uint8_t addr, i2c_inst_t *i2c_port);
+    MPU6050(uint8_t addr, uint16_t freq, I2cBus *bus);
     void init() override;
-    bool update();
+    i2c_status update();
+    bool start_update();
+    bool submit_read() override;
+    bool complete_update() override;
+    uint8_t get_burst_length() override { return this->fifo_enabled ? this->fifo_batch_samples() * this->record_size : this->record_size; }
     bool test_connection() override;
 
-    void calibrate(uint16_t samples);
+    // Switch to FIFO reads: every update drains up to MPU_FIFO_BATCH_SAMPLES samples into batch, fewer when
+    // the records carry auxiliary slave bytes.
+    // The read rate drops to twice per batch worth of samples and the data ready interrupt is released.
+    void enable_fifo();
+    bool is_fifo_enabled() { return this->fifo_enabled; }
+    uint32_t get_fifo_overflows() { return this->fifo_overflows; }
+
+    // Let the host reach the auxiliary bus directly, to set up a slave before mirroring it
+    void set_aux_bypass(bool bypass);
+    // Have the auxiliary master read len bytes from reg of the slave after every sample. They come back
+    // with the same burst or FIFO record as the motion data, get_ext_data holds those of the newest sample.
+    void enable_aux_slave(uint8_t slave_addr, uint8_t reg, uint8_t len);
+    const uint8_t* get_ext_data() { return this->burst.data() + mpu6050_burst_map::size; }
+
+    // Route the sensor data ready pulse to gpio, each sample is then read exactly once
+    void enable_data_ready_interrupt(uint gpio);
+    // Called from the GPIO interrupt, or by hand to drive the sensor without hardware
+    void on_data_ready(uint64_t timestamp);
+    bool is_interrupt_driven() override { return this->data_ready_gpio >= 0; }
+    bool is_data_ready() override { return this->data_ready; }
+    uint32_t get_data_ready_overruns() { return this->data_ready_overruns; }
+
+    // Low power wait: accel only cycle mode, a motion interrupt on gpio once a sample moves more than
+    // threshold_mg from the high passed reference for duration_ms. Data ready is released meanwhile.
+    void enable_motion_wakeup(uint gpio, uint16_t threshold_mg, uint8_t duration_ms, mpu_6050_wake_rate rate);
+    // Back to full rate sampling in the mode used before, FIFO or data ready
+    void disable_motion_wakeup();
+    // Gyros and temperature on at the full output data rate while the motion interrupt stays armed,
+    // for a bias estimation window during the wait. Off goes back to the accel only cycle mode.
+    void set_motion_wakeup_gyro(bool enabled);
+    bool is_motion_detected() { return this->motion_detected; }
+    uint64_t get_motion_time();
+
+    // Full gyro bias calibration, the sensor must be still. Takes samples / ODR seconds.
+    // The accel terms are left as they are. With a previous calibration of the same scale the bias change between the two gives the
+    // temperature drift, or keeps the previous one when the temperatures are too close.
+    void calibrate(uint16_t samples, const mpu6050_calibration_t* previous = nullptr);
+    // Short pass checking a stored calibration still holds, it is applied when it does.
+    // Fails on a scale or range mismatch or a bias further than MPU_BIAS_TOLERANCE_DPS.
+    bool verify_calibration(const mpu6050_calibration_t& calibration, uint16_t samples);
+    // The accel terms only apply at the range they were taken at, identity otherwise
+    void set_calibration(const mpu6050_calibration_t& calibration);
+    // Bias at the calibration temperature, for the online estimator to move it while still
+    void set_gyro_offset(const vector3<int16_t>& offset) { this->config.gyro_offset = offset; }
+    mpu6050_calibration_t get_calibration();
+
+    // 6-position accel calibration: start it, then rest the board on each of its faces in any order
+    // and call add_accel_position, which takes samples / ODR seconds. It returns the face taken, or
+    // MPU6050_ACCEL_POSITION_NONE when no axis is along gravity. A face taken again replaces the first.
+    void start_accel_calibration();
+    mpu6050_accel_position add_accel_position(uint16_t samples);
+    bool is_accel_calibration_complete() { return this->accel_positions == (1 << MPU6050_ACCEL_POSITION_NONE) - 1; }
+    // Offset and scale of each axis from its up and down readings. Nothing is applied and false is
+    // returned with a face missing or a result past MPU_ACCEL_SCALE_MAX_ERROR_PERCENT or MPU_ACCEL_OFFSET_MAX_MG.
+    bool finish_accel_calibration();
+
+    // Hardware self-test as a state machine: start it, then call step_self_test from the other init work
+    // until it reports MPU6050_SELF_TEST_DONE. Each step costs at most one sample read.
+    // The scale and range are restored at the end, the sensor is not usable meanwhile.
+    void start_self_test();
+    mpu6050_self_test_state step_self_test();
+    const mpu6050_self_test_t& get_self_test() { return this->self_test; }
+    // Expected self-test response in counts, at 250dps and 8g, from the 5 bits SELF_TEST_* codes
+    static float gyro_factory_trim(uint8_t code);
+    static float accel_factory_trim(uint8_t code);
 
     void update_only_acc();
     void update_only_temp();
@@ -145,6 +457,15 @@ public:
 
     void set_gyro_scale(mpu_6050_scale scale);
     void set_accel_range(mpu_6050_range range);
+    // Set the filter bandwidth and the output data rate, the read rate follows the new rate
+    void set_sample_rate(mpu_6050_dlpf dlpf, uint8_t sample_rate_div);
+    const mpu6050_config_t& get_config() { return this->config; }
+
+    // Unit conversions for the consumers that need them, fixed-point so a sample costs no division
+    int32_t to_mg(int16_t count) { return mul_q16(count, this->config.mg_per_digit_q16); }
+    int32_t to_mdps(int16_t count) { return mul_q16(count, this->config.mdps_per_digit_q16); }
+    static constexpr int32_t centi_celsius_per_digit_q16 = q16_factor(100, 340);
+    static int32_t to_centi_celsius(int16_t count) { return mul_q16(count, centi_celsius_per_digit_q16) + 3653; }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef ALTIMETER_HPP
+#define ALTIMETER_HPP
+
+#include <cstdint>
+
+// International standard atmosphere troposphere: h = 44330.77 * (1 - (p / 101325)^0.190263)
+#define ALTIMETER_SEA_LEVEL_PA 101325
+// Table span, about 11.8km above to 500m below sea level, clamped outside
+#define ALTIMETER_PRESSURE_MIN_PA 20480
+#define ALTIMETER_PRESSURE_MAX_PA 110592
+// 256Pa between two entries
+#define ALTIMETER_STEP_SHIFT 8
+#define ALTIMETER_TABLE_SIZE (((ALTIMETER_PRESSURE_MAX_PA - ALTIMETER_PRESSURE_MIN_PA) >> ALTIMETER_STEP_SHIFT) + 1)
+
+// Pressure to altitude without powf: a table of the standard atmosphere altitude built at compile
+// time, linearly interpolated with one 32 bits multiply. Pressures are Q24.8 Pa like BMP280_DATA.
+// The altitudes are relative to the ground reference, taken when armed on the pad.
+class Altimeter {
+    uint32_t ground_pressure = 0;
+    int32_t ground_altitude = 0;
+
+public:
+    void set_ground(uint32_t pressure);
+    bool has_ground() { return this->ground_pressure != 0; }
+    uint32_t get_ground_pressure() { return this->ground_pressure; }
+
+    // mm above the ground reference
+    int32_t get_altitude_mm(uint32_t pressure) { return to_standard_altitude_mm(pressure) - this->ground_altitude; }
+
+    // mm above the standard sea level pressure, within 0.1m of the formula from 0 to 10km
+    static int32_t to_standard_altitude_mm(uint32_t pressure);
+};
+
+#endif
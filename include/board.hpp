@@ -0,0 +1,27 @@
+#ifndef BOARD_HPP
+#define BOARD_HPP
+
+#include "pico/types.h"
+#include "hardware/i2c.h"
+
+// I2C0 on the default pins and I2C1 on GP14/GP15, each sensor gets its own controller
+// so both transfers run at the same time. Point both sensors at i2c0 for a single bus wiring.
+#define BOARD_I2C0_SDA_PIN PICO_DEFAULT_I2C_SDA_PIN
+#define BOARD_I2C0_SCL_PIN PICO_DEFAULT_I2C_SCL_PIN
+#define BOARD_I2C1_SDA_PIN 14
+#define BOARD_I2C1_SCL_PIN 15
+
+#define BOARD_MPU6050_I2C i2c0
+#define BOARD_MPU6050_INT_PIN 6
+#define BOARD_BMP280_I2C i2c1
+
+// Third bus bit-banged by a PIO state machine, SCL has to be the pin after SDA
+#define BOARD_PIO_I2C_PIO pio1
+#define BOARD_PIO_I2C_SM 0
+#define BOARD_PIO_I2C_SDA_PIN 26
+#define BOARD_PIO_I2C_SCL_PIN 27
+
+#define BOARD_I2C_SDA_PIN(i2c) ((i2c) == i2c1 ? BOARD_I2C1_SDA_PIN : BOARD_I2C0_SDA_PIN)
+#define BOARD_I2C_SCL_PIN(i2c) ((i2c) == i2c1 ? BOARD_I2C1_SCL_PIN : BOARD_I2C0_SCL_PIN)
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef CALIBRATION_STORE_HPP
+#define CALIBRATION_STORE_HPP
+
+#include "pico/types.h"
+#include "hardware/flash.h"
+#include "MPU6050.hpp"
+
+#define CALIBRATION_STORE_MAGIC 0x4A434C42 // "JCLB"
+#define CALIBRATION_STORE_VERSION 3
+// Last sector of the flash, far past the end of the program image
+#define CALIBRATION_STORE_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+
+struct calibration_record
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    mpu6050_calibration_t mpu6050;
+    // CRC32 of every field above
+    uint32_t crc;
+} typedef calibration_record_t;
+
+// Calibration persisted in a reserved flash sector so a boot only has to verify it.
+// A blank sector, another layout version or a bad checksum all read as no calibration.
+class CalibrationStore {
+    uint32_t flash_offset;
+
+    const calibration_record_t* get_record() { return (const calibration_record_t*)(XIP_BASE + this->flash_offset); }
+
+public:
+    CalibrationStore();
+    CalibrationStore(uint32_t flash_offset);
+
+    bool load(mpu6050_calibration_t* calibration);
+    // Erase and program the sector with interrupts off. The flash is not readable meanwhile:
+    // the other core must not be running from it.
+    bool save(const mpu6050_calibration_t* calibration);
+
+    static uint32_t crc32(const uint8_t* data, size_t len);
+};
+
+#endif
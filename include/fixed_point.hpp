@@ -0,0 +1,24 @@
+#ifndef FIXED_POINT_HPP
+#define FIXED_POINT_HPP
+
+#include <cstdint>
+
+// Q16 factor turning a raw count into units: numerator / lsb_per_unit, rounded to nearest
+constexpr int32_t q16_factor(double numerator, double lsb_per_unit) {
+    return (int32_t)(numerator * 65536.0 / lsb_per_unit + 0.5);
+}
+
+// count * factor_q16 rounded to nearest, with 32 bits products only (no 64 bits multiply on the M0+).
+// The factor is split in its integer and fractional halves, count * fraction fits an int32 for any int16.
+constexpr int32_t mul_q16(int16_t count, int32_t factor_q16) {
+    return count * (factor_q16 >> 16) + ((count * (factor_q16 & 0xFFFF) + 0x8000) >> 16);
+}
+
+// Distance to the exact product, used to bound the kernels error at compile time
+constexpr double q16_error(int16_t count, double numerator, double lsb_per_unit) {
+    double exact = count * numerator / lsb_per_unit;
+    double error = mul_q16(count, q16_factor(numerator, lsb_per_unit)) - exact;
+    return error < 0 ? -error : error;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef GYRO_BIAS_ESTIMATOR_HPP
+#define GYRO_BIAS_ESTIMATOR_HPP
+
+#include <cstdint>
+#include "vector.hpp"
+
+// Samples per stationarity window, a power of two so the means are shifts
+#define GYRO_BIAS_WINDOW_SHIFT 6
+#define GYRO_BIAS_WINDOW_SAMPLES (1 << GYRO_BIAS_WINDOW_SHIFT)
+// A still window moves the bias by 1 / 2^shift of the measured residual
+#define GYRO_BIAS_GAIN_SHIFT 4
+// Standard deviation limits of a still window
+#define GYRO_BIAS_GYRO_STD_DPS 0.5f
+#define GYRO_BIAS_ACC_STD_G 0.02f
+// A single sample above these stops the estimation at once
+#define GYRO_BIAS_MOTION_DPS 5.0f
+#define GYRO_BIAS_LAUNCH_G 2.5f
+
+// Tracks the gyro bias drift while the rocket sits still, from the bias-removed samples.
+// Windows whose gyro and accel variance stay low feed the residual gyro mean back into the bias,
+// any motion drops the current window and a launch acceleration freezes the bias for good.
+// Counts only and no SDK dependency, so it can be replayed on the host from the data.csv columns.
+class GyroBiasEstimator {
+    int32_t gyro_variance_limit;
+    int32_t acc_variance_limit;
+    int32_t motion_limit;
+    uint32_t launch_limit_squared;
+
+    // Bias in Q8 counts, the fraction carries the small corrections over windows
+    vector3<int32_t> bias_q8;
+    bool frozen = false;
+
+    uint8_t window_count = 0;
+    vector3<int32_t> gyro_sum;
+    vector3<int64_t> gyro_square_sum;
+    vector3<int32_t> acc_sum;
+    vector3<int64_t> acc_square_sum;
+
+    uint32_t still_windows = 0;
+
+    bool is_window_still();
+
+public:
+    GyroBiasEstimator(float gyro_lsb_per_dps, float acc_lsb_per_g, vector3<int16_t> bias);
+
+    // Drop the samples of the current window, when the stream is about to have a gap
+    void reset_window();
+    // Feed one sample, true when the bias was updated
+    bool add_sample(const vector3<int16_t>& acc, const vector3<int16_t>& gyro);
+    // Stop updating the bias until unfreeze, the launch detection does it on its own
+    void freeze() { this->frozen = true; }
+    void unfreeze();
+    bool is_frozen() { return this->frozen; }
+
+    vector3<int16_t> get_bias();
+    uint32_t get_still_windows() { return this->still_windows; }
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef I2C_BUS_HPP
+#define I2C_BUS_HPP
+
+#include "pico/types.h"
+#include "hardware/i2c.h"
+
+// Transaction lengths fit a byte, this leaves room for a whole MPU6050 FIFO batch
+#define I2C_BUS_MAX_TRANSFER 240
+
+#define I2C_FAST_MODE_PLUS_BAUDRATE (1000 * 1000)
+#define I2C_FAST_MODE_BAUDRATE (400 * 1000)
+#define I2C_STANDARD_MODE_BAUDRATE (100 * 1000)
+#define I2C_NEGOTIATION_PROBES 16
+
+// A transfer gets twice its theoretical duration plus this margin before it is declared stuck
+#define I2C_TIMEOUT_MARGIN_US 200
+#define I2C_RETRY_BUDGET 2
+
+class I2cDevice;
+
+enum i2c_status
+{
+    I2C_OK = 0,
+    I2C_NOT_DUE = 1,
+    I2C_NACK = 2,
+    I2C_TIMEOUT = 3,
+    I2C_BUSY = 4
+};
+
+enum i2c_transaction_status
+{
+    I2C_TRANSACTION_IDLE = 0,
+    I2C_TRANSACTION_PENDING = 1,
+    I2C_TRANSACTION_DONE = 2,
+    I2C_TRANSACTION_ERROR = 3,
+    I2C_TRANSACTION_TIMEOUT = 4
+};
+
+// Register burst read: write reg, repeated start, read len bytes into data
+struct i2c_transaction
+{
+    uint8_t addr;
+    uint8_t reg;
+    uint8_t* data;
+    uint8_t len;
+
+    volatile i2c_transaction_status status;
+    void (*callback)(struct i2c_transaction* transaction);
+    void* context;
+
+    uint64_t deadline;
+    struct i2c_transaction* next;
+} typedef i2c_transaction_t;
+
+class I2cBus {
+protected:
+    i2c_transaction_t* head = nullptr;
+    i2c_transaction_t* tail = nullptr;
+
+    uint32_t baudrate = I2C_STANDARD_MODE_BAUDRATE;
+    // Rate asked for, baudrate is what the clock divider made of it. Re-inits start from the
+    // target so the rounding never accumulates.
+    uint32_t target_baudrate = I2C_STANDARD_MODE_BAUDRATE;
+    uint32_t recoveries = 0;
+
+public:
+    virtual i2c_status write(uint8_t addr, const uint8_t* data, size_t len) = 0;
+    virtual i2c_status read_register(uint8_t addr, uint8_t reg, uint8_t* data, size_t len) = 0;
+    // Free a slave holding SDA low and reset the controller
+    virtual void recover() = 0;
+    // Return the applied baudrate
+    virtual uint32_t set_baudrate(uint32_t baudrate) = 0;
+    // The divider is computed from clk_peri, apply the target again after a clock change
+    uint32_t reapply_baudrate() { return this->set_baudrate(this->target_baudrate); }
+
+    // Try 1MHz, 400kHz then 100kHz and keep the fastest one every device answers reliably at.
+    // Return the applied baudrate, 0 if even standard mode failed (the bus is left at 100kHz).
+    uint32_t negotiate_baudrate(I2cDevice** devices, uint8_t devices_count);
+
+    // Queue a transaction, it is started right away if the bus is idle
+    bool submit(i2c_transaction_t* transaction);
+    // Advance the queue, return true while transactions are still in flight
+    bool poll();
+    bool is_busy() { return this->head != nullptr; }
+    void wait_idle();
+
+    uint32_t get_baudrate() { return this->baudrate; }
+    uint32_t get_target_baudrate() { return this->target_baudrate; }
+    uint32_t get_recoveries() { return this->recoveries; }
+    // Worst case time allowed for a transfer of len bytes on this bus
+    uint32_t timeout_us(size_t len);
+
+protected:
+    virtual void start(i2c_transaction_t* transaction) = 0;
+    virtual i2c_transaction_status check(i2c_transaction_t* transaction) = 0;
+    virtual void abort(i2c_transaction_t* transaction) = 0;
+
+    // Bit-bang clocks until SDA is released then a stop, the pins are left as SIO inputs
+    static void clear_bus(uint sda_pin, uint scl_pin);
+};
+
+class HardwareI2cBus: public I2cBus {
+    i2c_inst_t* i2c_port;
+    int sda_pin = -1;
+    int scl_pin = -1;
+    int tx_dma = -1;
+    int rx_dma = -1;
+    uint32_t cmd[I2C_BUS_MAX_TRANSFER + 1];
+
+public:
+    HardwareI2cBus(i2c_inst_t* i2c_port);
+
+    static HardwareI2cBus* get(i2c_inst_t* i2c_port);
+    i2c_inst_t* get_port() { return this->i2c_port; }
+
+    // Bring the controller up on its pins, return the applied baudrate
+    uint32_t init(uint32_t baudrate, uint sda_pin, uint scl_pin);
+
+    uint32_t set_baudrate(uint32_t baudrate) override;
+    i2c_status write(uint8_t addr, const uint8_t* data, size_t len) override;
+    i2c_status read_register(uint8_t addr, uint8_t reg, uint8_t* data, size_t len) override;
+    void recover() override;
+
+protected:
+    void start(i2c_transaction_t* transaction) override;
+    i2c_transaction_status check(i2c_transaction_t* transaction) override;
+    void abort(i2c_transaction_t* transaction) override;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef I2C_SCHEDULER_HPP
+#define I2C_SCHEDULER_HPP
+
+#include "pico/types.h"
+#include "i2c_bus.hpp"
+#include "i2c_sensor.hpp"
+
+#define I2C_SCHEDULER_MAX_DEVICES 8
+
+struct i2c_schedule_entry
+{
+    I2cDevice* device;
+    uint32_t period_us;
+    uint32_t cost_us;
+    uint64_t deadline;
+    bool in_flight;
+} typedef i2c_schedule_entry_t;
+
+// Issues the sensors burst reads in deadline order, each at its own rate.
+// Devices may sit on different buses, their transfers then run concurrently and run() joins them.
+// Time comes from an injectable clock so the schedule can be replayed off-target, add() hands it to
+// the device so its timestamps and rate limits follow the same time. Bus timeouts stay on the hardware timer.
+class I2cScheduler {
+    uint64_t (*clock)();
+
+    i2c_schedule_entry_t entries[I2C_SCHEDULER_MAX_DEVICES];
+    uint8_t entries_count = 0;
+
+public:
+    I2cScheduler();
+    I2cScheduler(uint64_t (*clock)());
+
+    // Return the device slot, or -1 if the table is full
+    int add(I2cDevice* device);
+    int add(I2cDevice* device, uint32_t phase_us);
+    // Start due reads and collect finished ones, return a mask of updated slots
+    uint32_t run();
+
+    // Recompute transfer costs after a bus speed change
+    void update_costs();
+    // Recompute read periods after a device changed its rate
+    void update_periods();
+    uint32_t get_load_permille(I2cBus* bus);
+    uint64_t get_next_deadline();
+
+    static uint32_t transfer_cost_us(uint8_t burst_length, uint32_t baudrate);
+};
+
+#endif
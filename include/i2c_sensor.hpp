@@ -1,18 +1,54 @@
 #ifndef I2C_SENSOR_HPP
 #define I2C_SENSOR_HPP
 
+#include <array>
 #include <cstdlib>
 #include <stdexcept>
 #include "pico/types.h"
+#include "pico/time.h"
 #include "hardware/i2c.h"
+#include "i2c_bus.hpp"
+#include "register_map.hpp"
 #include "vector.hpp"
 
+struct i2c_error_counters
+{
+    uint32_t nack;
+    uint32_t timeout;
+} typedef i2c_error_counters_t;
+
+// Type-erased view of a sensor, used by the bus scheduler
+class I2cDevice {
+public:
+    virtual void init() = 0;
+    virtual bool test_connection() = 0;
+
+    // Queue the sensor burst read on its bus without any rate limiting
+    virtual bool submit_read() = 0;
+    // Decode the burst once the read has completed, return false on error
+    virtual bool complete_update() = 0;
+    virtual bool is_read_pending() = 0;
+
+    virtual uint16_t get_freq() = 0;
+    virtual uint8_t get_burst_length() = 0;
+    virtual I2cBus* get_bus() = 0;
+    // Timebase of the sensor deadlines and timestamps, the scheduler hands over its own
+    virtual void set_clock(uint64_t (*clock)()) = 0;
+
+    // Interrupt driven devices are read when they flag a new sample instead of on a deadline
+    virtual bool is_interrupt_driven() { return false; }
+    virtual bool is_data_ready() { return false; }
+};
+
 template <class T>
-class I2cSensor {
+class I2cSensor: public I2cDevice {
 protected:
     uint8_t addr;
     uint16_t freq;
-    i2c_inst_t *i2c_port;
+    I2cBus *bus;
+    i2c_transaction_t transaction = {};
+    i2c_error_counters_t errors = {};
+    uint64_t (*clock)() = time_us_64;
 
     uint32_t last_update_time = 0;
 
@@ -20,173 +56,142 @@ public:
     T data;
     I2cSensor(uint8_t addr, uint16_t freq);
     I2cSensor(uint8_t addr, uint16_t freq, i2c_inst_t *i2c_port);
+    I2cSensor(uint8_t addr, uint16_t freq, I2cBus *bus);
 
-    virtual void init() = 0;
-    bool update();
-    virtual bool test_connection() = 0;
-
-protected:
-    void write_to_register(uint8_t reg, uint8_t data);
-    uint8_t* read_from_register(uint8_t reg, uint8_t len);
-
-    void write_to_16bregister_LE(uint8_t reg, uint16_t data);
-    uint16_t* read_from_16bregister_LE(uint8_t reg, uint8_t len);
-
-    void write_to_16bregister_BE(uint8_t reg, uint16_t data);
-    uint16_t* read_from_16bregister_BE(uint8_t reg, uint8_t len);
-
-    void write_to_24bregister_LE(uint8_t reg, uint32_t data);
-    uint32_t* read_from_24bregister_LE(uint8_t reg, uint8_t len);
-
-    void write_to_24bregister_BE(uint8_t reg, uint32_t data);
-    uint32_t* read_from_24bregister_BE(uint8_t reg, uint8_t len);
+    // Rate limiter, true once per period of the sensor frequency
+    bool is_due();
+    i2c_error_counters_t get_error_counters() { return this->errors; }
+    uint8_t get_addr() { return this->addr; }
 
-    void write_to_32bregister_LE(uint8_t reg, uint32_t data);
-    uint32_t* read_from_32bregister_LE(uint8_t reg, uint8_t len);
+    bool is_read_pending() override { return this->transaction.status == I2C_TRANSACTION_PENDING; }
+    uint16_t get_freq() override { return this->freq; }
+    I2cBus* get_bus() override { return this->bus; }
+    void set_clock(uint64_t (*clock)()) override { this->clock = clock; }
 
-    void write_to_32bregister_BE(uint8_t reg, uint32_t data);
-    uint32_t* read_from_32bregister_BE(uint8_t reg, uint8_t len);
+protected:
+    bool start_read(uint8_t reg, uint8_t* data, uint8_t len);
+    // Collect the queued read: I2C_BUSY while in flight, I2C_NOT_DUE if nothing was queued
+    i2c_status collect_read();
+    void count_error(i2c_status status);
+
+    // Blocking accesses retry up to I2C_RETRY_BUDGET times, each attempt is bounded by the bus timeout
+    i2c_status write_to_register(uint8_t reg, uint8_t data);
+    i2c_status read_from_register(uint8_t reg, uint8_t* data, uint8_t len);
+    template <size_t N>
+    i2c_status read_from_register(uint8_t reg, std::array<uint8_t, N>& data) { return this->read_from_register(reg, data.data(), N); }
+
+    // Single field access through its register map descriptor, reg is the base register of the map
+    template <class Field>
+    i2c_status read_field(uint8_t reg, typename Field::value_type& value);
+    template <class Field>
+    i2c_status write_field(uint8_t reg, typename Field::value_type value);
 };
 
 template <class T>
 I2cSensor<T>::I2cSensor(uint8_t addr, uint16_t freq) {
     this->addr = addr;
     this->freq = freq;
-    this->i2c_port = i2c_default;
+    this->bus = HardwareI2cBus::get(i2c_default);
 }
 
 template <class T>
 I2cSensor<T>::I2cSensor(uint8_t addr, uint16_t freq, i2c_inst_t *i2c_port) {
     this->addr = addr;
     this->freq = freq;
-    this->i2c_port = i2c_port;
+    this->bus = HardwareI2cBus::get(i2c_port);
 }
 
 template <class T>
-bool I2cSensor<T>::update() {
-    if ((time_us_32() - this->last_update_time) < 1000000 / this->freq) return true;
-    this->last_update_time = time_us_32();
-    return true;
+I2cSensor<T>::I2cSensor(uint8_t addr, uint16_t freq, I2cBus *bus) {
+    this->addr = addr;
+    this->freq = freq;
+    this->bus = bus;
 }
 
 template <class T>
-void I2cSensor<T>::write_to_register(uint8_t reg, uint8_t data) {
-    uint8_t buf[2] = {reg, data};
-    i2c_write_blocking(this->i2c_port, this->addr, buf, 2, false);
-}
-template <class T>
-uint8_t* I2cSensor<T>::read_from_register(uint8_t reg, uint8_t len) {
-    uint8_t* data = new uint8_t[len];
-    i2c_write_blocking(this->i2c_port, this->addr, &reg, 1, true);
-    i2c_read_blocking(this->i2c_port, this->addr, data, len, false);
-    return data;
-}
+bool I2cSensor<T>::is_due() {
+    uint32_t now = (uint32_t)this->clock();
+    uint32_t period = 1000000 / this->freq;
+    if ((now - this->last_update_time) < period) return false;
 
-template <class T>
-void I2cSensor<T>::write_to_16bregister_LE(uint8_t reg, uint16_t data) {
-    uint8_t buf[3] = {reg, (uint8_t)(data & 0xff), (uint8_t)(data >> 8)};
-    i2c_write_blocking(this->i2c_port, this->addr, buf, 3, false);
-}
-template <class T>
-uint16_t* I2cSensor<T>::read_from_16bregister_LE(uint8_t reg, uint8_t len) {
-    uint8_t* data = new uint8_t[len * 2];
-    i2c_write_blocking(this->i2c_port, this->addr, &reg, 1, true);
-    i2c_read_blocking(this->i2c_port, this->addr, data, len * 2, false);
-    uint16_t* data_16b = new uint16_t[len];
-    for (uint8_t i = 0; i < len; i++) {
-        data_16b[i] = (data[i * 2] << 8) | data[i * 2 + 1];
-    }
-    delete[] data;
-    return data_16b;
+    // Keep the sampling grid unless we fell more than one period behind
+    this->last_update_time += period;
+    if ((now - this->last_update_time) >= period) this->last_update_time = now;
+    return true;
 }
 
 template <class T>
-void I2cSensor<T>::write_to_16bregister_BE(uint8_t reg, uint16_t data) {
-    uint8_t buf[3] = {reg, (uint8_t)(data >> 8), (uint8_t)(data & 0xff)};
-    i2c_write_blocking(this->i2c_port, this->addr, buf, 3, false);
+bool I2cSensor<T>::start_read(uint8_t reg, uint8_t* data, uint8_t len) {
+    this->transaction.addr = this->addr;
+    this->transaction.reg = reg;
+    this->transaction.data = data;
+    this->transaction.len = len;
+    return this->bus->submit(&this->transaction);
 }
 template <class T>
-uint16_t* I2cSensor<T>::read_from_16bregister_BE(uint8_t reg, uint8_t len) {
-    uint8_t* data = new uint8_t[len * 2];
-    i2c_write_blocking(this->i2c_port, this->addr, &reg, 1, true);
-    i2c_read_blocking(this->i2c_port, this->addr, data, len * 2, false);
-    uint16_t* data_16b = new uint16_t[len];
-    for (uint8_t i = 0; i < len; i++) {
-        data_16b[i] = (data[i * 2 + 1] << 8) | data[i * 2];
-    }
-    delete[] data;
-    return data_16b;
-}
+i2c_status I2cSensor<T>::collect_read() {
+    this->bus->poll();
+    i2c_transaction_status status = this->transaction.status;
+    if (status == I2C_TRANSACTION_PENDING) return I2C_BUSY;
+    if (status == I2C_TRANSACTION_IDLE) return I2C_NOT_DUE;
+    this->transaction.status = I2C_TRANSACTION_IDLE;
 
-template <class T>
-void I2cSensor<T>::write_to_24bregister_LE(uint8_t reg, uint32_t data) {
-    uint8_t buf[4] = {reg, (uint8_t)(data & 0xff), (uint8_t)(data >> 8), (uint8_t)(data >> 16)};
-    i2c_write_blocking(this->i2c_port, this->addr, buf, 4, false);
-}
-template <class T>
-uint32_t* I2cSensor<T>::read_from_24bregister_LE(uint8_t reg, uint8_t len) {
-    uint8_t* data = new uint8_t[len * 3];
-    i2c_write_blocking(this->i2c_port, this->addr, &reg, 1, true);
-    i2c_read_blocking(this->i2c_port, this->addr, data, len * 3, false);
-    uint32_t* data_24b = new uint32_t[len];
-    for (uint8_t i = 0; i < len; i++) {
-        data_24b[i] = (data[i * 3] << 16) | (data[i * 3 + 1] << 8) | data[i * 3 + 2];
-    }
-    delete[] data;
-    return data_24b;
+    if (status == I2C_TRANSACTION_DONE) return I2C_OK;
+    i2c_status error = status == I2C_TRANSACTION_TIMEOUT ? I2C_TIMEOUT : I2C_NACK;
+    this->count_error(error);
+    return error;
 }
 
 template <class T>
-void I2cSensor<T>::write_to_24bregister_BE(uint8_t reg, uint32_t data) {
-    uint8_t buf[4] = {reg, (uint8_t)(data >> 16), (uint8_t)(data >> 8), (uint8_t)(data & 0xff)};
-    i2c_write_blocking(this->i2c_port, this->addr, buf, 4, false);
-}
-template <class T>
-uint32_t* I2cSensor<T>::read_from_24bregister_BE(uint8_t reg, uint8_t len) {
-    uint8_t* data = new uint8_t[len * 3];
-    i2c_write_blocking(this->i2c_port, this->addr, &reg, 1, true);
-    i2c_read_blocking(this->i2c_port, this->addr, data, len * 3, false);
-    uint32_t* data_24b = new uint32_t[len];
-    for (uint8_t i = 0; i < len; i++) {
-        data_24b[i] = (data[i * 3 + 2] << 16) | (data[i * 3 + 1] << 8) | data[i * 3];
-    }
-    delete[] data;
-    return data_24b;
+void I2cSensor<T>::count_error(i2c_status status) {
+    if (status == I2C_NACK) this->errors.nack++;
+    else if (status == I2C_TIMEOUT) this->errors.timeout++;
 }
 
 template <class T>
-void I2cSensor<T>::write_to_32bregister_LE(uint8_t reg, uint32_t data) {
-    uint8_t buf[5] = {reg, (uint8_t)(data & 0xff), (uint8_t)(data >> 8), (uint8_t)(data >> 16), (uint8_t)(data >> 24)};
-    i2c_write_blocking(this->i2c_port, this->addr, buf, 5, false);
+i2c_status I2cSensor<T>::write_to_register(uint8_t reg, uint8_t data) {
+    uint8_t buf[2] = {reg, data};
+    i2c_status status = I2C_OK;
+    for (uint8_t attempt = 0; attempt <= I2C_RETRY_BUDGET; attempt++) {
+        status = this->bus->write(this->addr, buf, 2);
+        if (status == I2C_OK) break;
+        this->count_error(status);
+    }
+    return status;
 }
 template <class T>
-uint32_t* I2cSensor<T>::read_from_32bregister_LE(uint8_t reg, uint8_t len) {
-    uint8_t* data = new uint8_t[len * 4];
-    i2c_write_blocking(this->i2c_port, this->addr, &reg, 1, true);
-    i2c_read_blocking(this->i2c_port, this->addr, data, len * 4, false);
-    uint32_t* data_32b = new uint32_t[len];
-    for (uint8_t i = 0; i < len; i++) {
-        data_32b[i] = (data[i * 4] << 24) | (data[i * 4 + 1] << 16) | (data[i * 4 + 2] << 8) | data[i * 4 + 3];
+i2c_status I2cSensor<T>::read_from_register(uint8_t reg, uint8_t* data, uint8_t len) {
+    i2c_status status = I2C_OK;
+    for (uint8_t attempt = 0; attempt <= I2C_RETRY_BUDGET; attempt++) {
+        status = this->bus->read_register(this->addr, reg, data, len);
+        if (status == I2C_OK) break;
+        this->count_error(status);
     }
-    delete[] data;
-    return data_32b;
+    return status;
 }
 
 template <class T>
-void I2cSensor<T>::write_to_32bregister_BE(uint8_t reg, uint32_t data) {
-    uint8_t buf[5] = {reg, (uint8_t)(data >> 24), (uint8_t)(data >> 16), (uint8_t)(data >> 8), (uint8_t)(data & 0xff)};
-    i2c_write_blocking(this->i2c_port, this->addr, buf, 5, false);
+template <class Field>
+i2c_status I2cSensor<T>::read_field(uint8_t reg, typename Field::value_type& value) {
+    // value is left untouched when the read fails
+    uint8_t buf[Field::offset + Field::bytes];
+    i2c_status status = this->read_from_register(reg + Field::offset, buf + Field::offset, Field::bytes);
+    if (status == I2C_OK) value = Field::decode(buf);
+    return status;
 }
+
 template <class T>
-uint32_t* I2cSensor<T>::read_from_32bregister_BE(uint8_t reg, uint8_t len) {
-    uint8_t* data = new uint8_t[len * 4];
-    i2c_write_blocking(this->i2c_port, this->addr, &reg, 1, true);
-    i2c_read_blocking(this->i2c_port, this->addr, data, len * 4, false);
-    uint32_t* data_32b = new uint32_t[len];
-    for (uint8_t i = 0; i < len; i++) {
-        data_32b[i] = (data[i * 4 + 3] << 24) | (data[i * 4 + 2] << 16) | (data[i * 4 + 1] << 8) | data[i * 4];
+template <class Field>
+i2c_status I2cSensor<T>::write_field(uint8_t reg, typename Field::value_type value) {
+    uint8_t buf[1 + Field::offset + Field::bytes];
+    Field::encode(value, buf + 1);
+    buf[Field::offset] = reg + Field::offset;
+    i2c_status status = I2C_OK;
+    for (uint8_t attempt = 0; attempt <= I2C_RETRY_BUDGET; attempt++) {
+        status = this->bus->write(this->addr, buf + Field::offset, 1 + Field::bytes);
+        if (status == I2C_OK) break;
+        this->count_error(status);
     }
-    delete[] data;
-    return data_32b;
+    return status;
 }
 #endif
\ No newline at end of file
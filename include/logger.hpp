@@ -19,11 +19,19 @@
 void add_spi(spi_t *spi);
 void add_sd_card(sd_card_t *sd_card);
 
+// Raw sensor counts, data_scale_t turns them into units
 struct data_t{
     uint32_t time;
-    vector3<float> acc;
-    vector3<float> gyro;
-    float pressure;
+    vector3<int16_t> acc;
+    vector3<int16_t> gyro;
+    uint32_t pressure;
+};
+
+// Written once at the top of the data file
+struct data_scale_t{
+    float acc_lsb_per_g;
+    float gyro_lsb_per_dps;
+    uint16_t pressure_lsb_per_pa;
 };
 
 class Logger {
@@ -43,7 +51,8 @@ class Logger {
 
     bool write_log(const char* message);
     bool write_error(const char* message);
-    bool write_data(uint32_t time, float acc_x, float acc_y, float acc_z,  float gyro_x, float gyro_y, float gyro_z, float pressure);
+    bool write_data_header(const data_scale_t* scale);
+    bool write_data(uint32_t time, int16_t acc_x, int16_t acc_y, int16_t acc_z, int16_t gyro_x, int16_t gyro_y, int16_t gyro_z, uint32_t pressure);
     
     bool test_connection();
     void push_data_to_fifo(data_t* data);
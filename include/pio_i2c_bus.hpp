@@ -0,0 +1,37 @@
+#ifndef PIO_I2C_BUS_HPP
+#define PIO_I2C_BUS_HPP
+
+#include "pico/types.h"
+#include "hardware/pio.h"
+#include "i2c_bus.hpp"
+#include "PioI2C.hpp"
+
+// I2C master running on a PIO state machine, for when both hardware controllers are taken.
+// Reads are a single DMA-fed command stream (start, address, register, repeated start, data, stop).
+class PioI2cBus: public I2cBus {
+    PioI2C pio_i2c;
+    int tx_dma = -1;
+    int rx_dma = -1;
+    uint16_t cmd[PioI2C::readRegisterLength(I2C_BUS_MAX_TRANSFER)];
+    // The address and register bytes are clocked in too, the data follows them
+    uint8_t rx[I2C_BUS_MAX_TRANSFER + PioI2C::READ_REGISTER_ECHO];
+
+    // Push the command records while draining the RX FIFO into rx, then wait for the stop
+    i2c_status transfer(uint count, uint rx_count, uint32_t timeout);
+
+public:
+    // SCL must be on the pin right after SDA
+    PioI2cBus(PIO pio, uint sm, uint sda_pin, uint scl_pin, uint32_t baudrate);
+
+    uint32_t set_baudrate(uint32_t baudrate) override;
+    i2c_status write(uint8_t addr, const uint8_t* data, size_t len) override;
+    i2c_status read_register(uint8_t addr, uint8_t reg, uint8_t* data, size_t len) override;
+    void recover() override;
+
+protected:
+    void start(i2c_transaction_t* transaction) override;
+    i2c_transaction_status check(i2c_transaction_t* transaction) override;
+    void abort(i2c_transaction_t* transaction) override;
+};
+
+#endif
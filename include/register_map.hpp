@@ -0,0 +1,57 @@
+#ifndef REGISTER_MAP_HPP
+#define REGISTER_MAP_HPP
+
+#include <cstdint>
+#include <ratio>
+#include <type_traits>
+
+// Byte order of a multi-byte field as it comes out of the sensor
+enum register_endianness
+{
+    REGISTER_MSB_FIRST = 0,
+    REGISTER_LSB_FIRST = 1
+};
+
+// A field inside a register burst, described once and decoded straight from the raw buffer.
+// Shift drops the unused low bits (e.g. 20 bits values in 24 bits registers) and Scale is applied by scaled().
+template <uint8_t Offset, uint8_t Bytes, register_endianness Endian, bool Signed, uint8_t Shift = 0, class Scale = std::ratio<1>>
+struct RegisterField
+{
+    static_assert(Bytes >= 1 && Bytes <= 4, "Register fields are 1 to 4 bytes wide");
+    static_assert(Shift < Bytes * 8, "Shift drops every bit of the field");
+
+    static constexpr uint8_t offset = Offset;
+    static constexpr uint8_t bytes = Bytes;
+    static constexpr uint8_t bits = Bytes * 8 - Shift;
+
+    typedef typename std::conditional<(bits <= 8), typename std::conditional<Signed, int8_t, uint8_t>::type,
+            typename std::conditional<(bits <= 16), typename std::conditional<Signed, int16_t, uint16_t>::type,
+            typename std::conditional<Signed, int32_t, uint32_t>::type>::type>::type value_type;
+
+    static constexpr uint32_t raw(const uint8_t* buf) {
+        uint32_t value = 0;
+        for (uint8_t i = 0; i < Bytes; i++) {
+            value = (value << 8) | buf[Offset + (Endian == REGISTER_MSB_FIRST ? i : Bytes - 1 - i)];
+        }
+        return value >> Shift;
+    }
+
+    static constexpr value_type decode(const uint8_t* buf) {
+        uint32_t value = raw(buf);
+        if (Signed && bits < 32 && (value & (1u << (bits - 1)))) value |= ~0u << bits;
+        return (value_type)value;
+    }
+
+    static constexpr float scaled(const uint8_t* buf) {
+        return (float)decode(buf) * Scale::num / Scale::den;
+    }
+
+    static constexpr void encode(value_type value, uint8_t* buf) {
+        uint32_t raw_value = (uint32_t)value << Shift;
+        for (uint8_t i = 0; i < Bytes; i++) {
+            buf[Offset + (Endian == REGISTER_MSB_FIRST ? Bytes - 1 - i : i)] = (uint8_t)(raw_value >> (8 * i));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef PIO_I2C_HPP
+#define PIO_I2C_HPP
+
+#include "pico/types.h"
+#include "hardware/pio.h"
+
+class PioI2C {
+    public:
+    static const uint ICOUNT_LSB = 10;
+    static const uint FINAL_LSB = 9;
+    static const uint DATA_LSB = 1;
+    static const uint NAK_LSB = 0;
+
+    // Number of FIFO records needed by a register read of len bytes, and by a write of len bytes
+    static constexpr uint readRegisterLength(uint len) { return len + 15; }
+    static constexpr uint writeLength(uint len) { return len + 8; }
+
+    PioI2C(PIO pio, uint sm, uint sdaPin, uint sclPin, uint32_t baudrate);
+    ~PioI2C();
+
+    uint32_t setBaudrate(uint32_t baudrate);
+    uint getSdaPin() { return sdaPin; }
+    uint getSclPin() { return sclPin; }
+
+    // Fill cmd with the whole transaction (start, address, data, stop), return the records count
+    uint buildReadRegister(uint16_t *cmd, uint8_t addr, uint8_t reg, uint len);
+    uint buildWrite(uint16_t *cmd, uint8_t addr, const uint8_t *data, uint len);
+
+    // Bytes pushed in the RX FIFO before the data of a register read (address, register, address)
+    static const uint READ_REGISTER_ECHO = 3;
+
+    bool hasError();
+    // Flush the aborted transaction and release the bus with a stop
+    void resumeAfterError();
+    // Detach the pins from the machine so the bus can be bit-banged, then hand them back
+    void release();
+    void reattach();
+
+    bool isTxStalled();
+    void clearTxStalled();
+
+    volatile void *getTxFifo();
+    const volatile void *getRxFifo();
+    uint getTxDreq();
+    uint getRxDreq();
+    bool isTxFull();
+    void put(uint16_t record);
+    bool isRxEmpty();
+    uint8_t get();
+
+private:
+    PIO pio;
+    uint sm;
+    uint offset;
+    uint sdaPin;
+    uint sclPin;
+    uint32_t baudrate;
+
+    uint putStart(uint16_t *cmd);
+    uint putRepeatedStart(uint16_t *cmd);
+    uint putStop(uint16_t *cmd);
+};
+
+#endif
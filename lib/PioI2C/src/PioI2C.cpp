@@ -0,0 +1,140 @@
+#include "PioI2C.hpp"
+#include "PioI2C.pio.h"
+#include "hardware/clocks.h"
+
+PioI2C::PioI2C(PIO pio, uint sm, uint sdaPin, uint sclPin, uint32_t baudrate) {
+    this->pio = pio;
+    this->sm = sm;
+    this->sdaPin = sdaPin;
+    this->sclPin = sclPin;
+    this->baudrate = baudrate;
+    this->offset = pio_add_program(pio, &pio_i2c_program);
+    pio_i2c_program_init(pio, sm, offset, sdaPin, sclPin, baudrate);
+}
+
+PioI2C::~PioI2C() {
+    pio_sm_set_enabled(pio, sm, false);
+}
+
+uint32_t PioI2C::setBaudrate(uint32_t baudrate) {
+    this->baudrate = baudrate;
+    pio_sm_set_clkdiv(pio, sm, (float)clock_get_hz(clk_sys) / (PIO_I2C_CYCLES_PER_BIT * baudrate));
+    return baudrate;
+}
+
+uint PioI2C::putStart(uint16_t *cmd) {
+    cmd[0] = 1u << ICOUNT_LSB;
+    cmd[1] = pio_i2c_set_scl_sda_program_instructions[PIO_I2C_SC1_SD0]; // Bus idle, pull SDA low
+    cmd[2] = pio_i2c_set_scl_sda_program_instructions[PIO_I2C_SC0_SD0]; // Then SCL to present data
+    return 3;
+}
+
+uint PioI2C::putRepeatedStart(uint16_t *cmd) {
+    cmd[0] = 3u << ICOUNT_LSB;
+    cmd[1] = pio_i2c_set_scl_sda_program_instructions[PIO_I2C_SC0_SD1];
+    cmd[2] = pio_i2c_set_scl_sda_program_instructions[PIO_I2C_SC1_SD1];
+    cmd[3] = pio_i2c_set_scl_sda_program_instructions[PIO_I2C_SC1_SD0];
+    cmd[4] = pio_i2c_set_scl_sda_program_instructions[PIO_I2C_SC0_SD0];
+    return 5;
+}
+
+uint PioI2C::putStop(uint16_t *cmd) {
+    cmd[0] = 2u << ICOUNT_LSB;
+    cmd[1] = pio_i2c_set_scl_sda_program_instructions[PIO_I2C_SC0_SD0]; // SDA is unknown, pull it down
+    cmd[2] = pio_i2c_set_scl_sda_program_instructions[PIO_I2C_SC1_SD0]; // Release clock
+    cmd[3] = pio_i2c_set_scl_sda_program_instructions[PIO_I2C_SC1_SD1]; // Release SDA to return to idle
+    return 4;
+}
+
+uint PioI2C::buildReadRegister(uint16_t *cmd, uint8_t addr, uint8_t reg, uint len) {
+    uint count = putStart(cmd);
+    cmd[count++] = (addr << 2) | 1u;
+    cmd[count++] = (reg << DATA_LSB) | 1u;
+    count += putRepeatedStart(cmd + count);
+    cmd[count++] = (addr << 2) | 3u;
+    // Clock all ones in, ACK every byte but NAK the final one
+    for (uint i = 0; i < len; i++) {
+        bool last = i == len - 1;
+        cmd[count++] = (0xffu << DATA_LSB) | (last ? (1u << FINAL_LSB) | (1u << NAK_LSB) : 0);
+    }
+    count += putStop(cmd + count);
+    return count;
+}
+
+uint PioI2C::buildWrite(uint16_t *cmd, uint8_t addr, const uint8_t *data, uint len) {
+    uint count = putStart(cmd);
+    cmd[count++] = (addr << 2) | 1u;
+    for (uint i = 0; i < len; i++) {
+        bool last = i == len - 1;
+        cmd[count++] = (data[i] << DATA_LSB) | (last ? 1u << FINAL_LSB : 0) | 1u;
+    }
+    count += putStop(cmd + count);
+    return count;
+}
+
+bool PioI2C::hasError() {
+    return pio_interrupt_get(pio, sm);
+}
+
+void PioI2C::resumeAfterError() {
+    pio_sm_drain_tx_fifo(pio, sm);
+    pio_sm_exec(pio, sm, pio_encode_jmp(offset + pio_i2c_offset_entry_point));
+    pio_sm_clear_fifos(pio, sm);
+    pio_interrupt_clear(pio, sm);
+
+    uint16_t stop[4];
+    uint count = putStop(stop);
+    for (uint i = 0; i < count; i++) put(stop[i]);
+}
+
+void PioI2C::release() {
+    pio_sm_set_enabled(pio, sm, false);
+    gpio_set_oeover(sdaPin, GPIO_OVERRIDE_NORMAL);
+    gpio_set_oeover(sclPin, GPIO_OVERRIDE_NORMAL);
+}
+
+void PioI2C::reattach() {
+    pio_i2c_program_init(pio, sm, offset, sdaPin, sclPin, baudrate);
+}
+
+bool PioI2C::isTxStalled() {
+    return pio->fdebug & (1u << (PIO_FDEBUG_TXSTALL_LSB + sm));
+}
+
+void PioI2C::clearTxStalled() {
+    pio->fdebug = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm);
+}
+
+volatile void *PioI2C::getTxFifo() {
+    // Halfword access so the record lands in the OSR top half used by the 16 bits autopull
+    return (volatile uint16_t *)&pio->txf[sm];
+}
+
+const volatile void *PioI2C::getRxFifo() {
+    return &pio->rxf[sm];
+}
+
+uint PioI2C::getTxDreq() {
+    return pio_get_dreq(pio, sm, true);
+}
+
+uint PioI2C::getRxDreq() {
+    return pio_get_dreq(pio, sm, false);
+}
+
+bool PioI2C::isTxFull() {
+    return pio_sm_is_tx_fifo_full(pio, sm);
+}
+
+void PioI2C::put(uint16_t record) {
+    while (pio_sm_is_tx_fifo_full(pio, sm)) tight_loop_contents();
+    *(volatile uint16_t *)&pio->txf[sm] = record;
+}
+
+bool PioI2C::isRxEmpty() {
+    return pio_sm_is_rx_fifo_empty(pio, sm);
+}
+
+uint8_t PioI2C::get() {
+    return (uint8_t)pio_sm_get(pio, sm);
+}
@@ -1,5 +1,34 @@
 #include "BMP280.hpp"
 #include <iostream>
+#include <string.h>
+
+// Check the register maps against the datasheet calibration example and the hand-written decode
+static constexpr uint8_t calib_sample[bmp280_calib_map::size] = {
+    0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC, 0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B,
+    0x27, 0x0B, 0x8C, 0x00, 0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6, 0x70, 0x17
+};
+static_assert(bmp280_calib_map::dig_T1::decode(calib_sample) == 27504, "dig_T1 decode");
+static_assert(bmp280_calib_map::dig_T2::decode(calib_sample) == 26435, "dig_T2 decode");
+static_assert(bmp280_calib_map::dig_T3::decode(calib_sample) == -1000, "dig_T3 decode");
+static_assert(bmp280_calib_map::dig_P1::decode(calib_sample) == 36477, "dig_P1 decode");
+static_assert(bmp280_calib_map::dig_P2::decode(calib_sample) == -10685, "dig_P2 decode");
+static_assert(bmp280_calib_map::dig_P3::decode(calib_sample) == 3024, "dig_P3 decode");
+static_assert(bmp280_calib_map::dig_P4::decode(calib_sample) == 2855, "dig_P4 decode");
+static_assert(bmp280_calib_map::dig_P5::decode(calib_sample) == 140, "dig_P5 decode");
+static_assert(bmp280_calib_map::dig_P6::decode(calib_sample) == -7, "dig_P6 decode");
+static_assert(bmp280_calib_map::dig_P7::decode(calib_sample) == 15500, "dig_P7 decode");
+static_assert(bmp280_calib_map::dig_P8::decode(calib_sample) == -14600, "dig_P8 decode");
+static_assert(bmp280_calib_map::dig_P9::decode(calib_sample) == 6000, "dig_P9 decode");
+
+static constexpr uint8_t burst_sample[bmp280_burst_map::size] = {0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00};
+static_assert(bmp280_burst_map::pressure::decode(burst_sample) == ((0x65 << 12) | (0x5A << 4) | (0xC0 >> 4)), "pressure decode");
+static_assert(bmp280_burst_map::temp::decode(burst_sample) == ((0x7E << 12) | (0xED << 4) | (0x00 >> 4)), "temp decode");
+
+// Conversion times of the datasheet use case table
+static_assert(bmp280_measurement_time_us(BMP280_PROFILE_ASCENT) == 6425, "ultra low power");
+static_assert(bmp280_measurement_time_us(BMP280_PROFILE_STANDARD) == 13325, "standard resolution");
+static_assert(bmp280_measurement_time_us(BMP280_PROFILE_PAD) == 43225, "ultra high resolution");
+static_assert(bmp280_standby_time_us(BMP280_STANDBY_4000MS) == 4000000, "longest standby");
 
 BMP280::BMP280(): I2cSensor(0x76, 100) {
     this->addr = 0x76;
@@ -11,77 +40,191 @@ BMP280::BMP280(uint8_t addr): I2cSensor(addr, 100) {
     this->init();
 }
 
+BMP280::BMP280(uint8_t addr, I2cBus *bus): I2cSensor(addr, 100, bus) {
+    this->init();
+}
+
 void BMP280::init() {
-    this->write_to_register(BMP280_REG_CTRL_MEAS, 0b00101111); // Normal mode | oversampling press x4 | oversampling temp x1
-    this->write_to_register(BMP280_REG_CONFIG, 0b00001000); // Standby time 0.5ms | IIR filter x4
+    this->set_profile(BMP280_PROFILE_STANDARD);
     this->fetchCalibParams();
 }
 
+uint8_t BMP280::get_ctrl_meas() {
+    // A forced conversion only starts on trigger
+    uint8_t mode = this->mode == BMP280_MODE_FORCED ? BMP280_MODE_SLEEP : this->mode;
+    return (this->profile.temp_oversampling << 5) | (this->profile.pressure_oversampling << 2) | mode;
+}
+
+void BMP280::reset_schedule() {
+    // Polls are cheap until a conversion is due, the first one after it is read.
+    // A forced conversion is due after its measurement time, the standby does not apply.
+    uint32_t period = this->mode == BMP280_MODE_FORCED ? bmp280_measurement_time_us(this->profile) : this->get_measurement_period_us();
+    this->freq = BMP280_POLLS_PER_RESULT * 1000000 / period;
+    if (this->freq == 0) this->freq = 1;
+    this->has_result = false;
+    this->triggered = false;
+}
+
+void BMP280::set_profile(const bmp280_profile_t& profile) {
+    this->profile = profile;
+    uint8_t ctrl_meas = this->get_ctrl_meas();
+    // CONFIG writes may be ignored in normal mode, go through sleep
+    this->write_to_register(BMP280_REG_CTRL_MEAS, ctrl_meas & ~0b11);
+    this->write_to_register(BMP280_REG_CONFIG, (profile.standby << 5) | (profile.filter << 2));
+    this->write_to_register(BMP280_REG_CTRL_MEAS, ctrl_meas);
+    this->reset_schedule();
+}
+
+void BMP280::set_mode(bmp280_mode mode) {
+    this->mode = mode;
+    this->write_to_register(BMP280_REG_CTRL_MEAS, this->get_ctrl_meas());
+    this->reset_schedule();
+}
+
+i2c_status BMP280::trigger() {
+    if (this->mode != BMP280_MODE_FORCED) return I2C_NOT_DUE;
+    if (this->triggered) return I2C_BUSY;
+
+    i2c_status status = this->write_to_register(BMP280_REG_CTRL_MEAS, this->get_ctrl_meas() | BMP280_MODE_FORCED);
+    if (status != I2C_OK) return status;
+    // The conversion starts on the stop condition of the write
+    this->trigger_time = this->clock();
+    this->triggered = true;
+    return I2C_OK;
+}
+
+bool BMP280::is_conversion_due() {
+    if (this->mode == BMP280_MODE_FORCED) {
+        return this->triggered && this->clock() >= this->trigger_time + bmp280_measurement_time_us(this->profile);
+    }
+    if (!this->has_result) return true;
+    return this->clock() >= this->conversion_time + bmp280_measurement_period_typ_us(this->profile);
+}
+
 void BMP280::fetchCalibParams() {
-    int response;
-    uint8_t* data = this->read_from_register(BMP280_REG_DIG_T1_LSB, 24);
+    std::array<uint8_t, bmp280_calib_map::size> data;
+    this->read_from_register(BMP280_REG_DIG_T1_LSB, data);
 
-    this->calib_param.dig_T1 = (uint16_t)(data[1] << 8) | data[0];
-    this->calib_param.dig_T2 = (int16_t)(data[3] << 8) | data[2];
-    this->calib_param.dig_T3 = (int16_t)(data[5] << 8) | data[4];
+    this->calib_param.dig_T1 = bmp280_calib_map::dig_T1::decode(data.data());
+    this->calib_param.dig_T2 = bmp280_calib_map::dig_T2::decode(data.data());
+    this->calib_param.dig_T3 = bmp280_calib_map::dig_T3::decode(data.data());
 
-    this->calib_param.dig_P1 = (uint16_t)(data[7] << 8) | data[6];
-    this->calib_param.dig_P2 = (int16_t)(data[9] << 8) | data[8];
-    this->calib_param.dig_P3 = (int16_t)(data[11] << 8) | data[10];
-    this->calib_param.dig_P4 = (int16_t)(data[13] << 8) | data[12];
-    this->calib_param.dig_P5 = (int16_t)(data[15] << 8) | data[14];
-    this->calib_param.dig_P6 = (int16_t)(data[17] << 8) | data[16];
-    this->calib_param.dig_P7 = (int16_t)(data[19] << 8) | data[18];
-    this->calib_param.dig_P8 = (int16_t)(data[21] << 8) | data[20];
-    this->calib_param.dig_P9 = (int16_t)(data[23] << 8) | data[22];
-    free(data);
+    this->calib_param.dig_P1 = bmp280_calib_map::dig_P1::decode(data.data());
+    this->calib_param.dig_P2 = bmp280_calib_map::dig_P2::decode(data.data());
+    this->calib_param.dig_P3 = bmp280_calib_map::dig_P3::decode(data.data());
+    this->calib_param.dig_P4 = bmp280_calib_map::dig_P4::decode(data.data());
+    this->calib_param.dig_P5 = bmp280_calib_map::dig_P5::decode(data.data());
+    this->calib_param.dig_P6 = bmp280_calib_map::dig_P6::decode(data.data());
+    this->calib_param.dig_P7 = bmp280_calib_map::dig_P7::decode(data.data());
+    this->calib_param.dig_P8 = bmp280_calib_map::dig_P8::decode(data.data());
+    this->calib_param.dig_P9 = bmp280_calib_map::dig_P9::decode(data.data());
 }
 
 int32_t BMP280::compute_fine_res_temperature(int32_t raw_temp) {
-    int32_t var1, var2;
+    int32_t var1 = 0, var2 = 0;
     var1 = ((((raw_temp >> 3) - ((int32_t)this->calib_param.dig_T1 << 1))) * ((int32_t)this->calib_param.dig_T2)) >> 11;
     var2 = (((((raw_temp >> 4) - ((int32_t)this->calib_param.dig_T1)) * ((raw_temp >> 4) - ((int32_t)this->calib_param.dig_T1))) >> 12) * ((int32_t)this->calib_param.dig_T3)) >> 14;
     return var1 + var2;
 }
 
+// Datasheet compensation example, 100653.25Pa with 64 bits and 100656Pa with 32 bits
+static constexpr BMP280_calib_param calib_example = {27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000};
+static_assert(bmp280_compensate_pressure_64(calib_example, 415148, 128422) == 25767233, "64 bits example");
+static_assert(bmp280_compensate_pressure_32(calib_example, 415148, 128422) == 100656, "32 bits example");
+
 int32_t BMP280::compensate_pressure(int32_t raw_pressure, int32_t fine_temp) {
-    int64_t var1, var2, p;
-    var1 = ((int64_t)fine_temp) - 128000;
-    var2 = (var1 * var1 * ((int64_t)this->calib_param.dig_P6));
-    var2 += ((var1 * ((int64_t)this->calib_param.dig_P5)) << 17);
-    var2 += (((int64_t)this->calib_param.dig_P4) << 35);
-    var1 = ((var1 * var1 * (int64_t)this->calib_param.dig_P3) >> 8) + ((var1 * (int32_t)this->calib_param.dig_P2) << 12);
-    var1 = (((((int64_t)1)<<47)+var1))*((int64_t)this->calib_param.dig_P1)>>33;
-    if (var1 == 0) {
-        return 0;  // avoid exception caused by division by zero
-    }
-    p = 1048576-raw_pressure;
-    p = (((p<<31)-var2)*3125)/var1;
-    var1 = (((int64_t)this->calib_param.dig_P9) * (p>>13) * (p>>13)) >> 25;
-    var2 =  (((int64_t)this->calib_param.dig_P8) * p) >> 19;
-    return (uint32_t)((p + var1 + var2) >> 8) + (((int64_t)this->calib_param.dig_P7)<<4);
+#if BMP280_COMPENSATION_32BIT
+    // Same Q24.8 output, the fraction is lost
+    return bmp280_compensate_pressure_32(this->calib_param, raw_pressure, fine_temp) << 8;
+#else
+    return bmp280_compensate_pressure_64(this->calib_param, raw_pressure, fine_temp);
+#endif
+}
+
+i2c_status BMP280::update() {
+    if (!this->is_due() || !this->is_conversion_due()) return I2C_NOT_DUE;
+
+    this->read_time = this->clock();
+    i2c_status status = this->read_from_register(BMP280_REG_PRESSURE_MSB, this->burst);
+    if (status != I2C_OK) return status;
+    return this->decode_burst() ? I2C_OK : I2C_NOT_DUE;
 }
 
-bool BMP280::update() {
-    if (!this->I2cSensor::update()) return false;
+bool BMP280::start_update() {
+    if (!this->is_due()) return false;
+    return this->submit_read();
+}
 
-    int32_t raw_pressure, raw_temp;
-    uint32_t* data = this->read_from_24bregister_LE(BMP280_REG_PRESSURE_MSB, 2);
+bool BMP280::submit_read() {
+    // Skipped without a transfer until a new conversion can be there
+    if (!this->is_conversion_due()) return false;
+    this->read_time = this->clock();
+    return this->start_read(BMP280_REG_PRESSURE_MSB, this->burst.data(), this->burst.size());
+}
+
+bool BMP280::complete_update() {
+    if (this->collect_read() != I2C_OK) return false;
+    return this->decode_burst();
+}
+
+bool BMP280::decode_mirrored(const uint8_t* burst, uint64_t timestamp) {
+    memcpy(this->burst.data(), burst, this->burst.size());
+    this->read_time = timestamp;
+    return this->decode_burst();
+}
+
+bool BMP280::decode_burst() {
+    // Our own conversion, new whatever its bytes and with known times
+    if (this->mode == BMP280_MODE_FORCED) {
+        this->triggered = false;
+        this->data.fresh = true;
+        this->data.trigger_time = this->trigger_time;
+        this->data.timestamp = this->trigger_time + bmp280_measurement_time_typ_us(this->profile);
+        return this->compensate_burst();
+    }
+
+    // The conversion ended after the last read that still saw the previous one, and a first
+    // result at most a period ago: the reads that follow narrow it down
+    uint64_t earliest = this->last_read_time;
+    if (!this->has_result) {
+        uint32_t period = this->get_measurement_period_us();
+        earliest = this->read_time > period ? this->read_time - period : 0;
+    } else if (this->conversion_time + bmp280_measurement_period_typ_us(this->profile) > earliest) {
+        earliest = this->conversion_time + bmp280_measurement_period_typ_us(this->profile);
+    }
+    if (earliest > this->read_time) earliest = this->read_time;
+    this->last_read_time = this->read_time;
+
+    // Same bytes: the previous conversion again, unless one had to end since with the same result
+    bool same = this->has_result && memcmp(this->burst.data(), this->last_raw.data(), this->burst.size()) == 0;
+    if (same && this->read_time < this->conversion_time + bmp280_measurement_period_us(this->profile)) {
+        this->stale_reads++;
+        this->data.fresh = false;
+        return false;
+    }
+    this->has_result = true;
+    this->conversion_time = earliest;
+    this->last_raw = this->burst;
+    this->data.fresh = true;
+    this->data.timestamp = earliest + (this->read_time - earliest) / 2;
+    this->data.trigger_time = 0;
+    if (same) return true;
+    return this->compensate_burst();
+}
 
-    raw_pressure = data[0] >> 4;
-    raw_temp = data[1] >> 4;
-    free(data);
+bool BMP280::compensate_burst() {
+    int32_t raw_pressure = bmp280_burst_map::pressure::decode(this->burst.data());
+    int32_t raw_temp = bmp280_burst_map::temp::decode(this->burst.data());
 
     // Convert temperature calibration data to 32-bits
     int32_t fine_temp = this->compute_fine_res_temperature(raw_temp);
-    this->data.temp = ((fine_temp * 5 + 128) >> 8) / 100;
-    this->data.pressure = this->compensate_pressure(raw_pressure, fine_temp) / 256.0;
+    this->data.temp = (fine_temp * 5 + 128) >> 8;
+    this->data.pressure = this->compensate_pressure(raw_pressure, fine_temp);
     return true;
 }
 
 bool BMP280::test_connection() {
-    uint8_t* data = this->read_from_register(BMP280_REG_ID, 1);
-    uint8_t data_cp = *data;
-    free(data);
-    return data_cp == 0x58;
+    std::array<uint8_t, 1> data = {0};
+    this->read_from_register(BMP280_REG_ID, data);
+    return data[0] == 0x58;
 }
@@ -1,37 +1,218 @@
 #include "MPU6050.hpp"
+#include <math.h>
+#include <string.h>
+#include "hardware/sync.h"
 
-MPU6050::MPU6050(): I2cSensor(MPU_DEFAULT_I2C_ADDR, MPU_DEFAULT_I2C_FREQ) { this->init(); }
-MPU6050::MPU6050(uint8_t addr, uint8_t freq): I2cSensor(addr, freq) { this->init(); }
-MPU6050::MPU6050(uint8_t addr, i2c_inst_t *i2c_port): I2cSensor(addr, MPU_DEFAULT_I2C_FREQ, i2c_port) { this->init(); }
+// Fixed-point conversions stay within one unit of the exact value over the whole int16 range
+static_assert(q16_error(INT16_MIN, 1000, 131.0) <= 1 && q16_error(INT16_MAX, 1000, 131.0) <= 1, "250dps kernel");
+static_assert(q16_error(INT16_MIN, 1000, 16.4) <= 1 && q16_error(INT16_MAX, 1000, 16.4) <= 1, "2000dps kernel");
+static_assert(q16_error(INT16_MIN, 1000, 16384) <= 1 && q16_error(INT16_MAX, 1000, 2048) <= 1, "acc kernels");
+static_assert(q16_error(INT16_MIN, 100, 340) <= 1 && q16_error(INT16_MAX, 100, 340) <= 1, "temp kernel");
+static_assert(mul_q16(2048, q16_factor(1000, 2048)) == 1000, "1g at 16g range");
+static_assert(mul_q16(-340, q16_factor(100, 340)) == -100, "-1 degC from the offset");
+static_assert(mul_q16(INT16_MIN, 1 << 16) == INT16_MIN && mul_q16(INT16_MAX, 1 << 16) == INT16_MAX, "unit acc scale is exact");
+
+// Check the burst map against the hand-written big endian decode, sign included
+static constexpr uint8_t burst_sample[mpu6050_burst_map::size] = {
+    0x01, 0x02, 0xFF, 0xFE, 0x80, 0x00, 0xF3, 0x10, 0x7F, 0xFF, 0x00, 0x80, 0xC4, 0x21
+};
+static_assert(mpu6050_burst_map::acc_x::decode(burst_sample) == (int16_t)((0x01 << 8) | 0x02), "acc_x decode");
+static_assert(mpu6050_burst_map::acc_y::decode(burst_sample) == (int16_t)((0xFF << 8) | 0xFE), "acc_y decode");
+static_assert(mpu6050_burst_map::acc_z::decode(burst_sample) == (int16_t)((0x80 << 8) | 0x00), "acc_z decode");
+static_assert(mpu6050_burst_map::temp::decode(burst_sample) == (int16_t)((0xF3 << 8) | 0x10), "temp decode");
+static_assert(mpu6050_burst_map::gyro_x::decode(burst_sample) == (int16_t)((0x7F << 8) | 0xFF), "gyro_x decode");
+static_assert(mpu6050_burst_map::gyro_y::decode(burst_sample) == (int16_t)((0x00 << 8) | 0x80), "gyro_y decode");
+static_assert(mpu6050_burst_map::gyro_z::decode(burst_sample) == (int16_t)((0xC4 << 8) | 0x21), "gyro_z decode");
+
+// Output data rates of the datasheet SMPLRT_DIV examples
+static_assert(mpu6050_sample_rate_hz(MPU6050_DLPF_260HZ, 0) == 8000, "8kHz with the DLPF bypassed");
+static_assert(mpu6050_sample_rate_hz(MPU6050_DLPF_260HZ, 7) == 1000, "divided 8kHz");
+static_assert(mpu6050_sample_rate_hz(MPU6050_DLPF_184HZ, 0) == 1000, "1kHz with the DLPF on");
+static_assert(mpu6050_sample_rate_hz(MPU6050_DLPF_44HZ, 9) == 100, "divided 1kHz");
+static_assert(mpu6050_sample_rate_hz(MPU6050_DLPF_5HZ, 255) == 3, "slowest rate");
+
+static_assert(MPU_FIFO_BATCH_SAMPLES * mpu6050_burst_map::size <= I2C_BUS_MAX_TRANSFER, "FIFO batch must fit in one transfer");
+
+MPU6050* MPU6050::irq_instance = nullptr;
+
+MPU6050::MPU6050(): I2cSensor(MPU_DEFAULT_I2C_ADDR, MPU_DEFAULT_I2C_FREQ) { this->requested_freq = this->freq; this->init(); }
+MPU6050::MPU6050(uint8_t addr, uint16_t freq): I2cSensor(addr, freq) { this->requested_freq = this->freq; this->init(); }
+MPU6050::MPU6050(uint8_t addr, i2c_inst_t *i2c_port): I2cSensor(addr, MPU_DEFAULT_I2C_FREQ, i2c_port) { this->requested_freq = this->freq; this->init(); }
+MPU6050::MPU6050(uint8_t addr, uint16_t freq, I2cBus *bus): I2cSensor(addr, freq, bus) { this->requested_freq = this->freq; this->init(); }
 
 void MPU6050::init() {
     this->write_to_register(MPU_REG_PWR_MGMT_1, 0b00000000); // PWR_MGMT_1
-    this->write_to_register(MPU_REG_GYRO_CONFIG, 0b00010000); // GYRO_CONFIG
-    this->write_to_register(MPU_REG_ACCEL_CONFIG, 0b00000000); // ACCEL_CONFIG
-    this->write_to_register(MPU_REG_CONFIG, 0b00000001); // CONFIG
+    this->set_gyro_scale(MPU6050_SCALE_1000DPS);
+    this->set_accel_range(MPU6050_RANGE_2G);
 
-    this->config.gyro_offset.x = 0;
-    this->config.gyro_offset.y = 0;
-    this->config.gyro_offset.z = 0;
+    this->config.gyro_offset = {0, 0, 0};
+    this->config.gyro_temp_coeff_q16 = {0, 0, 0};
+    this->config.calibration_temp = 0;
+    this->config.acc_offset = {0, 0, 0};
+    this->config.acc_scale_q16 = {1 << 16, 1 << 16, 1 << 16};
+
+    this->set_sample_rate(MPU6050_DLPF_184HZ, 0); // 1kHz
 }
 
-void MPU6050::calibrate(uint16_t samples) {
-    vector3<int16_t> gyro_sum = {0, 0, 0};
+void MPU6050::measure_gyro_bias(uint16_t samples, vector3<int16_t>& bias, int16_t& temp) {
+    // 32 bits sums, a few hundred samples of a small bias already overflow 16 bits
+    vector3<int32_t> gyro_sum = {0, 0, 0};
+    int32_t temp_sum = 0;
+    uint8_t* temp_gyro_data = this->burst.data() + mpu6050_burst_map::temp::offset;
+    uint64_t next_sample = this->clock();
     for (uint16_t i = 0; i < samples; i++) {
-        vector3<int16_t> raw_gyro;
-        uint8_t* data = this->read_from_register(MPU_REG_GYRO_XOUT_H, 6);
-        raw_gyro.x = (data[0] << 8) | data[1];
-        raw_gyro.y = (data[2] << 8) | data[3];
-        raw_gyro.z = (data[4] << 8) | data[5];
+        // One fresh sample per read, paced by the output data rate rather than a fixed sleep
+        while (this->clock() < next_sample) tight_loop_contents();
+        next_sample += this->sample_period_us;
+        this->read_from_register(MPU_REG_TEMP_OUT_H, temp_gyro_data, 8);
+
+        temp_sum += mpu6050_burst_map::temp::decode(this->burst.data());
+        gyro_sum.x += mpu6050_burst_map::gyro_x::decode(this->burst.data());
+        gyro_sum.y += mpu6050_burst_map::gyro_y::decode(this->burst.data());
+        gyro_sum.z += mpu6050_burst_map::gyro_z::decode(this->burst.data());
+    }
+    bias.x = gyro_sum.x / samples;
+    bias.y = gyro_sum.y / samples;
+    bias.z = gyro_sum.z / samples;
+    temp = temp_sum / samples;
+}
+
+void MPU6050::measure_acc_mean(uint16_t samples, vector3<int16_t>& mean) {
+    vector3<int32_t> acc_sum = {0, 0, 0};
+    uint8_t* acc_data = this->burst.data() + mpu6050_burst_map::acc_x::offset;
+    uint64_t next_sample = this->clock();
+    for (uint16_t i = 0; i < samples; i++) {
+        while (this->clock() < next_sample) tight_loop_contents();
+        next_sample += this->sample_period_us;
+        this->read_from_register(MPU_REG_ACCEL_XOUT_H, acc_data, 6);
+
+        acc_sum.x += mpu6050_burst_map::acc_x::decode(this->burst.data());
+        acc_sum.y += mpu6050_burst_map::acc_y::decode(this->burst.data());
+        acc_sum.z += mpu6050_burst_map::acc_z::decode(this->burst.data());
+    }
+    mean.x = acc_sum.x / samples;
+    mean.y = acc_sum.y / samples;
+    mean.z = acc_sum.z / samples;
+}
+
+// A full scale bias change times 65536 is past 32 bits
+static int64_t temp_coeff_q16(int16_t bias, int16_t previous_bias, int32_t delta_temp) {
+    return ((int64_t)bias - previous_bias) * 65536 / delta_temp;
+}
+
+void MPU6050::calibrate(uint16_t samples, const mpu6050_calibration_t* previous) {
+    this->measure_gyro_bias(samples, this->config.gyro_offset, this->config.calibration_temp);
+    this->config.gyro_temp_coeff_q16 = {0, 0, 0};
+    if (previous == nullptr || previous->scale != this->config.scale || previous->range != this->config.range) return;
+
+    int32_t delta_temp = (int32_t)this->config.calibration_temp - previous->temp;
+    if (abs(delta_temp) < MPU_TEMP_COEFF_MIN_DELTA) {
+        this->config.gyro_temp_coeff_q16 = previous->gyro_temp_coeff_q16;
+        return;
+    }
+    vector3<int64_t> coeff = {
+        temp_coeff_q16(this->config.gyro_offset.x, previous->gyro_offset.x, delta_temp),
+        temp_coeff_q16(this->config.gyro_offset.y, previous->gyro_offset.y, delta_temp),
+        temp_coeff_q16(this->config.gyro_offset.z, previous->gyro_offset.z, delta_temp)
+    };
+    // gyro counts per temperature count, 340 temperature counts per degC
+    int64_t coeff_max = (int64_t)(MPU_TEMP_COEFF_MAX_DPS_PER_C * this->config.dps_per_digit / 340 * 65536);
+    if (llabs(coeff.x) > coeff_max || llabs(coeff.y) > coeff_max || llabs(coeff.z) > coeff_max) return;
+    this->config.gyro_temp_coeff_q16 = {(int32_t)coeff.x, (int32_t)coeff.y, (int32_t)coeff.z};
+}
+
+bool MPU6050::verify_calibration(const mpu6050_calibration_t& calibration, uint16_t samples) {
+    if (calibration.scale != this->config.scale || calibration.range != this->config.range) return false;
+
+    vector3<int16_t> bias;
+    int16_t temp;
+    this->measure_gyro_bias(samples, bias, temp);
+
+    // Compare against the stored bias moved to the current temperature
+    int16_t delta_temp = temp - calibration.temp;
+    int32_t tolerance = (int32_t)(MPU_BIAS_TOLERANCE_DPS * this->config.dps_per_digit);
+    int32_t error_x = bias.x - (calibration.gyro_offset.x + mul_q16(delta_temp, calibration.gyro_temp_coeff_q16.x));
+    int32_t error_y = bias.y - (calibration.gyro_offset.y + mul_q16(delta_temp, calibration.gyro_temp_coeff_q16.y));
+    int32_t error_z = bias.z - (calibration.gyro_offset.z + mul_q16(delta_temp, calibration.gyro_temp_coeff_q16.z));
+    if (abs(error_x) > tolerance || abs(error_y) > tolerance || abs(error_z) > tolerance) return false;
+
+    this->set_calibration(calibration);
+    return true;
+}
+
+void MPU6050::set_calibration(const mpu6050_calibration_t& calibration) {
+    this->config.gyro_offset = calibration.gyro_offset;
+    this->config.gyro_temp_coeff_q16 = calibration.gyro_temp_coeff_q16;
+    this->config.calibration_temp = calibration.temp;
+    if (calibration.range == this->config.range) {
+        this->config.acc_offset = calibration.acc_offset;
+        this->config.acc_scale_q16 = calibration.acc_scale_q16;
+    } else {
+        this->config.acc_offset = {0, 0, 0};
+        this->config.acc_scale_q16 = {1 << 16, 1 << 16, 1 << 16};
+    }
+}
+
+mpu6050_calibration_t MPU6050::get_calibration() {
+    mpu6050_calibration_t calibration;
+    calibration.scale = this->config.scale;
+    calibration.range = this->config.range;
+    calibration.temp = this->config.calibration_temp;
+    calibration.gyro_offset = this->config.gyro_offset;
+    calibration.gyro_temp_coeff_q16 = this->config.gyro_temp_coeff_q16;
+    calibration.acc_offset = this->config.acc_offset;
+    calibration.acc_scale_q16 = this->config.acc_scale_q16;
+    return calibration;
+}
+
+void MPU6050::start_accel_calibration() {
+    this->accel_positions = 0;
+}
+
+mpu6050_accel_position MPU6050::add_accel_position(uint16_t samples) {
+    vector3<int16_t> mean;
+    this->measure_acc_mean(samples, mean);
+
+    // The axis along gravity reads 1g, the two others 0g
+    int32_t one_g = (int32_t)this->config.range_per_digit;
+    int32_t tolerance = one_g * MPU_ACCEL_POSITION_TOLERANCE_MG / 1000;
+    const int16_t axes[3] = {mean.x, mean.y, mean.z};
+    uint8_t axis = 0;
+    for (uint8_t i = 1; i < 3; i++) {
+        if (abs(axes[i]) > abs(axes[axis])) axis = i;
+    }
+    if (abs(abs(axes[axis]) - one_g) > tolerance) return MPU6050_ACCEL_POSITION_NONE;
+    for (uint8_t i = 0; i < 3; i++) {
+        if (i != axis && abs(axes[i]) > tolerance) return MPU6050_ACCEL_POSITION_NONE;
+    }
+
+    uint8_t position = axis * 2 + (axes[axis] < 0 ? 1 : 0);
+    this->accel_position_means[position] = axes[axis];
+    this->accel_positions |= 1 << position;
+    return (mpu6050_accel_position)position;
+}
+
+bool MPU6050::finish_accel_calibration() {
+    if (!this->is_accel_calibration_complete()) return false;
 
-        gyro_sum.x += raw_gyro.x;
-        gyro_sum.y += raw_gyro.y;
-        gyro_sum.z += raw_gyro.z;
-        sleep_ms(5);
+    int32_t one_g = (int32_t)this->config.range_per_digit;
+    int32_t offset_max = one_g * MPU_ACCEL_OFFSET_MAX_MG / 1000;
+    int32_t span_error_max = 2 * one_g * MPU_ACCEL_SCALE_MAX_ERROR_PERCENT / 100;
+    int16_t offsets[3];
+    int32_t scales_q16[3];
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        // Up reads offset + 1g, down offset - 1g, both through the same sensitivity
+        int32_t up = this->accel_position_means[axis * 2];
+        int32_t down = this->accel_position_means[axis * 2 + 1];
+        int32_t span = up - down;
+        int32_t offset = (up + down) / 2;
+        if (abs(span - 2 * one_g) > span_error_max || abs(offset) > offset_max) return false;
+        offsets[axis] = offset;
+        scales_q16[axis] = (int32_t)((int64_t)2 * one_g * 65536 / span);
     }
-    this->config.gyro_offset.x = gyro_sum.x / samples;
-    this->config.gyro_offset.y = gyro_sum.y / samples;
-    this->config.gyro_offset.z = gyro_sum.z / samples;
+    this->config.acc_offset = {offsets[0], offsets[1], offsets[2]};
+    this->config.acc_scale_q16 = {scales_q16[0], scales_q16[1], scales_q16[2]};
+    return true;
 }
 
 void MPU6050::set_gyro_scale(mpu_6050_scale scale) {
@@ -39,15 +220,19 @@ void MPU6050::set_gyro_scale(mpu_6050_scale scale) {
     {
     case mpu_6050_scale::MPU6050_SCALE_250DPS:
         this->config.dps_per_digit = 131.0f;
+        this->config.mdps_per_digit_q16 = q16_factor(1000, 131.0);
         break;
     case mpu_6050_scale::MPU6050_SCALE_500DPS:
         this->config.dps_per_digit = 65.5f;
+        this->config.mdps_per_digit_q16 = q16_factor(1000, 65.5);
         break;
     case mpu_6050_scale::MPU6050_SCALE_1000DPS:
         this->config.dps_per_digit = 32.8f;
+        this->config.mdps_per_digit_q16 = q16_factor(1000, 32.8);
         break;
     case mpu_6050_scale::MPU6050_SCALE_2000DPS:
         this->config.dps_per_digit = 16.4f;
+        this->config.mdps_per_digit_q16 = q16_factor(1000, 16.4);
         break;
     }
     this->config.scale = scale;
@@ -59,84 +244,464 @@ void MPU6050::set_accel_range(mpu_6050_range range) {
     {
     case mpu_6050_range::MPU6050_RANGE_2G:
         this->config.range_per_digit = 16384.0f;
+        this->config.mg_per_digit_q16 = q16_factor(1000, 16384);
         break;
     case mpu_6050_range::MPU6050_RANGE_4G:
         this->config.range_per_digit = 8192.0f;
+        this->config.mg_per_digit_q16 = q16_factor(1000, 8192);
         break;
     case mpu_6050_range::MPU6050_RANGE_8G:
         this->config.range_per_digit = 4096.0f;
+        this->config.mg_per_digit_q16 = q16_factor(1000, 4096);
         break;
     case mpu_6050_range::MPU6050_RANGE_16G:
         this->config.range_per_digit = 2048.0f;
+        this->config.mg_per_digit_q16 = q16_factor(1000, 2048);
         break;
     }
     this->config.range = range;
     this->write_to_register(MPU_REG_ACCEL_CONFIG, range << 3);
 }
 
-bool MPU6050::update() {
-    if (!I2cSensor::update()) return false;
-
-    vector3<int16_t> raw_acc, raw_gyro;
-    int16_t raw_temp;
-    uint8_t* data = this->read_from_register(MPU_REG_ACCEL_XOUT_H, 14);
-    raw_acc.x = (data[0] << 8) | data[1];
-    raw_acc.y = (data[2] << 8) | data[3];
-    raw_acc.z = (data[4] << 8) | data[5];
-    raw_temp = (data[6] << 8) | data[7];
-    raw_gyro.x = (data[8] << 8) | data[9];
-    raw_gyro.y = (data[10] << 8) | data[11];
-    raw_gyro.z = (data[12] << 8) | data[13];
-    free(data);
-
-    this->data.acc.x = (float)(raw_acc.x / this->config.range_per_digit);
-    this->data.acc.y = (float)(raw_acc.y / this->config.range_per_digit);
-    this->data.acc.z = (float)(raw_acc.z / this->config.range_per_digit);
-    this->data.temp = raw_temp / 340 + 36.53f;
-    this->data.gyro.x = (((float)raw_gyro.x)- this->config.gyro_offset.x) / this->config.dps_per_digit;
-    this->data.gyro.y = (((float)raw_gyro.y) - this->config.gyro_offset.y) / this->config.dps_per_digit;
-    this->data.gyro.z = (((float)raw_gyro.z) - - this->config.gyro_offset.z) / this->config.dps_per_digit;
+void MPU6050::set_sample_rate(mpu_6050_dlpf dlpf, uint8_t sample_rate_div) {
+    this->config.dlpf = dlpf;
+    this->config.sample_rate_div = sample_rate_div;
+    this->config.sample_rate_hz = mpu6050_sample_rate_hz(dlpf, sample_rate_div);
+    this->write_to_register(MPU_REG_CONFIG, dlpf);
+    this->write_to_register(MPU_REG_SMPLRT_DIV, sample_rate_div);
+
+    // From the divider rather than the rounded rate, 333Hz is exactly 3000us apart
+    this->sample_period_us = 1000000 * (1 + sample_rate_div) / mpu6050_gyro_rate_hz(dlpf);
+    this->update_read_rate();
+    if (this->fifo_enabled) this->reset_fifo();
+}
+
+void MPU6050::update_read_rate() {
+    if (this->fifo_enabled) {
+        // Twice per batch worth of samples so the FIFO never fills between two reads
+        this->freq = 2 * this->config.sample_rate_hz / this->fifo_batch_samples();
+        if (this->freq == 0) this->freq = 1;
+    } else {
+        // Reading faster than the output data rate only returns the same sample again
+        this->freq = this->requested_freq;
+        if (this->freq > this->config.sample_rate_hz) this->freq = this->config.sample_rate_hz;
+    }
+}
+
+i2c_status MPU6050::update() {
+    if (this->is_interrupt_driven() ? !this->data_ready : !this->is_due()) return I2C_NOT_DUE;
+
+    this->take_sample_time();
+    if (this->fifo_enabled) {
+        i2c_status status = this->read_from_register(MPU_REG_FIFO_COUNTH, this->fifo_count);
+        if (status != I2C_OK) return status;
+        uint8_t samples = this->decode_fifo_count();
+        if (samples == 0) return I2C_NOT_DUE;
+
+        status = this->read_from_register(MPU_REG_FIFO_R_W, this->fifo_records.data(), samples * this->record_size);
+        if (status != I2C_OK) return status;
+        this->decode_fifo_batch(samples);
+        return I2C_OK;
+    }
+
+    i2c_status status = this->read_from_register(MPU_REG_ACCEL_XOUT_H, this->burst.data(), this->record_size);
+    if (status != I2C_OK) return status;
+    this->decode_burst();
+    return I2C_OK;
+}
+
+bool MPU6050::start_update() {
+    if (this->is_interrupt_driven() ? !this->data_ready : !this->is_due()) return false;
+    return this->submit_read();
+}
+
+bool MPU6050::submit_read() {
+    this->take_sample_time();
+    if (this->fifo_enabled) {
+        this->fifo_reading_count = true;
+        return this->start_read(MPU_REG_FIFO_COUNTH, this->fifo_count.data(), this->fifo_count.size());
+    }
+    return this->start_read(MPU_REG_ACCEL_XOUT_H, this->burst.data(), this->record_size);
+}
+
+bool MPU6050::complete_update() {
+    if (this->collect_read() != I2C_OK) return false;
+
+    if (this->fifo_enabled) {
+        // The count read chains the records read, the batch is decoded once that one completes
+        if (this->fifo_reading_count) {
+            this->fifo_reading_count = false;
+            uint8_t samples = this->decode_fifo_count();
+            if (samples != 0) this->start_read(MPU_REG_FIFO_R_W, this->fifo_records.data(), samples * this->record_size);
+            return false;
+        }
+        this->decode_fifo_batch(this->transaction.len / this->record_size);
+        return true;
+    }
+
+    this->decode_burst();
     return true;
 }
 
-void MPU6050::update_only_acc() {
-    vector3<int16_t> raw_acc;
-    uint8_t* data = this->read_from_register(MPU_REG_ACCEL_XOUT_H, 6);
-    raw_acc.x = (data[0] << 8) | data[1];
-    raw_acc.y = (data[2] << 8) | data[3];
-    raw_acc.z = (data[4] << 8) | data[5];
-    free(data);
+void MPU6050::take_sample_time() {
+    // Clear the flag before reading so a sample landing during the transfer is not lost
+    if (this->is_interrupt_driven()) {
+        uint32_t interrupts = save_and_disable_interrupts();
+        this->data_ready = false;
+        this->sample_time = this->data_ready_time;
+        restore_interrupts(interrupts);
+    } else {
+        this->sample_time = this->clock();
+    }
+}
 
-    this->data.acc.x = (float)(raw_acc.x / this->config.range_per_digit);
-    this->data.acc.y = (float)(raw_acc.y / this->config.range_per_digit);
-    this->data.acc.z = (float)(raw_acc.z / this->config.range_per_digit);
+void MPU6050::decode_burst() {
+    this->data.timestamp = this->sample_time;
+    this->decode_acc(this->burst.data(), this->data);
+    this->decode_temp(this->burst.data(), this->data);
+    this->decode_gyro(this->burst.data(), this->data);
 }
 
-void MPU6050::update_only_temp() {
-    int16_t raw_temp;
-    uint8_t* data = this->read_from_register(MPU_REG_TEMP_OUT_H, 2);
+static int16_t saturate_int16(int32_t value) {
+    if (value > INT16_MAX) return INT16_MAX;
+    if (value < INT16_MIN) return INT16_MIN;
+    return value;
+}
+
+static int16_t remove_bias(int16_t count, int32_t bias) {
+    return saturate_int16(count - bias);
+}
+
+static int16_t correct_acc(int16_t count, int16_t offset, int32_t scale_q16) {
+    return saturate_int16(mul_q16(saturate_int16((int32_t)count - offset), scale_q16));
+}
+
+void MPU6050::decode_acc(const uint8_t* record, MPU6050_DATA& sample) {
+    sample.acc.x = correct_acc(mpu6050_burst_map::acc_x::decode(record), this->config.acc_offset.x, this->config.acc_scale_q16.x);
+    sample.acc.y = correct_acc(mpu6050_burst_map::acc_y::decode(record), this->config.acc_offset.y, this->config.acc_scale_q16.y);
+    sample.acc.z = correct_acc(mpu6050_burst_map::acc_z::decode(record), this->config.acc_offset.z, this->config.acc_scale_q16.z);
+}
+
+void MPU6050::decode_temp(const uint8_t* record, MPU6050_DATA& sample) {
+    sample.temp = mpu6050_burst_map::temp::decode(record);
+}
+
+void MPU6050::decode_gyro(const uint8_t* record, MPU6050_DATA& sample) {
+    // The bias follows the temperature of the same sample, decode_temp runs first
+    int16_t delta_temp = saturate_int16((int32_t)sample.temp - this->config.calibration_temp);
+    sample.gyro.x = remove_bias(mpu6050_burst_map::gyro_x::decode(record), this->config.gyro_offset.x + mul_q16(delta_temp, this->config.gyro_temp_coeff_q16.x));
+    sample.gyro.y = remove_bias(mpu6050_burst_map::gyro_y::decode(record), this->config.gyro_offset.y + mul_q16(delta_temp, this->config.gyro_temp_coeff_q16.y));
+    sample.gyro.z = remove_bias(mpu6050_burst_map::gyro_z::decode(record), this->config.gyro_offset.z + mul_q16(delta_temp, this->config.gyro_temp_coeff_q16.z));
+}
 
-    raw_temp = (data[0] << 8) | data[1];
-    free(data);
-    this->data.temp = ((int16_t)raw_temp) / 340 + 36.53f;
+// The partial updates read into the matching slice of the burst buffer and reuse its decoders
+void MPU6050::update_only_acc() {
+    this->read_from_register(MPU_REG_ACCEL_XOUT_H, this->burst.data() + mpu6050_burst_map::acc_x::offset, 6);
+    this->decode_acc(this->burst.data(), this->data);
+}
+
+void MPU6050::update_only_temp() {
+    this->read_from_register(MPU_REG_TEMP_OUT_H, this->burst.data() + mpu6050_burst_map::temp::offset, 2);
+    this->decode_temp(this->burst.data(), this->data);
 }
 
 void MPU6050::update_only_gyro() {
-    vector3<int16_t> raw_gyro;
-    uint8_t* data = this->read_from_register(MPU_REG_GYRO_XOUT_H, 6);
-    raw_gyro.x = (data[0] << 8) | data[1];
-    raw_gyro.y = (data[2] << 8) | data[3];
-    raw_gyro.z = (data[4] << 8) | data[5];
-    free(data);
+    this->read_from_register(MPU_REG_GYRO_XOUT_H, this->burst.data() + mpu6050_burst_map::gyro_x::offset, 6);
+    this->decode_gyro(this->burst.data(), this->data);
+}
+
+void MPU6050::enable_fifo() {
+    if (this->data_ready_gpio >= 0) {
+        gpio_set_irq_enabled(this->data_ready_gpio, GPIO_IRQ_EDGE_RISE, false);
+        this->data_ready_gpio = -1;
+    }
+    this->write_to_register(MPU_REG_INT_ENABLE, 0);
+
+    // The mirrored slave bytes follow the motion data in each record, like in the burst
+    uint8_t fifo_en = MPU_FIFO_EN_ACCEL | MPU_FIFO_EN_TEMP | MPU_FIFO_EN_GYRO;
+    if (this->ext_length) fifo_en |= MPU_FIFO_EN_SLV0;
+    this->write_to_register(MPU_REG_FIFO_EN, fifo_en);
+    this->user_ctrl |= MPU_USER_CTRL_FIFO_EN;
+    this->fifo_enabled = true;
+    this->reset_fifo();
+    this->update_read_rate();
+}
+
+void MPU6050::set_aux_bypass(bool bypass) {
+    // The master has to be off for the host to drive the auxiliary bus
+    if (bypass) this->user_ctrl &= ~MPU_USER_CTRL_I2C_MST_EN;
+    this->write_to_register(MPU_REG_USER_CTRL, this->user_ctrl);
+    this->write_to_register(MPU_REG_INT_PIN_CFG, MPU_INT_PIN_CFG_RD_CLEAR | (bypass ? MPU_INT_PIN_CFG_I2C_BYPASS_EN : 0));
+}
+
+void MPU6050::enable_aux_slave(uint8_t slave_addr, uint8_t reg, uint8_t len) {
+    if (len > MPU_EXT_SENS_DATA_SIZE) len = MPU_EXT_SENS_DATA_SIZE;
+    this->set_aux_bypass(false);
+
+    // Data ready waits for the slave read so the mirrored bytes belong to the same sample
+    this->write_to_register(MPU_REG_I2C_MST_CTRL, MPU_I2C_MST_CTRL_WAIT_FOR_ES | MPU_I2C_MST_CLK_400KHZ);
+    this->write_to_register(MPU_REG_I2C_SLV0_ADDR, MPU_I2C_SLV_READ | slave_addr);
+    this->write_to_register(MPU_REG_I2C_SLV0_REG, reg);
+    this->write_to_register(MPU_REG_I2C_SLV0_CTRL, MPU_I2C_SLV_EN | len);
+    this->user_ctrl |= MPU_USER_CTRL_I2C_MST_EN;
+    this->write_to_register(MPU_REG_USER_CTRL, this->user_ctrl);
+
+    this->ext_length = len;
+    this->record_size = mpu6050_burst_map::size + len;
+    // The records grew, restart the FIFO with the slave data in them
+    if (this->fifo_enabled) this->enable_fifo();
+}
+
+void MPU6050::reset_fifo() {
+    this->write_to_register(MPU_REG_USER_CTRL, this->user_ctrl | MPU_USER_CTRL_FIFO_RESET);
+    this->fifo_next_time = 0;
+}
+
+uint8_t MPU6050::decode_fifo_count() {
+    uint16_t count = mpu6050_fifo_count_map::count::decode(this->fifo_count.data());
+    // Records are written whole, a partial one means the full FIFO dropped its oldest bytes
+    // and the record boundaries are lost. When the record size divides the FIFO size a full one
+    // stays aligned but may have dropped whole records: restart from an empty FIFO either way
+    if (count >= MPU_FIFO_SIZE || count % this->record_size != 0) {
+        this->fifo_overflows++;
+        this->fifo_overflowed = true;
+        this->reset_fifo();
+        return 0;
+    }
+
+    this->fifo_available = count / this->record_size;
+    return this->fifo_available < this->fifo_batch_samples() ? this->fifo_available : this->fifo_batch_samples();
+}
+
+void MPU6050::decode_fifo_batch(uint8_t samples) {
+    uint64_t period = this->sample_period_us;
+    // The newest sample in the FIFO was written at most one period before its count was read
+    uint64_t first_time = this->sample_time - (this->fifo_available - 1) * period;
+    // Keep the samples evenly spaced, resync after a reset or once the estimate drifts by a period
+    if (this->fifo_next_time == 0 || first_time > this->fifo_next_time + period || first_time + period < this->fifo_next_time) {
+        this->fifo_next_time = first_time;
+    }
+
+    for (uint8_t i = 0; i < samples; i++) {
+        const uint8_t* record = this->fifo_records.data() + i * this->record_size;
+        MPU6050_DATA& sample = this->batch.samples[i];
+        sample.timestamp = this->fifo_next_time;
+        this->decode_acc(record, sample);
+        this->decode_temp(record, sample);
+        this->decode_gyro(record, sample);
+        this->fifo_next_time += period;
+    }
+    this->batch.count = samples;
+    this->batch.overflow = this->fifo_overflowed;
+    this->fifo_overflowed = false;
+    this->data = this->batch.samples[samples - 1];
+    if (this->ext_length) {
+        const uint8_t* newest = this->fifo_records.data() + (samples - 1) * this->record_size;
+        memcpy(this->burst.data() + mpu6050_burst_map::size, newest + mpu6050_burst_map::size, this->ext_length);
+    }
+}
+
+void MPU6050::start_self_test() {
+    this->self_test = {};
+    this->write_to_register(MPU_REG_GYRO_CONFIG, MPU6050_SCALE_250DPS << 3);
+    this->write_to_register(MPU_REG_ACCEL_CONFIG, MPU6050_RANGE_8G << 3);
+    this->self_test.state = MPU6050_SELF_TEST_SETTLE;
+    this->self_test.next_time = this->clock() + MPU_SELF_TEST_SETTLE_US;
+}
+
+mpu6050_self_test_state MPU6050::step_self_test() {
+    mpu6050_self_test_t& test = this->self_test;
+    if (test.state == MPU6050_SELF_TEST_IDLE || test.state == MPU6050_SELF_TEST_DONE) return test.state;
+    uint64_t now = this->clock();
+    if (now < test.next_time) return test.state;
+
+    switch (test.state)
+    {
+    case MPU6050_SELF_TEST_SETTLE:
+    case MPU6050_SELF_TEST_SETTLE_ENABLED:
+        test.state = test.state == MPU6050_SELF_TEST_SETTLE ? MPU6050_SELF_TEST_MEASURE : MPU6050_SELF_TEST_MEASURE_ENABLED;
+        test.samples = 0;
+        test.next_time = now;
+        break;
+    case MPU6050_SELF_TEST_MEASURE:
+        this->accumulate_self_test(0);
+        if (test.samples < MPU_SELF_TEST_SAMPLES) break;
+        this->write_to_register(MPU_REG_GYRO_CONFIG, MPU_GYRO_CONFIG_SELF_TEST);
+        this->write_to_register(MPU_REG_ACCEL_CONFIG, MPU_ACCEL_CONFIG_SELF_TEST);
+        test.state = MPU6050_SELF_TEST_SETTLE_ENABLED;
+        test.next_time = now + MPU_SELF_TEST_SETTLE_US;
+        break;
+    case MPU6050_SELF_TEST_MEASURE_ENABLED:
+        this->accumulate_self_test(1);
+        if (test.samples < MPU_SELF_TEST_SAMPLES) break;
+        this->finish_self_test();
+        test.state = MPU6050_SELF_TEST_DONE;
+        break;
+    default:
+        break;
+    }
+    return test.state;
+}
+
+void MPU6050::accumulate_self_test(uint8_t index) {
+    mpu6050_self_test_t& test = this->self_test;
+    // Raw counts, the calibration does not apply to the self-test scales
+    this->read_from_register(MPU_REG_ACCEL_XOUT_H, this->burst.data(), mpu6050_burst_map::size);
+    test.acc_sum[index].x += mpu6050_burst_map::acc_x::decode(this->burst.data());
+    test.acc_sum[index].y += mpu6050_burst_map::acc_y::decode(this->burst.data());
+    test.acc_sum[index].z += mpu6050_burst_map::acc_z::decode(this->burst.data());
+    test.gyro_sum[index].x += mpu6050_burst_map::gyro_x::decode(this->burst.data());
+    test.gyro_sum[index].y += mpu6050_burst_map::gyro_y::decode(this->burst.data());
+    test.gyro_sum[index].z += mpu6050_burst_map::gyro_z::decode(this->burst.data());
+    test.samples++;
+    test.next_time += this->sample_period_us;
+}
+
+float MPU6050::gyro_factory_trim(uint8_t code) {
+    return code == 0 ? 0.0f : 25.0f * 131.0f * powf(1.046f, code - 1);
+}
+
+float MPU6050::accel_factory_trim(uint8_t code) {
+    return code == 0 ? 0.0f : 4096.0f * 0.34f * powf(0.92f / 0.34f, (code - 1) / 30.0f);
+}
+
+static int16_t trim_deviation_percent(int32_t enabled_sum, int32_t disabled_sum, float factory_trim) {
+    // A zero code has no trim to compare with, report it as a full scale deviation
+    if (factory_trim == 0.0f) return INT16_MAX;
+    float response = (float)(enabled_sum - disabled_sum) / MPU_SELF_TEST_SAMPLES;
+    float deviation = 100.0f * (response - factory_trim) / factory_trim;
+    if (deviation > INT16_MAX) return INT16_MAX;
+    if (deviation < -INT16_MAX) return -INT16_MAX;
+    return (int16_t)deviation;
+}
+
+void MPU6050::finish_self_test() {
+    mpu6050_self_test_t& test = this->self_test;
+    std::array<uint8_t, 4> codes;
+    this->read_from_register(MPU_REG_SELF_TEST_X, codes);
+
+    // Gyro codes are the low 5 bits of X, Y, Z; accel codes take 3 bits there and 2 bits from A
+    uint8_t acc_x_code = ((codes[0] >> 3) & 0b11100) | ((codes[3] >> 4) & 0b11);
+    uint8_t acc_y_code = ((codes[1] >> 3) & 0b11100) | ((codes[3] >> 2) & 0b11);
+    uint8_t acc_z_code = ((codes[2] >> 3) & 0b11100) | (codes[3] & 0b11);
+    test.acc_deviation.x = trim_deviation_percent(test.acc_sum[1].x, test.acc_sum[0].x, accel_factory_trim(acc_x_code));
+    test.acc_deviation.y = trim_deviation_percent(test.acc_sum[1].y, test.acc_sum[0].y, accel_factory_trim(acc_y_code));
+    test.acc_deviation.z = trim_deviation_percent(test.acc_sum[1].z, test.acc_sum[0].z, accel_factory_trim(acc_z_code));
+    // The Y gyro responds the other way
+    test.gyro_deviation.x = trim_deviation_percent(test.gyro_sum[1].x, test.gyro_sum[0].x, gyro_factory_trim(codes[0] & 0b11111));
+    test.gyro_deviation.y = trim_deviation_percent(test.gyro_sum[1].y, test.gyro_sum[0].y, -gyro_factory_trim(codes[1] & 0b11111));
+    test.gyro_deviation.z = trim_deviation_percent(test.gyro_sum[1].z, test.gyro_sum[0].z, gyro_factory_trim(codes[2] & 0b11111));
+
+    test.passed = true;
+    const int16_t* deviations[] = {&test.acc_deviation.x, &test.acc_deviation.y, &test.acc_deviation.z, &test.gyro_deviation.x, &test.gyro_deviation.y, &test.gyro_deviation.z};
+    for (const int16_t* deviation : deviations) {
+        if (abs(*deviation) > MPU_SELF_TEST_TOLERANCE_PERCENT) test.passed = false;
+    }
+
+    this->set_gyro_scale(this->config.scale);
+    this->set_accel_range(this->config.range);
+}
+
+void MPU6050::enable_data_ready_interrupt(uint gpio) {
+    this->data_ready_gpio = gpio;
+    this->data_ready = false;
+    MPU6050::irq_instance = this;
+
+    // Active high push-pull 50us pulse, status cleared by any read
+    this->write_to_register(MPU_REG_INT_PIN_CFG, MPU_INT_PIN_CFG_RD_CLEAR);
+    this->write_to_register(MPU_REG_INT_ENABLE, MPU_INT_ENABLE_DATA_RDY);
+
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_IN);
+    gpio_set_irq_enabled_with_callback(gpio, GPIO_IRQ_EDGE_RISE, true, &MPU6050::gpio_irq_handler);
+}
+
+void MPU6050::gpio_irq_handler(uint gpio, uint32_t events) {
+    MPU6050* instance = MPU6050::irq_instance;
+    if (instance == nullptr) return;
+    uint64_t timestamp = instance->clock();
+    if (gpio == (uint)instance->motion_gpio) {
+        if (!instance->motion_detected) instance->motion_time = timestamp;
+        instance->motion_detected = true;
+    } else if (gpio == (uint)instance->data_ready_gpio) {
+        instance->on_data_ready(timestamp);
+    }
+}
+
+void MPU6050::enable_motion_wakeup(uint gpio, uint16_t threshold_mg, uint8_t duration_ms, mpu_6050_wake_rate rate) {
+    // Data ready may share the pin, keep it to restore it on wake
+    if (this->data_ready_gpio >= 0) {
+        gpio_set_irq_enabled(this->data_ready_gpio, GPIO_IRQ_EDGE_RISE, false);
+        this->saved_data_ready_gpio = this->data_ready_gpio;
+        this->data_ready_gpio = -1;
+    }
+    this->motion_gpio = gpio;
+    this->motion_detected = false;
+    this->wake_rate = rate;
+    MPU6050::irq_instance = this;
+
+    // The motion test runs on high passed accel samples
+    uint16_t threshold = threshold_mg / MPU_MOT_THR_MG_PER_LSB;
+    this->write_to_register(MPU_REG_ACCEL_CONFIG, (this->config.range << 3) | MPU_ACCEL_CONFIG_HPF_5HZ);
+    this->write_to_register(MPU_REG_MOT_THR, threshold > 255 ? 255 : threshold);
+    this->write_to_register(MPU_REG_MOT_DUR, duration_ms);
+    this->write_to_register(MPU_REG_INT_PIN_CFG, MPU_INT_PIN_CFG_RD_CLEAR);
+    this->write_to_register(MPU_REG_INT_ENABLE, MPU_INT_ENABLE_MOT);
+
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_IN);
+    gpio_set_irq_enabled_with_callback(gpio, GPIO_IRQ_EDGE_RISE, true, &MPU6050::gpio_irq_handler);
+
+    this->write_to_register(MPU_REG_PWR_MGMT_2, (rate << 6) | MPU_PWR_MGMT_2_STBY_GYRO);
+    this->write_to_register(MPU_REG_PWR_MGMT_1, MPU_PWR_MGMT_1_CYCLE | MPU_PWR_MGMT_1_TEMP_DIS);
+}
+
+void MPU6050::disable_motion_wakeup() {
+    if (this->motion_gpio >= 0) gpio_set_irq_enabled(this->motion_gpio, GPIO_IRQ_EDGE_RISE, false);
+    this->motion_gpio = -1;
+
+    this->write_to_register(MPU_REG_PWR_MGMT_1, 0);
+    this->write_to_register(MPU_REG_PWR_MGMT_2, 0);
+    this->write_to_register(MPU_REG_INT_ENABLE, 0);
+    this->write_to_register(MPU_REG_ACCEL_CONFIG, this->config.range << 3);
+
+    if (this->saved_data_ready_gpio >= 0) {
+        this->enable_data_ready_interrupt(this->saved_data_ready_gpio);
+        this->saved_data_ready_gpio = -1;
+    }
+    // The FIFO holds nothing but the wait, start from the first full rate sample
+    if (this->fifo_enabled) this->reset_fifo();
+}
+
+void MPU6050::set_motion_wakeup_gyro(bool enabled) {
+    if (this->motion_gpio < 0) return;
+
+    // The motion detection keeps running on the accel in both modes
+    if (enabled) {
+        this->write_to_register(MPU_REG_PWR_MGMT_1, 0);
+        this->write_to_register(MPU_REG_PWR_MGMT_2, 0);
+    } else {
+        this->write_to_register(MPU_REG_PWR_MGMT_2, (this->wake_rate << 6) | MPU_PWR_MGMT_2_STBY_GYRO);
+        this->write_to_register(MPU_REG_PWR_MGMT_1, MPU_PWR_MGMT_1_CYCLE | MPU_PWR_MGMT_1_TEMP_DIS);
+    }
+    if (this->fifo_enabled) this->reset_fifo();
+}
+
+uint64_t MPU6050::get_motion_time() {
+    uint32_t interrupts = save_and_disable_interrupts();
+    uint64_t motion_time = this->motion_time;
+    restore_interrupts(interrupts);
+    return motion_time;
+}
 
-    this->data.gyro.x = (((float)raw_gyro.x)- this->config.gyro_offset.x) / this->config.dps_per_digit;
-    this->data.gyro.y = (((float)raw_gyro.y) - this->config.gyro_offset.y) / this->config.dps_per_digit;
-    this->data.gyro.z = (((float)raw_gyro.z) - - this->config.gyro_offset.z) / this->config.dps_per_digit;    
+void MPU6050::on_data_ready(uint64_t timestamp) {
+    if (this->data_ready) this->data_ready_overruns++;
+    this->data_ready_time = timestamp;
+    this->data_ready = true;
 }
 
 bool MPU6050::test_connection() {
-    uint8_t* data = this->read_from_register(MPU_REG_WHO_AM_I, 1);
-    uint8_t data_cp = *data;
-    free(data);
-    return data_cp == this->addr;
+    std::array<uint8_t, 1> data = {0};
+    this->read_from_register(MPU_REG_WHO_AM_I, data);
+    return data[0] == this->addr;
 }
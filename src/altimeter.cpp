@@ -0,0 +1,84 @@
+#include "altimeter.hpp"
+#include <array>
+
+// Compile time ln and exp for the table, no constexpr std::pow
+static constexpr double constexpr_ln(double x) {
+    // x = m * 2^e with m in [1, 2), then ln(m) = 2 * atanh((m - 1) / (m + 1))
+    int e = 0;
+    while (x >= 2) { x /= 2; e++; }
+    while (x < 1) { x *= 2; e--; }
+    double z = (x - 1) / (x + 1);
+    double sum = 0;
+    double term = z;
+    for (int k = 1; k < 40; k += 2) {
+        sum += term / k;
+        term *= z * z;
+    }
+    return 2 * sum + e * 0.69314718055994530942;
+}
+
+static constexpr double constexpr_exp(double x) {
+    double sum = 1;
+    double term = 1;
+    for (int k = 1; k < 30; k++) {
+        term *= x / k;
+        sum += term;
+    }
+    return sum;
+}
+
+static constexpr double standard_altitude_m(double pressure_pa) {
+    return 44330.77 * (1 - constexpr_exp(0.190263 * constexpr_ln(pressure_pa / ALTIMETER_SEA_LEVEL_PA)));
+}
+
+typedef std::array<int32_t, ALTIMETER_TABLE_SIZE> altitude_table_t;
+
+static constexpr altitude_table_t build_altitude_table() {
+    altitude_table_t table = {};
+    for (uint32_t i = 0; i < ALTIMETER_TABLE_SIZE; i++) {
+        double altitude = standard_altitude_m(ALTIMETER_PRESSURE_MIN_PA + (i << ALTIMETER_STEP_SHIFT)) * 1000;
+        table[i] = (int32_t)(altitude < 0 ? altitude - 0.5 : altitude + 0.5);
+    }
+    return table;
+}
+
+static constexpr altitude_table_t altitude_table = build_altitude_table();
+
+// Offset from the table start in Q24.8 Pa: the entry, then a 12 bits fraction of the step.
+// The altitude step stays under 80m so delta * fraction fits 32 bits.
+static constexpr int32_t lookup_altitude_mm(uint32_t pressure) {
+    if (pressure <= (uint32_t)ALTIMETER_PRESSURE_MIN_PA << 8) return altitude_table[0];
+    if (pressure >= (uint32_t)ALTIMETER_PRESSURE_MAX_PA << 8) return altitude_table[ALTIMETER_TABLE_SIZE - 1];
+
+    uint32_t offset = pressure - ((uint32_t)ALTIMETER_PRESSURE_MIN_PA << 8);
+    uint32_t index = offset >> (ALTIMETER_STEP_SHIFT + 8);
+    int32_t fraction = (offset >> (ALTIMETER_STEP_SHIFT - 4)) & 0xFFF;
+    int32_t base = altitude_table[index];
+    int32_t delta = altitude_table[index + 1] - base;
+    return base + ((delta * fraction + 0x800) >> 12);
+}
+
+// Largest distance to the formula every 16Pa from 0 to 10km, in mm
+static constexpr double max_lookup_error_mm(double pressure_min_pa, double pressure_max_pa) {
+    double max_error = 0;
+    for (double pressure = pressure_min_pa; pressure <= pressure_max_pa; pressure += 16) {
+        double error = lookup_altitude_mm((uint32_t)(pressure * 256)) - standard_altitude_m(pressure) * 1000;
+        if (error < 0) error = -error;
+        if (error > max_error) max_error = error;
+    }
+    return max_error;
+}
+
+static_assert(altitude_table[0] > 11000000 && altitude_table[ALTIMETER_TABLE_SIZE - 1] < -500000, "table span");
+static_assert(lookup_altitude_mm(ALTIMETER_SEA_LEVEL_PA << 8) >= -10 && lookup_altitude_mm(ALTIMETER_SEA_LEVEL_PA << 8) <= 10, "sea level");
+// 26436Pa is the standard atmosphere pressure at 10km
+static_assert(max_lookup_error_mm(26436, ALTIMETER_SEA_LEVEL_PA) < 100, "0 to 10km error");
+
+void Altimeter::set_ground(uint32_t pressure) {
+    this->ground_pressure = pressure;
+    this->ground_altitude = lookup_altitude_mm(pressure);
+}
+
+int32_t Altimeter::to_standard_altitude_mm(uint32_t pressure) {
+    return lookup_altitude_mm(pressure);
+}
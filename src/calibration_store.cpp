@@ -0,0 +1,56 @@
+#include "calibration_store.hpp"
+#include <stddef.h>
+#include <string.h>
+#include "hardware/sync.h"
+
+static_assert(sizeof(calibration_record_t) <= FLASH_PAGE_SIZE, "The record is programmed as a single page");
+static_assert(CALIBRATION_STORE_OFFSET % FLASH_SECTOR_SIZE == 0, "The store must be sector aligned");
+
+CalibrationStore::CalibrationStore(): CalibrationStore(CALIBRATION_STORE_OFFSET) {}
+
+CalibrationStore::CalibrationStore(uint32_t flash_offset) {
+    this->flash_offset = flash_offset;
+}
+
+uint32_t CalibrationStore::crc32(const uint8_t* data, size_t len) {
+    // Bitwise reflected CRC32, runs once per boot so no table is kept
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+bool CalibrationStore::load(mpu6050_calibration_t* calibration) {
+    const calibration_record_t* record = this->get_record();
+    if (record->magic != CALIBRATION_STORE_MAGIC || record->version != CALIBRATION_STORE_VERSION) return false;
+    if (record->size != sizeof(calibration_record_t)) return false;
+    if (record->crc != crc32((const uint8_t*)record, offsetof(calibration_record_t, crc))) return false;
+
+    *calibration = record->mpu6050;
+    return true;
+}
+
+bool CalibrationStore::save(const mpu6050_calibration_t* calibration) {
+    // Erased flash reads 0xFF, pad the page the same way
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+
+    calibration_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.magic = CALIBRATION_STORE_MAGIC;
+    record.version = CALIBRATION_STORE_VERSION;
+    record.size = sizeof(calibration_record_t);
+    record.mpu6050 = *calibration;
+    record.crc = crc32((const uint8_t*)&record, offsetof(calibration_record_t, crc));
+    memcpy(page, &record, sizeof(record));
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(this->flash_offset, FLASH_SECTOR_SIZE);
+    flash_range_program(this->flash_offset, page, FLASH_PAGE_SIZE);
+    restore_interrupts(interrupts);
+
+    // Read back through XIP to catch a failed program
+    return memcmp(this->get_record(), &record, sizeof(record)) == 0;
+}
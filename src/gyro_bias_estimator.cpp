@@ -0,0 +1,91 @@
+#include "gyro_bias_estimator.hpp"
+
+GyroBiasEstimator::GyroBiasEstimator(float gyro_lsb_per_dps, float acc_lsb_per_g, vector3<int16_t> bias) {
+    float gyro_std = GYRO_BIAS_GYRO_STD_DPS * gyro_lsb_per_dps;
+    float acc_std = GYRO_BIAS_ACC_STD_G * acc_lsb_per_g;
+    float launch = GYRO_BIAS_LAUNCH_G * acc_lsb_per_g;
+    this->gyro_variance_limit = gyro_std * gyro_std;
+    this->acc_variance_limit = acc_std * acc_std;
+    this->motion_limit = GYRO_BIAS_MOTION_DPS * gyro_lsb_per_dps;
+    // Out of reach when past the range, the squared norm of int16 counts fits 32 bits unsigned
+    this->launch_limit_squared = launch >= INT16_MAX ? UINT32_MAX : (uint32_t)(launch * launch);
+
+    this->bias_q8 = {bias.x * 256, bias.y * 256, bias.z * 256};
+    this->reset_window();
+}
+
+void GyroBiasEstimator::reset_window() {
+    this->window_count = 0;
+    this->gyro_sum = {0, 0, 0};
+    this->gyro_square_sum = {0, 0, 0};
+    this->acc_sum = {0, 0, 0};
+    this->acc_square_sum = {0, 0, 0};
+}
+
+void GyroBiasEstimator::unfreeze() {
+    this->frozen = false;
+    this->reset_window();
+}
+
+static int32_t abs_count(int16_t count) {
+    return count < 0 ? -(int32_t)count : count;
+}
+
+bool GyroBiasEstimator::add_sample(const vector3<int16_t>& acc, const vector3<int16_t>& gyro) {
+    if (this->frozen) return false;
+
+    uint32_t acc_squared = (uint32_t)(acc.x * acc.x) + (uint32_t)(acc.y * acc.y) + (uint32_t)(acc.z * acc.z);
+    if (acc_squared > this->launch_limit_squared) {
+        this->frozen = true;
+        return false;
+    }
+    if (abs_count(gyro.x) > this->motion_limit || abs_count(gyro.y) > this->motion_limit || abs_count(gyro.z) > this->motion_limit) {
+        this->reset_window();
+        return false;
+    }
+
+    this->gyro_sum.x += gyro.x;
+    this->gyro_sum.y += gyro.y;
+    this->gyro_sum.z += gyro.z;
+    this->gyro_square_sum.x += gyro.x * gyro.x;
+    this->gyro_square_sum.y += gyro.y * gyro.y;
+    this->gyro_square_sum.z += gyro.z * gyro.z;
+    this->acc_sum.x += acc.x;
+    this->acc_sum.y += acc.y;
+    this->acc_sum.z += acc.z;
+    this->acc_square_sum.x += acc.x * acc.x;
+    this->acc_square_sum.y += acc.y * acc.y;
+    this->acc_square_sum.z += acc.z * acc.z;
+    if (++this->window_count < GYRO_BIAS_WINDOW_SAMPLES) return false;
+
+    bool still = this->is_window_still();
+    if (still) {
+        // The samples already have the bias removed, their mean is what is left of it
+        this->bias_q8.x += (this->gyro_sum.x * (256 >> GYRO_BIAS_WINDOW_SHIFT)) >> GYRO_BIAS_GAIN_SHIFT;
+        this->bias_q8.y += (this->gyro_sum.y * (256 >> GYRO_BIAS_WINDOW_SHIFT)) >> GYRO_BIAS_GAIN_SHIFT;
+        this->bias_q8.z += (this->gyro_sum.z * (256 >> GYRO_BIAS_WINDOW_SHIFT)) >> GYRO_BIAS_GAIN_SHIFT;
+        this->still_windows++;
+    }
+    this->reset_window();
+    return still;
+}
+
+static bool below_variance(int32_t sum, int64_t square_sum, int32_t limit) {
+    // n * sum(x^2) - sum(x)^2 is the variance scaled by n^2
+    int64_t scaled_variance = (square_sum << GYRO_BIAS_WINDOW_SHIFT) - (int64_t)sum * sum;
+    return scaled_variance <= ((int64_t)limit << (2 * GYRO_BIAS_WINDOW_SHIFT));
+}
+
+bool GyroBiasEstimator::is_window_still() {
+    return below_variance(this->gyro_sum.x, this->gyro_square_sum.x, this->gyro_variance_limit)
+        && below_variance(this->gyro_sum.y, this->gyro_square_sum.y, this->gyro_variance_limit)
+        && below_variance(this->gyro_sum.z, this->gyro_square_sum.z, this->gyro_variance_limit)
+        && below_variance(this->acc_sum.x, this->acc_square_sum.x, this->acc_variance_limit)
+        && below_variance(this->acc_sum.y, this->acc_square_sum.y, this->acc_variance_limit)
+        && below_variance(this->acc_sum.z, this->acc_square_sum.z, this->acc_variance_limit);
+}
+
+vector3<int16_t> GyroBiasEstimator::get_bias() {
+    // Rounded to nearest, the arithmetic shift floors negative values too
+    return {(int16_t)((this->bias_q8.x + 128) >> 8), (int16_t)((this->bias_q8.y + 128) >> 8), (int16_t)((this->bias_q8.z + 128) >> 8)};
+}
@@ -0,0 +1,226 @@
+#include "i2c_bus.hpp"
+#include "i2c_sensor.hpp"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+
+bool I2cBus::submit(i2c_transaction_t* transaction) {
+    if (transaction->status == I2C_TRANSACTION_PENDING) return false;
+    if (transaction->len == 0 || transaction->len > I2C_BUS_MAX_TRANSFER) {
+        transaction->status = I2C_TRANSACTION_ERROR;
+        return false;
+    }
+
+    transaction->status = I2C_TRANSACTION_PENDING;
+    transaction->next = nullptr;
+    if (this->head == nullptr) {
+        this->head = transaction;
+        this->tail = transaction;
+        transaction->deadline = time_us_64() + this->timeout_us(transaction->len + 3);
+        this->start(transaction);
+    } else {
+        this->tail->next = transaction;
+        this->tail = transaction;
+    }
+    return true;
+}
+
+bool I2cBus::poll() {
+    while (this->head != nullptr) {
+        i2c_transaction_t* transaction = this->head;
+        i2c_transaction_status status = this->check(transaction);
+        if (status == I2C_TRANSACTION_PENDING) {
+            if (time_us_64() < transaction->deadline) return true;
+            this->abort(transaction);
+            status = I2C_TRANSACTION_TIMEOUT;
+        }
+
+        this->head = transaction->next;
+        if (this->head == nullptr) this->tail = nullptr;
+        else {
+            this->head->deadline = time_us_64() + this->timeout_us(this->head->len + 3);
+            this->start(this->head);
+        }
+
+        transaction->status = status;
+        if (transaction->callback) transaction->callback(transaction);
+    }
+    return false;
+}
+
+void I2cBus::wait_idle() {
+    while (this->poll()) tight_loop_contents();
+}
+
+uint32_t I2cBus::timeout_us(size_t len) {
+    // 9 clocks per byte plus start, restart and stop
+    uint32_t clocks = len * 9 + 3;
+    return 2 * (clocks * 1000000 / this->baudrate) + I2C_TIMEOUT_MARGIN_US;
+}
+
+uint32_t I2cBus::negotiate_baudrate(I2cDevice** devices, uint8_t devices_count) {
+    const uint32_t ladder[] = {I2C_FAST_MODE_PLUS_BAUDRATE, I2C_FAST_MODE_BAUDRATE, I2C_STANDARD_MODE_BAUDRATE};
+
+    this->wait_idle();
+    for (uint32_t baudrate : ladder) {
+        this->set_baudrate(baudrate);
+
+        bool reliable = true;
+        for (uint8_t probe = 0; probe < I2C_NEGOTIATION_PROBES && reliable; probe++) {
+            for (uint8_t i = 0; i < devices_count && reliable; i++) {
+                reliable = devices[i]->test_connection();
+            }
+        }
+        if (reliable) return this->baudrate;
+    }
+    return 0;
+}
+
+void I2cBus::clear_bus(uint sda_pin, uint scl_pin) {
+    // Emulate open drain lines, output low to pull down and input to release on the pull-ups
+    gpio_set_function(sda_pin, GPIO_FUNC_SIO);
+    gpio_set_function(scl_pin, GPIO_FUNC_SIO);
+    gpio_put(sda_pin, false);
+    gpio_put(scl_pin, false);
+    gpio_set_dir(sda_pin, GPIO_IN);
+    gpio_set_dir(scl_pin, GPIO_IN);
+    busy_wait_us_32(5);
+
+    // Up to 9 clocks let a slave stuck mid-byte shift out the rest of it and release SDA
+    for (uint8_t i = 0; i < 9 && !gpio_get(sda_pin); i++) {
+        gpio_set_dir(scl_pin, GPIO_OUT);
+        busy_wait_us_32(5);
+        gpio_set_dir(scl_pin, GPIO_IN);
+        busy_wait_us_32(5);
+    }
+
+    // Stop condition: SDA rises while SCL is high
+    gpio_set_dir(scl_pin, GPIO_OUT);
+    busy_wait_us_32(5);
+    gpio_set_dir(sda_pin, GPIO_OUT);
+    busy_wait_us_32(5);
+    gpio_set_dir(scl_pin, GPIO_IN);
+    busy_wait_us_32(5);
+    gpio_set_dir(sda_pin, GPIO_IN);
+    busy_wait_us_32(5);
+}
+
+HardwareI2cBus::HardwareI2cBus(i2c_inst_t* i2c_port) {
+    this->i2c_port = i2c_port;
+}
+
+HardwareI2cBus* HardwareI2cBus::get(i2c_inst_t* i2c_port) {
+    static HardwareI2cBus bus0(i2c0);
+    static HardwareI2cBus bus1(i2c1);
+    return i2c_port == i2c1 ? &bus1 : &bus0;
+}
+
+uint32_t HardwareI2cBus::init(uint32_t baudrate, uint sda_pin, uint scl_pin) {
+    this->sda_pin = sda_pin;
+    this->scl_pin = scl_pin;
+    this->target_baudrate = baudrate;
+    this->baudrate = i2c_init(this->i2c_port, baudrate);
+    gpio_set_function(sda_pin, GPIO_FUNC_I2C);
+    gpio_set_function(scl_pin, GPIO_FUNC_I2C);
+    gpio_pull_up(sda_pin);
+    gpio_pull_up(scl_pin);
+    return this->baudrate;
+}
+
+uint32_t HardwareI2cBus::set_baudrate(uint32_t baudrate) {
+    this->wait_idle();
+    this->target_baudrate = baudrate;
+    this->baudrate = i2c_set_baudrate(this->i2c_port, baudrate);
+    return this->baudrate;
+}
+
+static i2c_status to_i2c_status(int result) {
+    if (result == PICO_ERROR_TIMEOUT) return I2C_TIMEOUT;
+    if (result < 0) return I2C_NACK;
+    return I2C_OK;
+}
+
+i2c_status HardwareI2cBus::write(uint8_t addr, const uint8_t* data, size_t len) {
+    this->wait_idle();
+    int result = i2c_write_timeout_us(this->i2c_port, addr, data, len, false, this->timeout_us(len + 1));
+    i2c_status status = to_i2c_status(result);
+    if (status == I2C_TIMEOUT) this->recover();
+    return status;
+}
+
+i2c_status HardwareI2cBus::read_register(uint8_t addr, uint8_t reg, uint8_t* data, size_t len) {
+    this->wait_idle();
+    int result = i2c_write_timeout_us(this->i2c_port, addr, &reg, 1, true, this->timeout_us(2));
+    if (result >= 0) result = i2c_read_timeout_us(this->i2c_port, addr, data, len, false, this->timeout_us(len + 1));
+    i2c_status status = to_i2c_status(result);
+    if (status == I2C_TIMEOUT) this->recover();
+    return status;
+}
+
+void HardwareI2cBus::recover() {
+    this->recoveries++;
+    i2c_deinit(this->i2c_port);
+
+    if (this->sda_pin >= 0 && this->scl_pin >= 0) {
+        I2cBus::clear_bus(this->sda_pin, this->scl_pin);
+        gpio_set_function(this->sda_pin, GPIO_FUNC_I2C);
+        gpio_set_function(this->scl_pin, GPIO_FUNC_I2C);
+    }
+    this->baudrate = i2c_init(this->i2c_port, this->target_baudrate);
+}
+
+void HardwareI2cBus::start(i2c_transaction_t* transaction) {
+    i2c_hw_t* hw = i2c_get_hw(this->i2c_port);
+    if (this->tx_dma < 0) {
+        this->tx_dma = dma_claim_unused_channel(true);
+        this->rx_dma = dma_claim_unused_channel(true);
+    }
+
+    hw->enable = 0;
+    hw->tar = transaction->addr;
+    hw->enable = 1;
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+    (void)hw->clr_tx_abrt;
+
+    // First word writes the register address, each next one clocks a byte in and the last one ends with a stop
+    this->cmd[0] = transaction->reg;
+    for (uint8_t i = 0; i < transaction->len; i++) {
+        this->cmd[i + 1] = I2C_IC_DATA_CMD_CMD_BITS;
+        if (i == 0) this->cmd[i + 1] |= I2C_IC_DATA_CMD_RESTART_BITS;
+        if (i == transaction->len - 1) this->cmd[i + 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+    }
+
+    dma_channel_config rx_config = dma_channel_get_default_config(this->rx_dma);
+    channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx_config, false);
+    channel_config_set_write_increment(&rx_config, true);
+    channel_config_set_dreq(&rx_config, i2c_get_dreq(this->i2c_port, false));
+    dma_channel_configure(this->rx_dma, &rx_config, transaction->data, &hw->data_cmd, transaction->len, true);
+
+    dma_channel_config tx_config = dma_channel_get_default_config(this->tx_dma);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&tx_config, true);
+    channel_config_set_write_increment(&tx_config, false);
+    channel_config_set_dreq(&tx_config, i2c_get_dreq(this->i2c_port, true));
+    dma_channel_configure(this->tx_dma, &tx_config, &hw->data_cmd, this->cmd, transaction->len + 1, true);
+}
+
+i2c_transaction_status HardwareI2cBus::check(i2c_transaction_t* transaction) {
+    i2c_hw_t* hw = i2c_get_hw(this->i2c_port);
+    if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        dma_channel_abort(this->tx_dma);
+        dma_channel_abort(this->rx_dma);
+        (void)hw->clr_tx_abrt;
+        hw->dma_cr = 0;
+        return I2C_TRANSACTION_ERROR;
+    }
+    if (dma_channel_is_busy(this->rx_dma)) return I2C_TRANSACTION_PENDING;
+    hw->dma_cr = 0;
+    return I2C_TRANSACTION_DONE;
+}
+
+void HardwareI2cBus::abort(i2c_transaction_t* transaction) {
+    dma_channel_abort(this->tx_dma);
+    dma_channel_abort(this->rx_dma);
+    i2c_get_hw(this->i2c_port)->dma_cr = 0;
+    this->recover();
+}
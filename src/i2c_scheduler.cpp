@@ -0,0 +1,113 @@
+#include "i2c_scheduler.hpp"
+
+static uint64_t default_clock() {
+    return time_us_64();
+}
+
+I2cScheduler::I2cScheduler(): I2cScheduler(default_clock) {}
+
+I2cScheduler::I2cScheduler(uint64_t (*clock)()) {
+    this->clock = clock;
+}
+
+uint32_t I2cScheduler::transfer_cost_us(uint8_t burst_length, uint32_t baudrate) {
+    // addr+W, reg, addr+R and data bytes are 9 clocks each, plus start, restart and stop
+    uint32_t clocks = (3 + burst_length) * 9 + 3;
+    return (clocks * 1000000 + baudrate - 1) / baudrate;
+}
+
+int I2cScheduler::add(I2cDevice* device) {
+    // Stagger devices sharing a bus so their deadlines do not collide on the same tick
+    uint32_t phase_us = 0;
+    for (uint8_t i = 0; i < this->entries_count; i++) {
+        if (this->entries[i].device->get_bus() == device->get_bus()) phase_us += this->entries[i].cost_us;
+    }
+    return this->add(device, phase_us);
+}
+
+int I2cScheduler::add(I2cDevice* device, uint32_t phase_us) {
+    if (this->entries_count >= I2C_SCHEDULER_MAX_DEVICES || device->get_freq() == 0) return -1;
+
+    i2c_schedule_entry_t* entry = &this->entries[this->entries_count];
+    device->set_clock(this->clock);
+    entry->device = device;
+    entry->period_us = 1000000 / device->get_freq();
+    entry->cost_us = transfer_cost_us(device->get_burst_length(), device->get_bus()->get_baudrate());
+    entry->deadline = this->clock() + phase_us;
+    entry->in_flight = false;
+    return this->entries_count++;
+}
+
+uint32_t I2cScheduler::run() {
+    uint32_t updated = 0;
+    uint64_t now = this->clock();
+
+    // Submit due reads earliest deadline first, the bus queue keeps that order.
+    // A raised data ready interrupt counts as the earliest possible deadline.
+    while (true) {
+        i2c_schedule_entry_t* next = nullptr;
+        uint64_t next_due = UINT64_MAX;
+        for (uint8_t i = 0; i < this->entries_count; i++) {
+            i2c_schedule_entry_t* entry = &this->entries[i];
+            if (entry->in_flight) continue;
+            uint64_t due = entry->deadline;
+            if (entry->device->is_interrupt_driven()) due = entry->device->is_data_ready() ? 0 : UINT64_MAX;
+            if (due > now) continue;
+            if (next == nullptr || due < next_due) {
+                next = entry;
+                next_due = due;
+            }
+        }
+        if (next == nullptr) break;
+
+        if (!next->device->is_interrupt_driven()) {
+            next->deadline += next->period_us;
+            if (next->deadline <= now) next->deadline = now + next->period_us;
+        }
+        next->in_flight = next->device->submit_read();
+        if (!next->in_flight) next->device->complete_update();
+    }
+
+    for (uint8_t i = 0; i < this->entries_count; i++) {
+        if (this->entries[i].in_flight) this->entries[i].device->get_bus()->poll();
+    }
+    for (uint8_t i = 0; i < this->entries_count; i++) {
+        i2c_schedule_entry_t* entry = &this->entries[i];
+        if (!entry->in_flight || entry->device->is_read_pending()) continue;
+        if (entry->device->complete_update()) updated |= 1u << i;
+        // A device may chain a second read from its completion, keep tracking it
+        entry->in_flight = entry->device->is_read_pending();
+    }
+    return updated;
+}
+
+void I2cScheduler::update_costs() {
+    for (uint8_t i = 0; i < this->entries_count; i++) {
+        I2cDevice* device = this->entries[i].device;
+        this->entries[i].cost_us = transfer_cost_us(device->get_burst_length(), device->get_bus()->get_baudrate());
+    }
+}
+
+void I2cScheduler::update_periods() {
+    for (uint8_t i = 0; i < this->entries_count; i++) {
+        uint16_t freq = this->entries[i].device->get_freq();
+        if (freq != 0) this->entries[i].period_us = 1000000 / freq;
+    }
+}
+
+uint32_t I2cScheduler::get_load_permille(I2cBus* bus) {
+    uint32_t load = 0;
+    for (uint8_t i = 0; i < this->entries_count; i++) {
+        if (this->entries[i].device->get_bus() != bus) continue;
+        load += this->entries[i].cost_us * 1000 / this->entries[i].period_us;
+    }
+    return load;
+}
+
+uint64_t I2cScheduler::get_next_deadline() {
+    uint64_t deadline = UINT64_MAX;
+    for (uint8_t i = 0; i < this->entries_count; i++) {
+        if (this->entries[i].deadline < deadline) deadline = this->entries[i].deadline;
+    }
+    return deadline;
+}
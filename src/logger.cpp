@@ -88,7 +88,6 @@ Logger::Logger(uint8_t miso_gpio, uint8_t ss_gpio, uint8_t sck_gpio, uint8_t mos
     fr = f_open(&file, filename, FA_WRITE|FA_CREATE_NEW);
     if (FR_OK != fr) { printf("f_open(%s) error: %s (%d)\n", filename, FRESULT_str(fr), fr); return; }
     if (f_printf(&file, "sep=,\n") < 0) { printf("f_printf failed\n"); return; }
-    if (f_printf(&file, "time,acc_x,acc_y,acc_z,gyro_x,gyro_y,gyro_z,pressure\n") < 0) { printf("f_printf failed\n"); return; }
     f_close(&file);
 
 #ifdef DEBUG
@@ -146,9 +145,29 @@ bool Logger::write_error(const char* message) {
     return true;
 }
 
-bool Logger::write_data(uint32_t time, float acc_x, float acc_y, float acc_z,  float gyro_x, float gyro_y, float gyro_z, float pressure) {
+bool Logger::write_data_header(const data_scale_t* scale) {
+    if (!this->has_sd_card_init) return false;
+    FIL file;
+    char filename[20];
+    sprintf(filename, "%s/%s", this->dir_name, this->data_filename);
+    FRESULT fr = f_open(&file, filename, FA_WRITE | FA_OPEN_APPEND);
+    if (FR_OK != fr) {
+        printf("f_open(%s) error: %s (%d)\n", filename, FRESULT_str(fr), fr);
+        return false;
+    }
+    // The records hold raw counts, the scale row is what turns them into g, dps and Pa
+    if (f_printf(&file, "acc_lsb_per_g,gyro_lsb_per_dps,pressure_lsb_per_pa\n%f,%f,%d\n", scale->acc_lsb_per_g, scale->gyro_lsb_per_dps, scale->pressure_lsb_per_pa) < 0
+        || f_printf(&file, "time,acc_x,acc_y,acc_z,gyro_x,gyro_y,gyro_z,pressure\n") < 0) {
+        printf("f_printf failed\n");
+        return false;
+    }
+    f_close(&file);
+    return true;
+}
+
+bool Logger::write_data(uint32_t time, int16_t acc_x, int16_t acc_y, int16_t acc_z, int16_t gyro_x, int16_t gyro_y, int16_t gyro_z, uint32_t pressure) {
 #ifdef DEBUG
-    printf("%d,%f,%f,%f,%f,%f,%f,%f\n", time, acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z, pressure);
+    printf("%d,%d,%d,%d,%d,%d,%d,%d\n", time, acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z, pressure);
 #endif
     if (!this->has_sd_card_init) return false;
     FIL file;
@@ -159,7 +178,7 @@ bool Logger::write_data(uint32_t time, float acc_x, float acc_y, float acc_z,  f
         printf("f_open(%s) error: %s (%d)\n", filename, FRESULT_str(fr), fr);
         return false;
     }
-    if (f_printf(&file, "%d,%f,%f,%f,%f,%f,%f,%f\n", time, acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z, pressure) < 0) {
+    if (f_printf(&file, "%d,%d,%d,%d,%d,%d,%d,%d\n", time, acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z, pressure) < 0) {
         printf("f_printf failed\n");
         return false;
     }
@@ -178,9 +197,9 @@ int Logger::write_all_data_from_fifo() {
 
     int written_data = 0;
     while(this->fifo_head!=this->fifo_tail) {
-        if (f_printf(&file, "%d,%f,%f,%f,%f,%f,%f,%f\n", this->fifo[this->fifo_head].time, this->fifo[this->fifo_head].acc.x, this->fifo[this->fifo_head].acc.y, this->fifo[this->fifo_head].acc.z, this->fifo[this->fifo_head].gyro.x, this->fifo[this->fifo_head].gyro.y, this->fifo[this->fifo_head].gyro.z, this->fifo[this->fifo_head].pressure) < 0) printf("f_printf failed\n");
+        if (f_printf(&file, "%d,%d,%d,%d,%d,%d,%d,%d\n", this->fifo[this->fifo_head].time, this->fifo[this->fifo_head].acc.x, this->fifo[this->fifo_head].acc.y, this->fifo[this->fifo_head].acc.z, this->fifo[this->fifo_head].gyro.x, this->fifo[this->fifo_head].gyro.y, this->fifo[this->fifo_head].gyro.z, this->fifo[this->fifo_head].pressure) < 0) printf("f_printf failed\n");
 #ifdef DEBUG
-        printf("%d,%f,%f,%f,%f,%f,%f,%f\n", this->fifo[this->fifo_head].time, this->fifo[this->fifo_head].acc.x, this->fifo[this->fifo_head].acc.y, this->fifo[this->fifo_head].acc.z, this->fifo[this->fifo_head].gyro.x, this->fifo[this->fifo_head].gyro.y, this->fifo[this->fifo_head].gyro.z, this->fifo[this->fifo_head].pressure);
+        printf("%d,%d,%d,%d,%d,%d,%d,%d\n", this->fifo[this->fifo_head].time, this->fifo[this->fifo_head].acc.x, this->fifo[this->fifo_head].acc.y, this->fifo[this->fifo_head].acc.z, this->fifo[this->fifo_head].gyro.x, this->fifo[this->fifo_head].gyro.y, this->fifo[this->fifo_head].gyro.z, this->fifo[this->fifo_head].pressure);
 #endif
         this->fifo_head = (this->fifo_head + 1) % FIFO_SIZE;
         written_data++;
@@ -10,15 +10,59 @@
 #include "pico/binary_info.h"
 #include "pico/multicore.h"
 #include "hardware/i2c.h"
+#ifdef DEBUG
+#include "hardware/structs/systick.h"
+#endif
 
 #include "WS2812.hpp"
 #include "MPU6050.hpp"
 #include "BMP280.hpp"
 #include "logger.hpp"
+#include "i2c_scheduler.hpp"
+#include "calibration_store.hpp"
+#include "gyro_bias_estimator.hpp"
+#include "altimeter.hpp"
+#include "board.hpp"
 
 #define LED_PIN 16
 #define LED_LENGTH 1
 
+// Drain the MPU6050 through its FIFO instead of one read per data ready interrupt
+#define MPU6050_FIFO_MODE 1
+// Gyro samples of the full calibration and of the boot check of a stored one, at the 1kHz ODR
+#define MPU6050_CALIBRATION_SAMPLES 1000
+#define MPU6050_VERIFY_SAMPLES 200
+// Bench procedure at boot: the board is rested on each of its six faces for the accel offsets and
+// scales, then they are stored with the gyro calibration. Off for flight.
+#define MPU6050_ACCEL_CALIBRATION 0
+#define MPU6050_ACCEL_POSITION_SAMPLES 500
+// The BMP280 hangs off the MPU6050 auxiliary bus and is mirrored into every MPU6050 read
+#define BMP280_MPU6050_AUX 0
+// The loop triggers the BMP280 conversions right after an MPU6050 read instead of letting it free-run
+#define BMP280_FORCED_MODE 0
+#define BMP280_FORCED_PERIOD_US 10000
+#if BMP280_FORCED_MODE && BMP280_MPU6050_AUX
+#error "Forced BMP280 conversions need the BMP280 on its own bus"
+#endif
+// Near apogee the airspeed, and with it the drag, is low: the accelerometers read close to free fall.
+// After that many samples in a row the BMP280 trades its boost latency for the apogee resolution.
+#define APOGEE_PROFILE_MAX_MG 300
+#define APOGEE_PROFILE_SAMPLES 100
+
+// Sleep on the pad until the MPU6050 detects motion, with a 1Hz housekeeping row meanwhile.
+// The gyro is off while waiting, it is powered up for one bias estimation window every
+// PAD_WAIT_GYRO_WINDOW_MS so the bias keeps tracking the pad temperature.
+#define PAD_WAIT_LOW_POWER 1
+#define PAD_WAIT_MOTION_THRESHOLD_MG 100
+#define PAD_WAIT_MOTION_DURATION_MS 2
+#define PAD_WAIT_HOUSEKEEPING_MS 1000
+#define PAD_WAIT_GYRO_WINDOW_MS 10000
+// Gyro start-up time, the samples before it are not settled
+#define PAD_WAIT_GYRO_STARTUP_US 30000
+// Interrupt to full rate acquisition, the gyros still need their ~30ms startup after it
+#define PAD_WAIT_MAX_WAKE_LATENCY_US 2000
+#define SYS_CLOCK_KHZ 125000
+
 #define WRITE_LOG 0x0001
 #define WRITE_DATA 0x0002
 #define SHUTDOWN_CORE 0xf003
@@ -44,6 +88,210 @@ void start_blink_green() {
     start_blink(&built_in_led, 0, 255, 0, 100);
 }
 
+// Negotiate the speed of one bus with the devices wired on it and log the result
+void negotiate_i2c_speed(HardwareI2cBus* bus, I2cDevice** devices, uint8_t devices_count) {
+    I2cDevice* bus_devices[I2C_SCHEDULER_MAX_DEVICES];
+    uint8_t bus_devices_count = 0;
+    for (uint8_t i = 0; i < devices_count; i++) {
+        if (devices[i]->get_bus() == bus) bus_devices[bus_devices_count++] = devices[i];
+    }
+
+    char message[64];
+    uint32_t baudrate = bus->negotiate_baudrate(bus_devices, bus_devices_count);
+    if (baudrate != 0) {
+        sprintf(message, "I2C%d bus running at %lu Hz", i2c_hw_index(bus->get_port()), (unsigned long)baudrate);
+        Logger::logger->write_log(message);
+    } else {
+        sprintf(message, "I2C%d speed negotiation failed, staying at 100kHz", i2c_hw_index(bus->get_port()));
+        Logger::logger->write_error(message);
+    }
+}
+
+// Deviation of every axis from its factory trim, the result is an error when one is out of tolerance
+void log_self_test(const mpu6050_self_test_t* self_test) {
+    char message[128];
+    sprintf(message, "MPU6050 self-test %s, trim deviation %% acc %d %d %d gyro %d %d %d", self_test->passed ? "passed" : "failed",
+        self_test->acc_deviation.x, self_test->acc_deviation.y, self_test->acc_deviation.z,
+        self_test->gyro_deviation.x, self_test->gyro_deviation.y, self_test->gyro_deviation.z);
+    if (self_test->passed) Logger::logger->write_log(message);
+    else Logger::logger->write_error(message);
+}
+
+// Faces are taken in any order, each one once it is held still long enough
+void calibrate_accel(MPU6050* mpu6050) {
+    Logger::logger->write_log("MPU6050 accel calibration, rest the board on each face...");
+    mpu6050->start_accel_calibration();
+    while (!mpu6050->is_accel_calibration_complete()) {
+        mpu6050_accel_position position = mpu6050->add_accel_position(MPU6050_ACCEL_POSITION_SAMPLES);
+        if (position == MPU6050_ACCEL_POSITION_NONE) continue;
+        char message[48];
+        sprintf(message, "MPU6050 accel face %d taken", position);
+        Logger::logger->write_log(message);
+    }
+    if (!mpu6050->finish_accel_calibration()) Logger::logger->write_error("MPU6050 accel calibration out of tolerance, not applied");
+}
+
+#ifdef DEBUG
+// Host cycles only rank the kernels, the M0+ has no FPU and its soft-float divide is what they replace.
+// SysTick counts clk_sys cycles down on 24 bits, the loop overhead is included in both figures.
+#define CONVERSION_CYCLES_RUNS 256
+
+uint32_t systick_cycles_since(uint32_t start) {
+    return (start - systick_hw->cvr) & M0PLUS_SYST_CVR_BITS;
+}
+
+// Six conversions per sample, as in bench_acquisition, the Q16 kernels against the float division
+void log_conversion_cycles(MPU6050* mpu6050) {
+    systick_hw->rvr = M0PLUS_SYST_RVR_BITS;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+    volatile float acc_lsb_per_g = mpu6050->get_config().range_per_digit;
+    volatile float gyro_lsb_per_dps = mpu6050->get_config().dps_per_digit;
+    volatile int32_t sink = 0;
+
+    uint32_t start = systick_hw->cvr;
+    for (int32_t i = 0; i < CONVERSION_CYCLES_RUNS; i++) {
+        int16_t count = (int16_t)(i * 7919);
+        sink = sink + mpu6050->to_mg(count) + mpu6050->to_mg(count + 1) + mpu6050->to_mg(count + 2)
+            + mpu6050->to_mdps(count) + mpu6050->to_mdps(count + 1) + mpu6050->to_mdps(count + 2);
+    }
+    uint32_t fixed_cycles = systick_cycles_since(start);
+
+    start = systick_hw->cvr;
+    for (int32_t i = 0; i < CONVERSION_CYCLES_RUNS; i++) {
+        int16_t count = (int16_t)(i * 7919);
+        sink = sink + (int32_t)((float)count / acc_lsb_per_g * 1000) + (int32_t)((float)(count + 1) / acc_lsb_per_g * 1000)
+            + (int32_t)((float)(count + 2) / acc_lsb_per_g * 1000) + (int32_t)((float)count / gyro_lsb_per_dps * 1000)
+            + (int32_t)((float)(count + 1) / gyro_lsb_per_dps * 1000) + (int32_t)((float)(count + 2) / gyro_lsb_per_dps * 1000);
+    }
+    uint32_t float_cycles = systick_cycles_since(start);
+    systick_hw->csr = 0;
+
+    printf("MPU6050 unit conversion per sample: Q16 %lu cycles, float %lu cycles\n",
+        (unsigned long)(fixed_cycles / CONVERSION_CYCLES_RUNS), (unsigned long)(float_cycles / CONVERSION_CYCLES_RUNS));
+}
+#endif
+
+void push_sample(data_t* data, const MPU6050_DATA* sample, uint32_t pressure) {
+    data->time = (uint32_t)sample->timestamp;
+    data->acc.x = sample->acc.x;
+    data->acc.y = sample->acc.y;
+    data->acc.z = sample->acc.z;
+    data->gyro.x = sample->gyro.x;
+    data->gyro.y = sample->gyro.y;
+    data->gyro.z = sample->gyro.z;
+    data->pressure = pressure;
+
+    Logger::logger->push_data_to_fifo(data);
+}
+
+void track_gyro_bias(MPU6050* mpu6050, GyroBiasEstimator* gyro_bias, const MPU6050_DATA* sample) {
+    if (gyro_bias->add_sample(sample->acc, sample->gyro)) mpu6050->set_gyro_offset(gyro_bias->get_bias());
+}
+
+void count_free_fall(MPU6050* mpu6050, const MPU6050_DATA* sample, uint16_t* free_fall_samples) {
+    int32_t x = mpu6050->to_mg(sample->acc.x);
+    int32_t y = mpu6050->to_mg(sample->acc.y);
+    int32_t z = mpu6050->to_mg(sample->acc.z);
+    if (x * x + y * y + z * z > APOGEE_PROFILE_MAX_MG * APOGEE_PROFILE_MAX_MG) *free_fall_samples = 0;
+    else if (*free_fall_samples < APOGEE_PROFILE_SAMPLES) (*free_fall_samples)++;
+}
+
+// The bus dividers come from clk_peri, which follows clk_sys: set them again after each change
+void reapply_i2c_speeds(MPU6050* mpu6050, BMP280* bmp280) {
+    mpu6050->get_bus()->reapply_baudrate();
+    if (bmp280->get_bus() != mpu6050->get_bus()) bmp280->get_bus()->reapply_baudrate();
+}
+
+// One estimator window of settled gyro samples while still armed for motion, cut short by it
+void pad_gyro_window(MPU6050* mpu6050, GyroBiasEstimator* gyro_bias) {
+    mpu6050->set_motion_wakeup_gyro(true);
+    uint64_t settled = time_us_64() + PAD_WAIT_GYRO_STARTUP_US;
+    gyro_bias->reset_window();
+
+    uint16_t samples = 0;
+    while (samples < GYRO_BIAS_WINDOW_SAMPLES && !mpu6050->is_motion_detected()) {
+        if (mpu6050->update() != I2C_OK) continue;
+#if MPU6050_FIFO_MODE
+        for (uint8_t i = 0; i < mpu6050->batch.count && samples < GYRO_BIAS_WINDOW_SAMPLES; i++) {
+            if (mpu6050->batch.samples[i].timestamp < settled) continue;
+            track_gyro_bias(mpu6050, gyro_bias, &mpu6050->batch.samples[i]);
+            samples++;
+        }
+#else
+        if (mpu6050->data.timestamp < settled) continue;
+        track_gyro_bias(mpu6050, gyro_bias, &mpu6050->data);
+        samples++;
+#endif
+    }
+    mpu6050->set_motion_wakeup_gyro(false);
+}
+
+// Armed on the pad, the altitudes are relative to the pressure here
+void set_ground_reference(Altimeter* altimeter, uint32_t pressure) {
+    altimeter->set_ground(pressure);
+
+    char message[64];
+    sprintf(message, "Ground reference %.2f Pa", BMP280::to_pascal(pressure));
+    Logger::logger->write_log(message);
+}
+
+// Core1 must be parked: core0 sleeps between housekeeping rows at a lowered clock.
+// The ground reference follows the weather with the pad profile results, one forced
+// conversion per row read at the next one.
+void pad_wait(MPU6050* mpu6050, BMP280* bmp280, Altimeter* altimeter, GyroBiasEstimator* gyro_bias) {
+    Logger::logger->write_log("Pad wait, sleeping until motion...");
+#if !BMP280_MPU6050_AUX
+    bmp280->set_mode(BMP280_MODE_FORCED);
+    bmp280->set_profile(BMP280_PROFILE_PAD);
+    bmp280->trigger();
+#endif
+    mpu6050->enable_motion_wakeup(BOARD_MPU6050_INT_PIN, PAD_WAIT_MOTION_THRESHOLD_MG, PAD_WAIT_MOTION_DURATION_MS, MPU6050_WAKE_5HZ);
+    // The SD card just runs slower until the clock is back
+    set_sys_clock_48mhz();
+    reapply_i2c_speeds(mpu6050, bmp280);
+
+    absolute_time_t next_housekeeping = make_timeout_time_ms(PAD_WAIT_HOUSEKEEPING_MS);
+    uint64_t next_gyro_window = time_us_64();
+    while (!mpu6050->is_motion_detected()) {
+        // The motion interrupt ends the wait early
+        if (!best_effort_wfe_or_timeout(next_housekeeping)) continue;
+        next_housekeeping = make_timeout_time_ms(PAD_WAIT_HOUSEKEEPING_MS);
+
+        if (time_us_64() >= next_gyro_window) {
+            pad_gyro_window(mpu6050, gyro_bias);
+            next_gyro_window = time_us_64() + PAD_WAIT_GYRO_WINDOW_MS * 1000;
+        }
+        mpu6050->update_only_acc();
+#if !BMP280_MPU6050_AUX
+        // Mirrored through the MPU6050 the pressure is only refreshed once awake
+        if (bmp280->update() == I2C_OK && bmp280->data.fresh) altimeter->set_ground(bmp280->data.pressure);
+        bmp280->trigger();
+#endif
+        const vector3<int16_t>& acc = mpu6050->data.acc;
+        Logger::logger->write_data(time_us_32(), acc.x, acc.y, acc.z, 0, 0, 0, bmp280->data.pressure);
+    }
+
+    // Both from the timestamp the motion interrupt took
+    uint64_t awake_time = time_us_64();
+    set_sys_clock_khz(SYS_CLOCK_KHZ, true);
+    reapply_i2c_speeds(mpu6050, bmp280);
+    mpu6050->disable_motion_wakeup();
+#if !BMP280_MPU6050_AUX
+    // Lowest latency for the boost, the scheduler is set up after the wait and reads at its rate
+    bmp280->set_mode(BMP280_MODE_NORMAL);
+    bmp280->set_profile(BMP280_PROFILE_ASCENT);
+#endif
+    uint64_t full_rate_time = time_us_64();
+
+    char message[96];
+    unsigned long awake_latency = awake_time - mpu6050->get_motion_time();
+    unsigned long full_rate_latency = full_rate_time - mpu6050->get_motion_time();
+    sprintf(message, "Motion wake, core awake after %lu us, full rate after %lu us", awake_latency, full_rate_latency);
+    if (full_rate_latency <= PAD_WAIT_MAX_WAKE_LATENCY_US) Logger::logger->write_log(message);
+    else Logger::logger->write_error(message);
+}
+
 void core1_main() {
     uint32_t command;
     while(true) {
@@ -71,8 +319,6 @@ void core1_main() {
 int main() {
     // Enable UART so we can print status output
     stdio_init_all();
-    Logger::logger = new Logger(0, 1, 2, 3, 12500 * 1000, spi0);
-    Logger::logger->write_log("RP2040 log start!");
 
 #if !defined(i2c_default) || !defined(PICO_DEFAULT_I2C_SDA_PIN) || !defined(PICO_DEFAULT_I2C_SCL_PIN)
 #warning i2c/bus_scan example requires a board with I2C pins
@@ -83,26 +329,88 @@ int main() {
     built_in_led.show();
     multicore_launch_core1(start_blink_red);
 
-    // Init I2C 0 with 400KHz
-    i2c_init(i2c_default, 400 * 1000);
-    gpio_set_function(PICO_DEFAULT_I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(PICO_DEFAULT_I2C_SCL_PIN, GPIO_FUNC_I2C);
-    gpio_pull_up(PICO_DEFAULT_I2C_SDA_PIN);
-    gpio_pull_up(PICO_DEFAULT_I2C_SCL_PIN);
+    // Init the sensors buses at standard speed, the final speed is negotiated once the sensors are up
+    HardwareI2cBus* mpu6050_bus = HardwareI2cBus::get(BOARD_MPU6050_I2C);
+    HardwareI2cBus* bmp280_bus = HardwareI2cBus::get(BOARD_BMP280_I2C);
+    mpu6050_bus->init(I2C_STANDARD_MODE_BAUDRATE, BOARD_I2C_SDA_PIN(BOARD_MPU6050_I2C), BOARD_I2C_SCL_PIN(BOARD_MPU6050_I2C));
+    if (bmp280_bus != mpu6050_bus) {
+        bmp280_bus->init(I2C_STANDARD_MODE_BAUDRATE, BOARD_I2C_SDA_PIN(BOARD_BMP280_I2C), BOARD_I2C_SCL_PIN(BOARD_BMP280_I2C));
+    }
 
     // Make the I2C pins available to picotool
-    bi_decl(bi_2pins_with_func(PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN, GPIO_FUNC_I2C));
+    bi_decl(bi_2pins_with_func(BOARD_I2C0_SDA_PIN, BOARD_I2C0_SCL_PIN, GPIO_FUNC_I2C));
+    bi_decl(bi_2pins_with_func(BOARD_I2C1_SDA_PIN, BOARD_I2C1_SCL_PIN, GPIO_FUNC_I2C));
 
-    MPU6050 mpu6050(0x68, (uint8_t)1000);
+    MPU6050 mpu6050(0x68, 1000, mpu6050_bus);
     mpu6050.set_accel_range(mpu_6050_range::MPU6050_RANGE_16G);
     mpu6050.set_gyro_scale(mpu_6050_scale::MPU6050_SCALE_1000DPS);
-    BMP280 bmp280(0x76);
+    // The self-test mostly waits on the sensor to settle, the SD card mounts and the BMP280 starts meanwhile
+    mpu6050.start_self_test();
+
+    Logger::logger = new Logger(0, 1, 2, 3, 12500 * 1000, spi0);
+    Logger::logger->write_log("RP2040 log start!");
+    mpu6050.step_self_test();
+
+#if BMP280_MPU6050_AUX
+    // Set the BMP280 up through the bypass, then the MPU6050 master owns the auxiliary bus
+    mpu6050.set_aux_bypass(true);
+    BMP280 bmp280(0x76, mpu6050_bus);
+    bool bmp280_connected = bmp280.test_connection();
+    mpu6050.enable_aux_slave(bmp280.get_addr(), BMP280_REG_PRESSURE_MSB, bmp280.get_burst_length());
+    I2cDevice* i2c_devices[] = {&mpu6050};
+#else
+    BMP280 bmp280(0x76, bmp280_bus);
+    I2cDevice* i2c_devices[] = {&mpu6050, &bmp280};
+#endif
+    uint8_t i2c_devices_count = sizeof(i2c_devices) / sizeof(i2c_devices[0]);
+    mpu6050.step_self_test();
+
+    negotiate_i2c_speed(mpu6050_bus, i2c_devices, i2c_devices_count);
+    if (bmp280_bus != mpu6050_bus) negotiate_i2c_speed(bmp280_bus, i2c_devices, i2c_devices_count);
 
-    mpu6050.calibrate(1000);
+    while (mpu6050.step_self_test() != MPU6050_SELF_TEST_DONE) tight_loop_contents();
+    log_self_test(&mpu6050.get_self_test());
+
+    // A stored calibration only needs a short check, the full one runs when it is missing or stale
+    CalibrationStore calibration_store;
+    mpu6050_calibration_t calibration;
+    bool calibration_loaded = calibration_store.load(&calibration);
+    // The accel terms come from the bench procedure, they hold whatever the gyro check finds
+    if (calibration_loaded) mpu6050.set_calibration(calibration);
+    bool calibration_stale = !calibration_loaded || !mpu6050.verify_calibration(calibration, MPU6050_VERIFY_SAMPLES);
+    if (calibration_stale) {
+        Logger::logger->write_log("MPU6050 calibration missing or stale, calibrating...");
+        // A stale one taken at another temperature gives the drift
+        mpu6050.calibrate(MPU6050_CALIBRATION_SAMPLES, calibration_loaded ? &calibration : nullptr);
+    } else {
+        Logger::logger->write_log("MPU6050 stored calibration verified");
+    }
+#if MPU6050_ACCEL_CALIBRATION
+    calibrate_accel(&mpu6050);
+    calibration_stale = true;
+#endif
+#if MPU6050_FIFO_MODE
+    mpu6050.enable_fifo();
+#else
+    mpu6050.enable_data_ready_interrupt(BOARD_MPU6050_INT_PIN);
+#endif
     multicore_reset_core1();
 
+    // Core1 is stopped, the flash can be programmed
+    if (calibration_stale) {
+        calibration = mpu6050.get_calibration();
+        if (!calibration_store.save(&calibration)) Logger::logger->write_error("MPU6050 calibration save failed");
+    }
+
+    // Samples are logged as raw counts, the scale goes once at the top of the data file
+    data_scale_t scale = {mpu6050.get_config().range_per_digit, mpu6050.get_config().dps_per_digit, 256};
+    Logger::logger->write_data_header(&scale);
+
     multicore_launch_core1(start_blink_green);
     Logger::logger->write_log("Initialized");
+#ifdef DEBUG
+    log_conversion_cycles(&mpu6050);
+#endif
     if (mpu6050.test_connection()) Logger::logger->write_log("MPU6050 connection successful");
     else {
         Logger::logger->write_error("MPU6050 connection failed");
@@ -110,7 +418,15 @@ int main() {
         built_in_led.show();
         return 1;
     }
-    if (bmp280.test_connection()) Logger::logger->write_log("HW611 connection successful");
+    if (!mpu6050.get_self_test().passed) {
+        built_in_led.fill(WS2812::RGB(100, 0, 100));
+        built_in_led.show();
+        return 1;
+    }
+#if !BMP280_MPU6050_AUX
+    bool bmp280_connected = bmp280.test_connection();
+#endif
+    if (bmp280_connected) Logger::logger->write_log("HW611 connection successful");
     else {
         Logger::logger->write_error("HW611 connection failed");
         built_in_led.fill(WS2812::RGB(100, 0, 100));
@@ -130,7 +446,39 @@ int main() {
     built_in_led.fill(WS2812::RGB(0, 100, 0));
     built_in_led.show();
     sleep_ms(1000);
+
+    Altimeter altimeter;
+#if !BMP280_MPU6050_AUX
+    if (bmp280.update() == I2C_OK) set_ground_reference(&altimeter, bmp280.data.pressure);
+#endif
+
+    // Keeps the gyro bias fresh while waiting on the pad, frozen by the launch acceleration
+    GyroBiasEstimator gyro_bias(mpu6050.get_config().dps_per_digit, mpu6050.get_config().range_per_digit, mpu6050.get_config().gyro_offset);
     
+#if PAD_WAIT_LOW_POWER
+    built_in_led.fill(WS2812::RGB(0, 0, 20));
+    built_in_led.show();
+    pad_wait(&mpu6050, &bmp280, &altimeter, &gyro_bias);
+#endif
+
+#if BMP280_FORCED_MODE
+    // Collected by the scheduler once the conversion is guaranteed done
+    bmp280.set_mode(BMP280_MODE_FORCED);
+#endif
+    // Full table or a zero rate, checked before core1 is started
+    I2cScheduler scheduler;
+    int mpu6050_slot = scheduler.add(&mpu6050);
+    bool scheduled = mpu6050_slot >= 0;
+#if !BMP280_MPU6050_AUX
+    scheduled = scheduled && scheduler.add(&bmp280) >= 0;
+#endif
+    if (!scheduled) {
+        Logger::logger->write_error("I2C scheduler rejected a sensor");
+        built_in_led.fill(WS2812::RGB(100, 0, 100));
+        built_in_led.show();
+        return 1;
+    }
+
     built_in_led.fill(WS2812::RGB(100, 100, 0));
     built_in_led.show();
     Logger::logger->write_log("Initialize finish starting core1...");
@@ -138,25 +486,57 @@ int main() {
     multicore_fifo_drain();
     Logger::logger->write_log("Starting loop...");
 
+    // Each sensor is read at its own rate, the transfers are done by DMA while core0 is free
+    // and run concurrently when the sensors sit on different buses
+#if BMP280_FORCED_MODE
+    uint64_t bmp280_next_trigger = time_us_64();
+#endif
+
     data_t data;
+    uint16_t free_fall_samples = 0;
+    bool apogee_profile = false;
     while(true) {
 #ifdef DEBUG
         uint32_t startTime = time_us_32();
 #endif
 
-        mpu6050.update();
-        bmp280.update();
-
-        data.time = time_us_32();
-        data.acc.x = mpu6050.data.acc.x;
-        data.acc.y = mpu6050.data.acc.y;
-        data.acc.z = mpu6050.data.acc.z;
-        data.gyro.x = mpu6050.data.gyro.x;
-        data.gyro.y = mpu6050.data.gyro.y;
-        data.gyro.z = mpu6050.data.gyro.z;
-        data.pressure = bmp280.data.pressure;
+        uint32_t updated = scheduler.run();
+        if (!(updated & (1u << mpu6050_slot))) continue;
+#if BMP280_MPU6050_AUX
+        // Same sample time as the motion data, no transaction of its own
+        bmp280.decode_mirrored(mpu6050.get_ext_data(), mpu6050.data.timestamp);
+#endif
+#if BMP280_FORCED_MODE
+        // Same phase of the loop every time, a trigger still being converted waits for the next read
+        uint64_t now = time_us_64();
+        if (now >= bmp280_next_trigger && bmp280.trigger() == I2C_OK) {
+            bmp280_next_trigger += BMP280_FORCED_PERIOD_US;
+            if (bmp280_next_trigger <= now) bmp280_next_trigger = now + BMP280_FORCED_PERIOD_US;
+        }
+#endif
+        // Mirrored, or failed at arm time, the first result is the ground
+        if (!altimeter.has_ground() && bmp280.data.fresh) set_ground_reference(&altimeter, bmp280.data.pressure);
 
-        Logger::logger->push_data_to_fifo(&data);
+#if MPU6050_FIFO_MODE
+        for (uint8_t i = 0; i < mpu6050.batch.count; i++) {
+            push_sample(&data, &mpu6050.batch.samples[i], bmp280.data.pressure);
+            track_gyro_bias(&mpu6050, &gyro_bias, &mpu6050.batch.samples[i]);
+            count_free_fall(&mpu6050, &mpu6050.batch.samples[i], &free_fall_samples);
+        }
+#else
+        push_sample(&data, &mpu6050.data, bmp280.data.pressure);
+        track_gyro_bias(&mpu6050, &gyro_bias, &mpu6050.data);
+        count_free_fall(&mpu6050, &mpu6050.data, &free_fall_samples);
+#endif
+#if !BMP280_MPU6050_AUX
+        // Once, the new measurement period is picked up by the scheduler
+        if (!apogee_profile && free_fall_samples >= APOGEE_PROFILE_SAMPLES) {
+            bmp280.set_profile(BMP280_PROFILE_APOGEE);
+            scheduler.update_periods();
+            apogee_profile = true;
+            Logger::logger->write_log("Near apogee, BMP280 apogee profile");
+        }
+#endif
 
         // if(time_us_32() > 30 * 1000000) {
         //     multicore_fifo_push_blocking(SHUTDOWN_CORE);
@@ -166,7 +546,7 @@ int main() {
 #ifdef DEBUG
         uint32_t executionTime = time_us_32() - startTime;
         //printf("%d\t%d\t%d\t%d\t%d\t%d\t%d\t%f\n", executionTime, mpu6050.raw_acc[0], mpu6050.raw_acc[1], mpu6050.raw_acc[2], mpu6050.raw_gyro[0], mpu6050.raw_gyro[1], mpu6050.raw_gyro[2], mpu6050.temp);
-        printf("%d\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%.3f\n", executionTime, mpu6050.data.acc.x, mpu6050.data.acc.y, mpu6050.data.acc.z, mpu6050.data.gyro.x, mpu6050.data.gyro.y, mpu6050.data.gyro.z, bmp280.data.temp, bmp280.data.pressure);
+        printf("%d\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%f\t%.3f\t%ld\n", executionTime, (long)mpu6050.to_mg(mpu6050.data.acc.x), (long)mpu6050.to_mg(mpu6050.data.acc.y), (long)mpu6050.to_mg(mpu6050.data.acc.z), (long)mpu6050.to_mdps(mpu6050.data.gyro.x), (long)mpu6050.to_mdps(mpu6050.data.gyro.y), (long)mpu6050.to_mdps(mpu6050.data.gyro.z), BMP280::to_celsius(bmp280.data.temp), BMP280::to_pascal(bmp280.data.pressure), (long)altimeter.get_altitude_mm(bmp280.data.pressure));
 #endif
     }
     sleep_ms(100);
@@ -0,0 +1,112 @@
+#include "pio_i2c_bus.hpp"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include <cstring>
+
+PioI2cBus::PioI2cBus(PIO pio, uint sm, uint sda_pin, uint scl_pin, uint32_t baudrate)
+    : pio_i2c(pio, sm, sda_pin, scl_pin, baudrate) {
+    this->target_baudrate = baudrate;
+    this->baudrate = baudrate;
+}
+
+uint32_t PioI2cBus::set_baudrate(uint32_t baudrate) {
+    this->wait_idle();
+    this->target_baudrate = baudrate;
+    this->baudrate = this->pio_i2c.setBaudrate(baudrate);
+    return this->baudrate;
+}
+
+i2c_status PioI2cBus::transfer(uint count, uint rx_count, uint32_t timeout) {
+    uint64_t deadline = time_us_64() + timeout;
+    uint sent = 0;
+    uint received = 0;
+
+    // Every clocked byte is pushed back, keep the RX FIFO drained or the machine stalls mid-transfer
+    while (sent < count || received < rx_count || !this->pio_i2c.isTxStalled()) {
+        if (this->pio_i2c.hasError()) {
+            this->pio_i2c.resumeAfterError();
+            return I2C_NACK;
+        }
+        if (time_us_64() > deadline) {
+            this->recover();
+            return I2C_TIMEOUT;
+        }
+
+        if (sent < count && !this->pio_i2c.isTxFull()) {
+            this->pio_i2c.put(this->cmd[sent++]);
+            // Stalled again once the stop is out
+            if (sent == count) this->pio_i2c.clearTxStalled();
+        }
+        while (!this->pio_i2c.isRxEmpty()) {
+            uint8_t byte = this->pio_i2c.get();
+            if (received < rx_count) this->rx[received++] = byte;
+        }
+    }
+    return I2C_OK;
+}
+
+i2c_status PioI2cBus::write(uint8_t addr, const uint8_t* data, size_t len) {
+    if (len > I2C_BUS_MAX_TRANSFER) return I2C_NACK;
+    this->wait_idle();
+    uint count = this->pio_i2c.buildWrite(this->cmd, addr, data, len);
+    return this->transfer(count, len + 1, this->timeout_us(len + 1));
+}
+
+i2c_status PioI2cBus::read_register(uint8_t addr, uint8_t reg, uint8_t* data, size_t len) {
+    if (len > I2C_BUS_MAX_TRANSFER) return I2C_NACK;
+    this->wait_idle();
+    uint count = this->pio_i2c.buildReadRegister(this->cmd, addr, reg, len);
+    i2c_status status = this->transfer(count, len + PioI2C::READ_REGISTER_ECHO, this->timeout_us(len + 3));
+    if (status == I2C_OK) std::memcpy(data, this->rx + PioI2C::READ_REGISTER_ECHO, len);
+    return status;
+}
+
+void PioI2cBus::recover() {
+    this->recoveries++;
+    this->pio_i2c.release();
+    I2cBus::clear_bus(this->pio_i2c.getSdaPin(), this->pio_i2c.getSclPin());
+    this->pio_i2c.reattach();
+}
+
+void PioI2cBus::start(i2c_transaction_t* transaction) {
+    if (this->tx_dma < 0) {
+        this->tx_dma = dma_claim_unused_channel(true);
+        this->rx_dma = dma_claim_unused_channel(true);
+    }
+
+    // The whole read is one command stream, the machine paces the DMA through the FIFO requests
+    uint count = this->pio_i2c.buildReadRegister(this->cmd, transaction->addr, transaction->reg, transaction->len);
+
+    dma_channel_config rx_config = dma_channel_get_default_config(this->rx_dma);
+    channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx_config, false);
+    channel_config_set_write_increment(&rx_config, true);
+    channel_config_set_dreq(&rx_config, this->pio_i2c.getRxDreq());
+    dma_channel_configure(this->rx_dma, &rx_config, this->rx, this->pio_i2c.getRxFifo(),
+                          transaction->len + PioI2C::READ_REGISTER_ECHO, true);
+
+    dma_channel_config tx_config = dma_channel_get_default_config(this->tx_dma);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&tx_config, true);
+    channel_config_set_write_increment(&tx_config, false);
+    channel_config_set_dreq(&tx_config, this->pio_i2c.getTxDreq());
+    dma_channel_configure(this->tx_dma, &tx_config, this->pio_i2c.getTxFifo(), this->cmd, count, true);
+}
+
+i2c_transaction_status PioI2cBus::check(i2c_transaction_t* transaction) {
+    if (this->pio_i2c.hasError()) {
+        dma_channel_abort(this->tx_dma);
+        dma_channel_abort(this->rx_dma);
+        this->pio_i2c.resumeAfterError();
+        return I2C_TRANSACTION_ERROR;
+    }
+    if (dma_channel_is_busy(this->rx_dma)) return I2C_TRANSACTION_PENDING;
+    std::memcpy(transaction->data, this->rx + PioI2C::READ_REGISTER_ECHO, transaction->len);
+    return I2C_TRANSACTION_DONE;
+}
+
+void PioI2cBus::abort(i2c_transaction_t* transaction) {
+    dma_channel_abort(this->tx_dma);
+    dma_channel_abort(this->rx_dma);
+    this->recover();
+}
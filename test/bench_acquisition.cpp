@@ -0,0 +1,249 @@
+#include <chrono>
+#include <cmath>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+#include "i2c_scheduler.hpp"
+#include "altimeter.hpp"
+
+// Host cost of decoding what the bus brought back, and bus time per simulated second of the
+// acquisition loop in each bus layout. Host nanoseconds only rank the decoders, the bus figures
+// are exact for the modelled parts.
+
+#define BENCH_RUNS 20000
+#define BENCH_DURATION_US 1000000
+
+static double now_ns() {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// complete_update of a burst already on the bus: poll, collect and decode
+static double mpu6050_burst_decode_ns() {
+    SimMPU6050Fixture rig(100);
+
+    double total = 0;
+    for (uint32_t i = 0; i < BENCH_RUNS; i++) {
+        rig.mpu6050.submit_read();
+        sdk_clock.advance(1000);
+        double start = now_ns();
+        rig.mpu6050.complete_update();
+        total += now_ns() - start;
+    }
+    return total / BENCH_RUNS;
+}
+
+// Per sample, the records read of a full FIFO batch
+static double mpu6050_fifo_decode_ns() {
+    SimMPU6050Fixture rig(100);
+    rig.mpu6050.enable_fifo();
+
+    double total = 0;
+    uint32_t samples = 0;
+    // A batch worth of samples per round: count read, records read, then the timed decode
+    for (uint32_t i = 0; i < BENCH_RUNS / MPU_FIFO_BATCH_SAMPLES; i++) {
+        sdk_clock.advance(MPU_FIFO_BATCH_SAMPLES * 500);
+        rig.mpu6050.submit_read();
+        sdk_clock.advance(1000);
+        rig.mpu6050.complete_update();
+        sdk_clock.advance(MPU_FIFO_BATCH_SAMPLES * 500 - 1000);
+        double start = now_ns();
+        bool decoded = rig.mpu6050.complete_update();
+        total += now_ns() - start;
+        if (decoded) samples += rig.mpu6050.batch.count;
+    }
+    return samples ? total / samples : 0;
+}
+
+static double bmp280_decode_ns() {
+    SimBMP280Fixture rig;
+
+    // A new raw value every call, a repeated one is skipped as stale
+    uint8_t burst[bmp280_burst_map::size] = {};
+    bmp280_burst_map::temp::encode(519888, burst);
+    double total = 0;
+    for (uint32_t i = 0; i < BENCH_RUNS; i++) {
+        bmp280_burst_map::pressure::encode(415148 + (i & 0xFF), burst);
+        double start = now_ns();
+        rig.bmp280.decode_mirrored(burst, i);
+        total += now_ns() - start;
+    }
+    return total / BENCH_RUNS;
+}
+
+struct kernel_cost
+{
+    double ns;
+    // Time stamp counter ticks, 0 where the host has none
+    double cycles;
+} typedef kernel_cost_t;
+
+// Per call cost of a pressure compensation kernel on a changing raw value. On the M0+ the 64 bits
+// multiplies are library calls, only the ratio between the two is worth reading from the host.
+// The same goes for the unit conversions below, the host has a hardware FPU and the M0+ has none.
+static kernel_cost_t compensation_cost(uint32_t (*compensate)(const BMP280_calib_param&, int32_t, int32_t)) {
+    static constexpr BMP280_calib_param calib_example = {27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000};
+    volatile uint32_t sink = 0;
+    double start = now_ns();
+    uint64_t start_cycles = cycles();
+    for (int32_t i = 0; i < BENCH_RUNS * 10; i++) {
+        sink = sink + compensate(calib_example, 415148 + (i & 0xFFF), 128422);
+    }
+    return {(now_ns() - start) / (BENCH_RUNS * 10), (double)(cycles() - start_cycles) / (BENCH_RUNS * 10)};
+}
+
+static uint32_t compensate_64(const BMP280_calib_param& calib, int32_t raw_pressure, int32_t fine_temp) {
+    return bmp280_compensate_pressure_64(calib, raw_pressure, fine_temp);
+}
+
+static uint32_t compensate_32(const BMP280_calib_param& calib, int32_t raw_pressure, int32_t fine_temp) {
+    return bmp280_compensate_pressure_32(calib, raw_pressure, fine_temp);
+}
+
+// Six conversions per sample, the Q16 kernels against the float division they replaced
+static kernel_cost_t conversion_cost(bool fixed) {
+    SimMPU6050Fixture rig;
+    volatile float acc_lsb_per_g = rig.mpu6050.get_config().range_per_digit;
+    volatile float gyro_lsb_per_dps = rig.mpu6050.get_config().dps_per_digit;
+
+    volatile int32_t sink = 0;
+    double start = now_ns();
+    uint64_t start_cycles = cycles();
+    for (int32_t i = 0; i < BENCH_RUNS * 10; i++) {
+        int16_t count = (int16_t)(i * 7919);
+        if (fixed) {
+            sink = sink + rig.mpu6050.to_mg(count) + rig.mpu6050.to_mg(count + 1) + rig.mpu6050.to_mg(count + 2)
+                + rig.mpu6050.to_mdps(count) + rig.mpu6050.to_mdps(count + 1) + rig.mpu6050.to_mdps(count + 2);
+        } else {
+            sink = sink + (int32_t)((float)count / acc_lsb_per_g * 1000) + (int32_t)((float)(count + 1) / acc_lsb_per_g * 1000)
+                + (int32_t)((float)(count + 2) / acc_lsb_per_g * 1000) + (int32_t)((float)count / gyro_lsb_per_dps * 1000)
+                + (int32_t)((float)(count + 1) / gyro_lsb_per_dps * 1000) + (int32_t)((float)(count + 2) / gyro_lsb_per_dps * 1000);
+        }
+    }
+    return {(now_ns() - start) / (BENCH_RUNS * 10), (double)(cycles() - start_cycles) / (BENCH_RUNS * 10)};
+}
+
+// Pressure to altitude per result, the table lookup against powf it replaced
+static kernel_cost_t altitude_cost(bool lookup) {
+    volatile int32_t sink = 0;
+    double start = now_ns();
+    uint64_t start_cycles = cycles();
+    for (int32_t i = 0; i < BENCH_RUNS * 10; i++) {
+        uint32_t pressure = (26436 << 8) + (uint32_t)i * 97;
+        if (lookup) {
+            sink = sink + Altimeter::to_standard_altitude_mm(pressure);
+        } else {
+            sink = sink + (int32_t)(44330.77f * (1 - powf(pressure / 256.0f / ALTIMETER_SEA_LEVEL_PA, 0.190263f)) * 1000);
+        }
+    }
+    return {(now_ns() - start) / (BENCH_RUNS * 10), (double)(cycles() - start_cycles) / (BENCH_RUNS * 10)};
+}
+
+struct bus_budget
+{
+    uint32_t mpu6050_samples;
+    uint32_t bmp280_results;
+    // Bus time per second of each bus, in permille
+    uint32_t load_permille[2];
+    // Scheduler estimate of the same
+    uint32_t estimate_permille[2];
+} typedef bus_budget_t;
+
+// One simulated second of the flight loop: MPU6050 at 1kHz and BMP280, on one bus or one each
+static bus_budget_t run_budget(uint32_t baudrate, bool fifo, bool dual_bus) {
+    SimI2cBus bus0(baudrate, &sdk_clock);
+    SimI2cBus bus1(baudrate, &sdk_clock);
+    SimMPU6050 sim_mpu6050(MPU_DEFAULT_I2C_ADDR, 100);
+    SimBMP280 sim_bmp280(0x76, 10);
+    bus0.attach(&sim_mpu6050);
+    (dual_bus ? bus1 : bus0).attach(&sim_bmp280);
+
+    MPU6050 mpu6050(MPU_DEFAULT_I2C_ADDR, 1000, &bus0);
+    BMP280 bmp280(0x76, dual_bus ? &bus1 : &bus0);
+    if (fifo) mpu6050.enable_fifo();
+
+    I2cScheduler scheduler(sdk_clock_now);
+    int mpu6050_slot = scheduler.add(&mpu6050);
+    int bmp280_slot = scheduler.add(&bmp280);
+    bus0.reset_stats();
+    bus1.reset_stats();
+
+    bus_budget_t budget = {};
+    uint64_t end = sdk_clock.now() + BENCH_DURATION_US;
+    while (sdk_clock.now() < end) {
+        uint32_t updated = scheduler.run();
+        if (updated & (1u << mpu6050_slot)) budget.mpu6050_samples += fifo ? mpu6050.batch.count : 1;
+        if ((updated & (1u << bmp280_slot)) && bmp280.data.fresh) budget.bmp280_results++;
+        sdk_clock.advance(10);
+    }
+    budget.load_permille[0] = bus0.get_bus_time_us() * 1000 / BENCH_DURATION_US;
+    budget.load_permille[1] = bus1.get_bus_time_us() * 1000 / BENCH_DURATION_US;
+    budget.estimate_permille[0] = scheduler.get_load_permille(&bus0);
+    budget.estimate_permille[1] = scheduler.get_load_permille(&bus1);
+    return budget;
+}
+
+static void report_budget(const char* name, const bus_budget_t& budget) {
+    printf("%-24s %6u %6u %6u.%u%% %6u.%u%% %6u.%u%%\n", name, budget.mpu6050_samples, budget.bmp280_results,
+        budget.load_permille[0] / 10, budget.load_permille[0] % 10, budget.load_permille[1] / 10, budget.load_permille[1] % 10,
+        (budget.estimate_permille[0] + budget.estimate_permille[1]) / 10, (budget.estimate_permille[0] + budget.estimate_permille[1]) % 10);
+}
+
+int main() {
+    printf("decode cost (host ns)\n");
+    printf("  MPU6050 burst       %8.1f per sample\n", mpu6050_burst_decode_ns());
+    printf("  MPU6050 FIFO batch  %8.1f per sample\n", mpu6050_fifo_decode_ns());
+    printf("  BMP280 compensation %8.1f per result\n", bmp280_decode_ns());
+
+    kernel_cost_t cost_64 = compensation_cost(compensate_64);
+    kernel_cost_t cost_32 = compensation_cost(compensate_32);
+    printf("\npressure compensation per call (host)\n");
+    printf("  64 bits %8.1f ns %8.1f cycles\n", cost_64.ns, cost_64.cycles);
+    printf("  32 bits %8.1f ns %8.1f cycles\n", cost_32.ns, cost_32.cycles);
+
+    kernel_cost_t cost_fixed = conversion_cost(true);
+    kernel_cost_t cost_float = conversion_cost(false);
+    printf("\nMPU6050 unit conversion per sample (host)\n");
+    printf("  Q16     %8.1f ns %8.1f cycles\n", cost_fixed.ns, cost_fixed.cycles);
+    printf("  float   %8.1f ns %8.1f cycles\n", cost_float.ns, cost_float.cycles);
+
+    kernel_cost_t cost_lookup = altitude_cost(true);
+    kernel_cost_t cost_powf = altitude_cost(false);
+    printf("\npressure to altitude per result (host)\n");
+    printf("  table   %8.1f ns %8.1f cycles\n", cost_lookup.ns, cost_lookup.cycles);
+    printf("  powf    %8.1f ns %8.1f cycles\n", cost_powf.ns, cost_powf.cycles);
+
+    printf("\nbus budget per simulated second\n");
+    printf("%-24s %6s %6s %8s %8s %8s\n", "layout", "imu", "baro", "bus0", "bus1", "estimate");
+    bus_budget_t burst_400k = run_budget(I2C_FAST_MODE_BAUDRATE, false, false);
+    bus_budget_t burst_1m = run_budget(I2C_FAST_MODE_PLUS_BAUDRATE, false, false);
+    bus_budget_t fifo_400k = run_budget(I2C_FAST_MODE_BAUDRATE, true, false);
+    bus_budget_t dual_400k = run_budget(I2C_FAST_MODE_BAUDRATE, false, true);
+    report_budget("burst 400kHz", burst_400k);
+    report_budget("burst 1MHz", burst_1m);
+    report_budget("fifo 400kHz", fifo_400k);
+    report_budget("dual bus burst 400kHz", dual_400k);
+
+    // Every layout keeps up with the 1kHz output data rate and stays under a saturated bus
+    for (const bus_budget_t* budget : {&burst_400k, &burst_1m, &fifo_400k, &dual_400k}) {
+        CHECK(budget->mpu6050_samples >= 990);
+        CHECK(budget->bmp280_results >= 1);
+        CHECK(budget->load_permille[0] < 1000 && budget->load_permille[1] < 1000);
+    }
+    // Batches trade the per sample addressing for bigger reads, fewer transfers for the same data
+    CHECK(fifo_400k.load_permille[0] < burst_400k.load_permille[0]);
+    CHECK(burst_1m.load_permille[0] < burst_400k.load_permille[0]);
+    CHECK(dual_400k.load_permille[0] < burst_400k.load_permille[0]);
+    return check_result();
+}
@@ -0,0 +1,32 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <cstdio>
+
+// Minimal assertions for the host tests: a failed check is reported and the run goes on,
+// main returns check_result() so ctest sees the failure
+inline int check_failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        check_failures++; \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+    } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+    long long check_a = (long long)(a); \
+    long long check_b = (long long)(b); \
+    if (check_a != check_b) { \
+        check_failures++; \
+        printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, check_a, check_b); \
+    } \
+} while (0)
+
+inline int check_result() {
+    if (check_failures) printf("%d checks failed\n", check_failures);
+    else printf("all checks passed\n");
+    return check_failures != 0;
+}
+
+#endif
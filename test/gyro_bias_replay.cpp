@@ -0,0 +1,128 @@
+#include <cstdlib>
+#include "check.hpp"
+#include "gyro_bias_estimator.hpp"
+
+// Replays the GyroBiasEstimator over a data.csv written by the logger:
+//   gyro_bias_replay data.csv    prints the bias corrections of a recorded log
+//   gyro_bias_replay             writes a synthetic pad log in the same format and checks the replay
+
+struct replay_result
+{
+    uint32_t samples;
+    uint32_t updates;
+    vector3<int16_t> bias;
+    // Sample index the launch froze the estimator at, 0 if it never did
+    uint32_t frozen_at;
+} typedef replay_result_t;
+
+// The samples were logged with the live bias removed, exactly what the estimator got on target.
+// The correction is relative to the bias at the start of the log.
+static bool replay(const char* filename, bool verbose, replay_result_t* result) {
+    FILE* file = fopen(filename, "r");
+    if (file == nullptr) return false;
+
+    float acc_lsb_per_g, gyro_lsb_per_dps;
+    int pressure_lsb_per_pa;
+    char line[128];
+    if (!fgets(line, sizeof(line), file) || fscanf(file, "%f,%f,%d\n", &acc_lsb_per_g, &gyro_lsb_per_dps, &pressure_lsb_per_pa) != 3 || !fgets(line, sizeof(line), file)) {
+        fclose(file);
+        return false;
+    }
+
+    GyroBiasEstimator gyro_bias(gyro_lsb_per_dps, acc_lsb_per_g, {0, 0, 0});
+    *result = {};
+    unsigned long time;
+    int acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z;
+    unsigned long pressure;
+    while (fscanf(file, "%lu,%d,%d,%d,%d,%d,%d,%lu\n", &time, &acc_x, &acc_y, &acc_z, &gyro_x, &gyro_y, &gyro_z, &pressure) == 8) {
+        // Pad wait housekeeping rows and the end marker carry no gyro
+        if (gyro_x == 0 && gyro_y == 0 && gyro_z == 0) continue;
+
+        result->samples++;
+        if (gyro_bias.add_sample({(int16_t)acc_x, (int16_t)acc_y, (int16_t)acc_z}, {(int16_t)gyro_x, (int16_t)gyro_y, (int16_t)gyro_z})) {
+            result->updates++;
+            result->bias = gyro_bias.get_bias();
+            if (verbose) printf("%lu,%d,%d,%d\n", time, result->bias.x, result->bias.y, result->bias.z);
+        }
+        if (gyro_bias.is_frozen() && result->frozen_at == 0) {
+            result->frozen_at = result->samples;
+            if (verbose) printf("%lu,frozen\n", time);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static uint32_t seed = 0x2545F491;
+
+static int16_t noise(int16_t amplitude) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (int16_t)(seed % (2 * amplitude + 1)) - amplitude;
+}
+
+// 20s still on the pad at 1kHz with a gyro bias, then the boost. The rows are written the way
+// the firmware does: raw counts minus the bias the estimator has reached so far.
+// still_zero counts the still samples that came out exactly 0,0,0, the replay takes them for housekeeping.
+static vector3<int16_t> write_pad_log(const char* filename, const vector3<int16_t>& true_bias, uint32_t still_samples, uint32_t* still_zero) {
+    const float acc_lsb_per_g = 2048, gyro_lsb_per_dps = 32.8f;
+    FILE* file = fopen(filename, "w");
+    fprintf(file, "acc_lsb_per_g,gyro_lsb_per_dps,pressure_lsb_per_pa\n%f,%f,%d\n", acc_lsb_per_g, gyro_lsb_per_dps, 256);
+    fprintf(file, "time,acc_x,acc_y,acc_z,gyro_x,gyro_y,gyro_z,pressure\n");
+
+    GyroBiasEstimator gyro_bias(gyro_lsb_per_dps, acc_lsb_per_g, {0, 0, 0});
+    vector3<int16_t> bias = {0, 0, 0};
+    *still_zero = 0;
+    for (uint32_t i = 0; i < still_samples + 500; i++) {
+        // 8g along the rocket axis once launched
+        bool boost = i >= still_samples;
+        vector3<int16_t> acc = {noise(4), noise(4), (int16_t)((boost ? 8 * 2048 : 2048) + noise(4))};
+        vector3<int16_t> gyro = {(int16_t)(true_bias.x - bias.x + noise(6)), (int16_t)(true_bias.y - bias.y + noise(6)), (int16_t)(true_bias.z - bias.z + noise(6))};
+        if (!boost && gyro.x == 0 && gyro.y == 0 && gyro.z == 0) (*still_zero)++;
+        if (i % 1000 == 0) fprintf(file, "%u,%d,%d,%d,0,0,0,%u\n", i * 1000, acc.x, acc.y, acc.z, 25767233u);
+        fprintf(file, "%u,%d,%d,%d,%d,%d,%d,%u\n", i * 1000, acc.x, acc.y, acc.z, gyro.x, gyro.y, gyro.z, 25767233u);
+        if (gyro_bias.add_sample(acc, gyro)) bias = gyro_bias.get_bias();
+    }
+    fprintf(file, "0,0,0,0,0,0,0,0\n");
+    fclose(file);
+    return bias;
+}
+
+static void test_synthetic_pad_log() {
+    const char* filename = "gyro_bias_replay.csv";
+    vector3<int16_t> true_bias = {45, -30, 12};
+    uint32_t still_zero;
+    vector3<int16_t> target_bias = write_pad_log(filename, true_bias, 20000, &still_zero);
+
+    replay_result_t result;
+    CHECK(replay(filename, false, &result));
+    CHECK_EQ(result.samples, 20500 - still_zero);
+    // Same bias out as on target, the few dropped zero samples only shift the windows
+    CHECK_EQ(result.bias.x, target_bias.x);
+    CHECK_EQ(result.bias.y, target_bias.y);
+    CHECK_EQ(result.bias.z, target_bias.z);
+    // 312 windows, the residual is long gone
+    CHECK(abs(result.bias.x - true_bias.x) <= 1);
+    CHECK(abs(result.bias.y - true_bias.y) <= 1);
+    CHECK(abs(result.bias.z - true_bias.z) <= 1);
+    // Frozen on the first boost sample, nothing learned from the flight
+    CHECK_EQ(result.frozen_at, 20001 - still_zero);
+    CHECK_EQ(result.updates, (20000 - still_zero) / GYRO_BIAS_WINDOW_SAMPLES);
+    remove(filename);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        replay_result_t result;
+        if (!replay(argv[1], true, &result)) {
+            printf("cannot read %s\n", argv[1]);
+            return 1;
+        }
+        printf("%u samples, %u bias updates, correction %d %d %d\n", result.samples, result.updates, result.bias.x, result.bias.y, result.bias.z);
+        return 0;
+    }
+
+    test_synthetic_pad_log();
+    return check_result();
+}
@@ -0,0 +1,38 @@
+#ifndef SHIM_PIO_I2C_PIO_H
+#define SHIM_PIO_I2C_PIO_H
+
+// Host stand-in for the pioasm output of lib/PioI2C/src/PioI2C.pio: the instruction table and
+// the program symbols PioI2C uses. The table holds the real encodings, SimPioI2cBus decodes them.
+#include "hardware/pio.h"
+
+#define pio_i2c_offset_entry_point 12u
+
+static const uint16_t pio_i2c_program_instructions[18] = {};
+
+static const pio_program_t pio_i2c_program = {
+    pio_i2c_program_instructions,
+    18,
+    -1,
+};
+
+// 32 state machine cycles per SCL period
+#define PIO_I2C_CYCLES_PER_BIT 32
+
+static inline void pio_i2c_program_init(PIO pio, uint sm, uint offset, uint pin_sda, uint pin_scl, uint32_t baudrate) {}
+
+// set pindirs, sda side scl [7]: SCL is the side-set bit 11, SDA the set data bit 0
+static const uint16_t pio_i2c_set_scl_sda_program_instructions[] = {
+    0xf780, // set pindirs, 0 side 0 [7]
+    0xf781, // set pindirs, 1 side 0 [7]
+    0xff80, // set pindirs, 0 side 1 [7]
+    0xff81, // set pindirs, 1 side 1 [7]
+};
+
+enum pio_i2c_scl_sda {
+    PIO_I2C_SC0_SD0 = 0,
+    PIO_I2C_SC0_SD1,
+    PIO_I2C_SC1_SD0,
+    PIO_I2C_SC1_SD1
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SHIM_HARDWARE_CLOCKS_H
+#define SHIM_HARDWARE_CLOCKS_H
+
+#include "pico/types.h"
+
+enum clock_index
+{
+    clk_sys = 5,
+    clk_peri = 6
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// clk_sys at the SDK default, clk_peri from sdk_clk_peri_hz
+uint32_t clock_get_hz(enum clock_index clk_index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
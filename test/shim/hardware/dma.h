@@ -0,0 +1,37 @@
+#ifndef SHIM_HARDWARE_DMA_H
+#define SHIM_HARDWARE_DMA_H
+
+#include "pico/types.h"
+
+enum dma_channel_transfer_size
+{
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+typedef struct
+{
+    uint32_t ctrl;
+} dma_channel_config;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Channels are handed out but never move data, a configured channel is never busy
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config* config, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config* config, bool incr);
+void channel_config_set_write_increment(dma_channel_config* config, bool incr);
+void channel_config_set_dreq(dma_channel_config* config, uint dreq);
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr, const volatile void* read_addr, uint transfer_count, bool trigger);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_abort(uint channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SHIM_HARDWARE_GPIO_H
+#define SHIM_HARDWARE_GPIO_H
+
+#include "pico/types.h"
+
+#define GPIO_IN 0
+#define GPIO_OUT 1
+
+enum gpio_function
+{
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_SIO = 5
+};
+
+enum gpio_irq_level
+{
+    GPIO_IRQ_LEVEL_LOW = 0x1u,
+    GPIO_IRQ_LEVEL_HIGH = 0x2u,
+    GPIO_IRQ_EDGE_FALL = 0x4u,
+    GPIO_IRQ_EDGE_RISE = 0x8u
+};
+
+enum gpio_override
+{
+    GPIO_OVERRIDE_NORMAL = 0,
+    GPIO_OVERRIDE_INVERT = 1,
+    GPIO_OVERRIDE_LOW = 2,
+    GPIO_OVERRIDE_HIGH = 3
+};
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pins are not modelled: outputs are dropped and inputs read high, like released pulled-up lines
+void gpio_init(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_pull_up(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_set_oeover(uint gpio, uint value);
+// The callback is kept, sdk_shim_gpio_irq fires it
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback);
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
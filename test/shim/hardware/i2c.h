@@ -0,0 +1,57 @@
+#ifndef SHIM_HARDWARE_I2C_H
+#define SHIM_HARDWARE_I2C_H
+
+#include "pico/types.h"
+#include "pico/time.h"
+
+typedef volatile uint32_t io_rw_32;
+
+// Only the DW_apb_i2c registers HardwareI2cBus touches
+typedef struct
+{
+    io_rw_32 tar;
+    io_rw_32 data_cmd;
+    io_rw_32 raw_intr_stat;
+    io_rw_32 clr_tx_abrt;
+    io_rw_32 enable;
+    io_rw_32 dma_cr;
+} i2c_hw_t;
+
+typedef struct i2c_inst
+{
+    i2c_hw_t hw;
+    uint32_t baudrate;
+} i2c_inst_t;
+
+extern i2c_inst_t i2c0_inst;
+extern i2c_inst_t i2c1_inst;
+#define i2c0 (&i2c0_inst)
+#define i2c1 (&i2c1_inst)
+#define i2c_default i2c0
+
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x00000400u
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200u
+#define I2C_IC_DATA_CMD_CMD_BITS 0x00000100u
+#define I2C_IC_DMA_CR_TDMAE_BITS 0x00000002u
+#define I2C_IC_DMA_CR_RDMAE_BITS 0x00000001u
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x00000040u
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Same divider rounding as the SDK, from sdk_clk_peri_hz. There is no slave: transfers NACK.
+uint i2c_init(i2c_inst_t* i2c, uint baudrate);
+void i2c_deinit(i2c_inst_t* i2c);
+uint i2c_set_baudrate(i2c_inst_t* i2c, uint baudrate);
+int i2c_write_timeout_us(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop, uint timeout_us);
+int i2c_read_timeout_us(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop, uint timeout_us);
+
+static inline i2c_hw_t* i2c_get_hw(i2c_inst_t* i2c) { return &i2c->hw; }
+static inline uint i2c_get_dreq(i2c_inst_t* i2c, bool is_tx) { return (i2c == i2c1 ? 34 : 32) + (is_tx ? 0 : 1); }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
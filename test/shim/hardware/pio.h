@@ -0,0 +1,55 @@
+#ifndef SHIM_HARDWARE_PIO_H
+#define SHIM_HARDWARE_PIO_H
+
+#include "pico/types.h"
+#include "hardware/gpio.h"
+
+#define PIO_FDEBUG_TXSTALL_LSB 24
+
+// Only the registers PioI2C touches directly
+typedef struct
+{
+    volatile uint32_t fdebug;
+    volatile uint32_t txf[4];
+    volatile uint32_t rxf[4];
+} pio_hw_t;
+
+typedef pio_hw_t* PIO;
+
+typedef struct
+{
+    const uint16_t* instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+extern pio_hw_t pio0_hw;
+extern pio_hw_t pio1_hw;
+#define pio0 (&pio0_hw)
+#define pio1 (&pio1_hw)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// No state machine runs on the host: programs load at 0, the FIFOs are empty and never full,
+// no IRQ flag is raised. The PIO I2C protocol is modelled by SimPioI2cBus instead.
+uint pio_add_program(PIO pio, const pio_program_t* program);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div);
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num);
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num);
+void pio_sm_drain_tx_fifo(PIO pio, uint sm);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+uint pio_encode_jmp(uint addr);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm);
+uint32_t pio_sm_get(PIO pio, uint sm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
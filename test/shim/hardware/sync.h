@@ -0,0 +1,18 @@
+#ifndef SHIM_HARDWARE_SYNC_H
+#define SHIM_HARDWARE_SYNC_H
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A GPIO interrupt raised while masked is held, like a latched edge, and taken on restore
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
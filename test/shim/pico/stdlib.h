@@ -0,0 +1,8 @@
+#ifndef SHIM_PICO_STDLIB_H
+#define SHIM_PICO_STDLIB_H
+
+#include "pico/types.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef SHIM_PICO_TIME_H
+#define SHIM_PICO_TIME_H
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// All of them read or advance sdk_clock, nothing really sleeps
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+void busy_wait_us_32(uint32_t delay_us);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
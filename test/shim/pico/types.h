@@ -0,0 +1,28 @@
+#ifndef SHIM_PICO_TYPES_H
+#define SHIM_PICO_TYPES_H
+
+// Host stand-in for the few Pico SDK declarations the drivers use, see sdk_shim.cpp
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+#define _u(x) x ## u
+
+#define PICO_OK 0
+#define PICO_ERROR_GENERIC -1
+#define PICO_ERROR_TIMEOUT -2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Each call moves the simulated clock by 1us, so spin loops always make progress
+void tight_loop_contents(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+#include "sdk_shim.hpp"
+#include "pico/time.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/pio.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+
+SimClock sdk_clock;
+uint32_t sdk_clk_peri_hz = 125000000;
+uint32_t sdk_i2c_init_baudrate = 0;
+
+uint64_t sdk_clock_now() {
+    return sdk_clock.now();
+}
+
+i2c_inst_t i2c0_inst = {};
+i2c_inst_t i2c1_inst = {};
+pio_hw_t pio0_hw = {};
+pio_hw_t pio1_hw = {};
+
+static gpio_irq_callback_t gpio_callback = nullptr;
+static int dma_channels = 0;
+static bool interrupts_masked = false;
+static bool irq_pending = false;
+static uint irq_pending_gpio = 0;
+static uint32_t irq_pending_events = 0;
+
+void sdk_shim_gpio_irq(uint gpio, uint32_t events) {
+    if (interrupts_masked) {
+        irq_pending = true;
+        irq_pending_gpio = gpio;
+        irq_pending_events |= events;
+        return;
+    }
+    if (gpio_callback) gpio_callback(gpio, events);
+}
+
+extern "C" {
+
+void tight_loop_contents(void) { sdk_clock.advance(1); }
+
+uint64_t time_us_64(void) { return sdk_clock.now(); }
+uint32_t time_us_32(void) { return (uint32_t)sdk_clock.now(); }
+void busy_wait_us_32(uint32_t delay_us) { sdk_clock.advance(delay_us); }
+void sleep_us(uint64_t us) { sdk_clock.advance(us); }
+void sleep_ms(uint32_t ms) { sdk_clock.advance((uint64_t)ms * 1000); }
+
+void gpio_init(uint gpio) {}
+void gpio_set_function(uint gpio, enum gpio_function fn) {}
+void gpio_pull_up(uint gpio) {}
+void gpio_set_dir(uint gpio, bool out) {}
+void gpio_put(uint gpio, bool value) {}
+bool gpio_get(uint gpio) { return true; }
+void gpio_set_oeover(uint gpio, uint value) {}
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback) {
+    gpio_callback = callback;
+}
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) {}
+
+uint32_t save_and_disable_interrupts(void) {
+    uint32_t status = interrupts_masked;
+    interrupts_masked = true;
+    return status;
+}
+void restore_interrupts(uint32_t status) {
+    interrupts_masked = status;
+    if (interrupts_masked || !irq_pending) return;
+    irq_pending = false;
+    uint32_t events = irq_pending_events;
+    irq_pending_events = 0;
+    sdk_shim_gpio_irq(irq_pending_gpio, events);
+}
+
+uint i2c_set_baudrate(i2c_inst_t* i2c, uint baudrate) {
+    // Rounded to the nearest divider, the SCL period is a whole number of clk_peri cycles
+    uint32_t period = (sdk_clk_peri_hz + baudrate / 2) / baudrate;
+    i2c->baudrate = sdk_clk_peri_hz / period;
+    return i2c->baudrate;
+}
+uint i2c_init(i2c_inst_t* i2c, uint baudrate) {
+    sdk_i2c_init_baudrate = baudrate;
+    return i2c_set_baudrate(i2c, baudrate);
+}
+void i2c_deinit(i2c_inst_t* i2c) { i2c->baudrate = 0; }
+int i2c_write_timeout_us(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop, uint timeout_us) {
+    return PICO_ERROR_GENERIC;
+}
+int i2c_read_timeout_us(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop, uint timeout_us) {
+    return PICO_ERROR_GENERIC;
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index) { return clk_index == clk_peri ? sdk_clk_peri_hz : 125000000; }
+
+uint pio_add_program(PIO pio, const pio_program_t* program) { return 0; }
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {}
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div) {}
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num) { return false; }
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num) {}
+void pio_sm_drain_tx_fifo(PIO pio, uint sm) {}
+void pio_sm_exec(PIO pio, uint sm, uint instr) {}
+uint pio_encode_jmp(uint addr) { return addr; }
+void pio_sm_clear_fifos(PIO pio, uint sm) {}
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx) { return 0; }
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm) { return false; }
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm) { return true; }
+uint32_t pio_sm_get(PIO pio, uint sm) { return 0; }
+
+int dma_claim_unused_channel(bool required) { return dma_channels++; }
+dma_channel_config dma_channel_get_default_config(uint channel) { return {}; }
+void channel_config_set_transfer_data_size(dma_channel_config* config, enum dma_channel_transfer_size size) {}
+void channel_config_set_read_increment(dma_channel_config* config, bool incr) {}
+void channel_config_set_write_increment(dma_channel_config* config, bool incr) {}
+void channel_config_set_dreq(dma_channel_config* config, uint dreq) {}
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr, const volatile void* read_addr, uint transfer_count, bool trigger) {}
+bool dma_channel_is_busy(uint channel) { return false; }
+void dma_channel_abort(uint channel) {}
+
+}
@@ -0,0 +1,19 @@
+#ifndef SDK_SHIM_HPP
+#define SDK_SHIM_HPP
+
+#include "pico/types.h"
+#include "sim_clock.hpp"
+
+// Clock behind time_us_64 and the busy waits of the shimmed SDK, simulated buses share it
+extern SimClock sdk_clock;
+// sdk_clock as a clock function, for the injectable clocks
+uint64_t sdk_clock_now();
+// clk_peri the I2C dividers are computed from, the SDK default
+extern uint32_t sdk_clk_peri_hz;
+// Baudrate asked from the last i2c_init call
+extern uint32_t sdk_i2c_init_baudrate;
+
+// Deliver a GPIO interrupt to the callback registered by the drivers
+void sdk_shim_gpio_irq(uint gpio, uint32_t events);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SIM_CLOCK_HPP
+#define SIM_CLOCK_HPP
+
+#include <cstdint>
+
+// Simulated time in us. Nothing sleeps on the host: a transfer or a busy wait moves the clock
+// forward by the time the real part would have taken, so runs are fast and repeatable.
+class SimClock {
+    uint64_t time_us = 0;
+
+public:
+    uint64_t now() { return this->time_us; }
+    void advance(uint64_t us) { this->time_us += us; }
+    // Move forward to time_us, never back
+    void advance_to(uint64_t time_us) { if (time_us > this->time_us) this->time_us = time_us; }
+};
+
+#endif
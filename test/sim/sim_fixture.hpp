@@ -0,0 +1,53 @@
+#ifndef SIM_FIXTURE_HPP
+#define SIM_FIXTURE_HPP
+
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+
+// The usual test setups: drivers on one simulated bus clocked by sdk_clock, each talking to
+// its register model. The models are attached before the driver constructors initialize the parts.
+
+class SimMPU6050Fixture {
+public:
+    SimI2cBus bus;
+    SimMPU6050 sim_mpu6050;
+private:
+    bool attached = bus.attach(&sim_mpu6050);
+public:
+    MPU6050 mpu6050;
+
+    SimMPU6050Fixture(uint32_t noise = 0, uint16_t freq = 1000, uint32_t baudrate = I2C_FAST_MODE_BAUDRATE):
+        bus(baudrate, &sdk_clock), sim_mpu6050(MPU_DEFAULT_I2C_ADDR, noise), mpu6050(MPU_DEFAULT_I2C_ADDR, freq, &bus) {}
+};
+
+class SimBMP280Fixture {
+public:
+    SimI2cBus bus;
+    SimBMP280 sim_bmp280;
+private:
+    bool attached = bus.attach(&sim_bmp280);
+public:
+    BMP280 bmp280;
+
+    SimBMP280Fixture(uint32_t noise = 0, uint32_t baudrate = I2C_FAST_MODE_BAUDRATE):
+        bus(baudrate, &sdk_clock), sim_bmp280(0x76, noise), bmp280(0x76, &bus) {}
+};
+
+// Both sensors sharing the bus, as wired on the board
+class SimSensorsFixture {
+public:
+    SimI2cBus bus;
+    SimMPU6050 sim_mpu6050;
+    SimBMP280 sim_bmp280;
+private:
+    bool attached = bus.attach(&sim_mpu6050) && bus.attach(&sim_bmp280);
+public:
+    MPU6050 mpu6050;
+    BMP280 bmp280;
+
+    SimSensorsFixture(uint32_t mpu6050_noise = 0, uint32_t bmp280_noise = 0, uint32_t baudrate = I2C_FAST_MODE_BAUDRATE):
+        bus(baudrate, &sdk_clock), sim_mpu6050(MPU_DEFAULT_I2C_ADDR, mpu6050_noise), sim_bmp280(0x76, bmp280_noise),
+        mpu6050(MPU_DEFAULT_I2C_ADDR, 1000, &bus), bmp280(0x76, &bus) {}
+};
+
+#endif
@@ -0,0 +1,335 @@
+#include "sim_i2c_bus.hpp"
+
+SimI2cDevice::SimI2cDevice(uint8_t addr, uint32_t noise) {
+    this->addr = addr;
+    this->noise = noise;
+}
+
+int32_t SimI2cDevice::noise_sample() {
+    if (this->noise == 0) return 0;
+    // xorshift32, cheap and repeatable between runs
+    this->seed ^= this->seed << 13;
+    this->seed ^= this->seed >> 17;
+    this->seed ^= this->seed << 5;
+    return (int32_t)(this->seed % (2 * this->noise + 1)) - (int32_t)this->noise;
+}
+
+void SimI2cDevice::write(const uint8_t* data, size_t len, uint64_t time_us) {
+    if (len == 0) return;
+    this->pointer = data[0];
+    for (size_t i = 1; i < len; i++) this->regs[this->pointer++] = data[i];
+}
+
+void SimI2cDevice::read(uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) data[i] = this->regs[this->pointer++];
+}
+
+SimMPU6050::SimMPU6050(uint8_t addr, uint32_t noise): SimI2cDevice(addr, noise) {
+    this->regs[MPU_REG_WHO_AM_I] = MPU_DEFAULT_I2C_ADDR;
+    this->regs[MPU_REG_PWR_MGMT_1] = 0x40; // Sleep bit set at power up
+
+    // Factory codes, accel x/y/z 17/14/19 and gyro x/y/z 14/15/16
+    this->regs[MPU_REG_SELF_TEST_X] = 0x8E;
+    this->regs[MPU_REG_SELF_TEST_Y] = 0x6F;
+    this->regs[MPU_REG_SELF_TEST_Z] = 0x90;
+    this->regs[MPU_REG_SELF_TEST_A] = 0x1B;
+    this->acc_self_test = {(int16_t)MPU6050::accel_factory_trim(17), (int16_t)MPU6050::accel_factory_trim(14), (int16_t)MPU6050::accel_factory_trim(19)};
+    this->gyro_self_test = {(int16_t)MPU6050::gyro_factory_trim(14), (int16_t)-MPU6050::gyro_factory_trim(15), (int16_t)MPU6050::gyro_factory_trim(16)};
+}
+
+void SimMPU6050::set_self_test_response(vector3<int16_t> acc, vector3<int16_t> gyro) {
+    this->acc_self_test = acc;
+    this->gyro_self_test = gyro;
+}
+
+static int16_t saturate_int16(int32_t value) {
+    if (value > INT16_MAX) return INT16_MAX;
+    if (value < INT16_MIN) return INT16_MIN;
+    return value;
+}
+
+uint32_t SimMPU6050::sample_period_us() {
+    uint8_t dlpf = this->regs[MPU_REG_CONFIG] & 0b111;
+    uint32_t gyro_rate = (dlpf == 0 || dlpf == 7) ? 8000 : 1000;
+    return 1000000 * (1 + this->regs[MPU_REG_SMPLRT_DIV]) / gyro_rate;
+}
+
+void SimMPU6050::push_fifo(const uint8_t* data, uint8_t len) {
+    // Like the part, a full FIFO keeps the newest bytes and overwrites the oldest ones
+    for (uint8_t i = 0; i < len; i++) {
+        this->fifo[(this->fifo_head + this->fifo_count) % MPU_FIFO_SIZE] = data[i];
+        if (this->fifo_count < MPU_FIFO_SIZE) this->fifo_count++;
+        else this->fifo_head = (this->fifo_head + 1) % MPU_FIFO_SIZE;
+    }
+}
+
+void SimMPU6050::sample(uint64_t time_us) {
+    // XA_ST/XG_ST, YA_ST/YG_ST and ZA_ST/ZG_ST are bits 7, 6 and 5 of the config registers
+    uint8_t acc_st = this->regs[MPU_REG_ACCEL_CONFIG];
+    uint8_t gyro_st = this->regs[MPU_REG_GYRO_CONFIG];
+    vector3<int32_t> acc = {this->acc.x, this->acc.y, this->acc.z};
+    vector3<int32_t> gyro = {this->gyro.x, this->gyro.y, this->gyro.z};
+    if (acc_st & 0x80) acc.x += this->acc_self_test.x;
+    if (acc_st & 0x40) acc.y += this->acc_self_test.y;
+    if (acc_st & 0x20) acc.z += this->acc_self_test.z;
+    if (gyro_st & 0x80) gyro.x += this->gyro_self_test.x;
+    if (gyro_st & 0x40) gyro.y += this->gyro_self_test.y;
+    if (gyro_st & 0x20) gyro.z += this->gyro_self_test.z;
+
+    // Gyros in standby read zero, STBY_XG, STBY_YG and STBY_ZG are bits 2, 1 and 0
+    uint8_t standby = this->regs[MPU_REG_PWR_MGMT_2];
+    if (standby & 0b100) gyro.x = 0;
+    if (standby & 0b010) gyro.y = 0;
+    if (standby & 0b001) gyro.z = 0;
+
+    uint8_t* burst = this->regs + MPU_REG_ACCEL_XOUT_H;
+    mpu6050_burst_map::acc_x::encode(saturate_int16(acc.x + this->noise_sample()), burst);
+    mpu6050_burst_map::acc_y::encode(saturate_int16(acc.y + this->noise_sample()), burst);
+    mpu6050_burst_map::acc_z::encode(saturate_int16(acc.z + this->noise_sample()), burst);
+    mpu6050_burst_map::temp::encode(this->temp, burst);
+    mpu6050_burst_map::gyro_x::encode(saturate_int16(gyro.x + this->noise_sample()), burst);
+    mpu6050_burst_map::gyro_y::encode(saturate_int16(gyro.y + this->noise_sample()), burst);
+    mpu6050_burst_map::gyro_z::encode(saturate_int16(gyro.z + this->noise_sample()), burst);
+
+    uint8_t slv0_ctrl = this->regs[MPU_REG_I2C_SLV0_CTRL];
+    uint8_t ext_length = slv0_ctrl & 0b1111;
+    bool slave_read = (this->regs[MPU_REG_USER_CTRL] & MPU_USER_CTRL_I2C_MST_EN) && (slv0_ctrl & MPU_I2C_SLV_EN);
+    if (slave_read && this->aux != nullptr && this->aux->get_addr() == (this->regs[MPU_REG_I2C_SLV0_ADDR] & 0x7F)) {
+        this->aux->write(this->regs + MPU_REG_I2C_SLV0_REG, 1, time_us);
+        this->aux->update(time_us);
+        this->aux->read(this->regs + MPU_REG_EXT_SENS_DATA_00, ext_length);
+    }
+
+    if (!(this->regs[MPU_REG_USER_CTRL] & MPU_USER_CTRL_FIFO_EN) || this->regs[MPU_REG_FIFO_EN] == 0) return;
+    this->push_fifo(burst, mpu6050_burst_map::size);
+    if (slave_read && (this->regs[MPU_REG_FIFO_EN] & MPU_FIFO_EN_SLV0)) this->push_fifo(this->regs + MPU_REG_EXT_SENS_DATA_00, ext_length);
+}
+
+void SimMPU6050::update(uint64_t time_us) {
+    uint32_t period = this->sample_period_us();
+    if (this->next_sample_time == 0) this->next_sample_time = time_us;
+    while (this->next_sample_time <= time_us) {
+        // Nothing is sampled while asleep
+        if (!(this->regs[MPU_REG_PWR_MGMT_1] & 0x40)) this->sample(this->next_sample_time);
+        this->next_sample_time += period;
+    }
+    mpu6050_fifo_count_map::count::encode(this->fifo_count, this->regs + MPU_REG_FIFO_COUNTH);
+}
+
+void SimMPU6050::write(const uint8_t* data, size_t len, uint64_t time_us) {
+    SimI2cDevice::write(data, len, time_us);
+    if (this->regs[MPU_REG_USER_CTRL] & MPU_USER_CTRL_FIFO_RESET) {
+        this->regs[MPU_REG_USER_CTRL] &= ~MPU_USER_CTRL_FIFO_RESET;
+        this->fifo_head = 0;
+        this->fifo_count = 0;
+    }
+}
+
+void SimMPU6050::read(uint8_t* data, size_t len) {
+    if (this->pointer != MPU_REG_FIFO_R_W) {
+        SimI2cDevice::read(data, len);
+        return;
+    }
+    // FIFO reads do not move the register pointer, an empty FIFO reads as 0xFF
+    for (size_t i = 0; i < len; i++) {
+        if (this->fifo_count == 0) {
+            data[i] = 0xFF;
+            continue;
+        }
+        data[i] = this->fifo[this->fifo_head];
+        this->fifo_head = (this->fifo_head + 1) % MPU_FIFO_SIZE;
+        this->fifo_count--;
+    }
+}
+
+SimBMP280::SimBMP280(uint8_t addr, uint32_t noise): SimI2cDevice(addr, noise) {
+    this->regs[BMP280_REG_ID] = 0x58;
+
+    uint8_t* calib = this->regs + BMP280_REG_DIG_T1_LSB;
+    bmp280_calib_map::dig_T1::encode(27504, calib);
+    bmp280_calib_map::dig_T2::encode(26435, calib);
+    bmp280_calib_map::dig_T3::encode(-1000, calib);
+    bmp280_calib_map::dig_P1::encode(36477, calib);
+    bmp280_calib_map::dig_P2::encode(-10685, calib);
+    bmp280_calib_map::dig_P3::encode(3024, calib);
+    bmp280_calib_map::dig_P4::encode(2855, calib);
+    bmp280_calib_map::dig_P5::encode(140, calib);
+    bmp280_calib_map::dig_P6::encode(-7, calib);
+    bmp280_calib_map::dig_P7::encode(15500, calib);
+    bmp280_calib_map::dig_P8::encode(-14600, calib);
+    bmp280_calib_map::dig_P9::encode(6000, calib);
+
+    // Outputs read 0x80000 until the first conversion
+    this->regs[BMP280_REG_PRESSURE_MSB] = 0x80;
+    this->regs[BMP280_REG_TEMP_MSB] = 0x80;
+}
+
+void SimBMP280::set_adc(int32_t adc_temp, int32_t adc_pressure) {
+    this->adc_temp = adc_temp;
+    this->adc_pressure = adc_pressure;
+}
+
+bmp280_profile_t SimBMP280::get_profile() {
+    uint8_t ctrl_meas = this->regs[BMP280_REG_CTRL_MEAS];
+    uint8_t config = this->regs[BMP280_REG_CONFIG];
+    // Codes above x16 are x16 too
+    uint8_t temp_oversampling = ctrl_meas >> 5;
+    uint8_t pressure_oversampling = (ctrl_meas >> 2) & 0b111;
+    if (temp_oversampling > BMP280_OVERSAMPLING_X16) temp_oversampling = BMP280_OVERSAMPLING_X16;
+    if (pressure_oversampling > BMP280_OVERSAMPLING_X16) pressure_oversampling = BMP280_OVERSAMPLING_X16;
+    return {(bmp280_oversampling)temp_oversampling, (bmp280_oversampling)pressure_oversampling,
+        (bmp280_filter)((config >> 2) & 0b111), (bmp280_standby)(config >> 5)};
+}
+
+void SimBMP280::convert() {
+    uint8_t* burst = this->regs + BMP280_REG_PRESSURE_MSB;
+    bmp280_burst_map::pressure::encode((this->adc_pressure + this->noise_sample()) & 0xFFFFF, burst);
+    bmp280_burst_map::temp::encode((this->adc_temp + this->noise_sample()) & 0xFFFFF, burst);
+    this->conversions++;
+}
+
+void SimBMP280::write(const uint8_t* data, size_t len, uint64_t time_us) {
+    // A finished forced conversion is back in sleep before the write
+    this->update(time_us);
+    uint8_t mode = this->regs[BMP280_REG_CTRL_MEAS] & 0b11;
+    SimI2cDevice::write(data, len, time_us);
+    // A conversion starts when normal or forced mode is entered
+    uint8_t new_mode = this->regs[BMP280_REG_CTRL_MEAS] & 0b11;
+    if (new_mode != mode) {
+        this->conversion_end = new_mode == BMP280_MODE_SLEEP ? 0 : time_us + bmp280_measurement_time_typ_us(this->get_profile());
+    }
+}
+
+void SimBMP280::update(uint64_t time_us) {
+    // Nothing is converted in sleep mode
+    if (this->conversion_end == 0) {
+        this->regs[BMP280_REG_STATUS] = 0;
+        return;
+    }
+
+    // One forced conversion, then sleep
+    if ((this->regs[BMP280_REG_CTRL_MEAS] & 0b11) == BMP280_MODE_FORCED) {
+        if (this->conversion_end <= time_us) {
+            this->convert();
+            this->conversion_end = 0;
+            this->regs[BMP280_REG_CTRL_MEAS] &= ~0b11;
+        }
+        this->regs[BMP280_REG_STATUS] = this->conversion_end != 0 ? 0b1000 : 0;
+        return;
+    }
+
+    bmp280_profile_t profile = this->get_profile();
+    while (this->conversion_end <= time_us) {
+        this->convert();
+        this->conversion_end += bmp280_measurement_period_typ_us(profile);
+    }
+    // measuring while the next conversion runs, after the standby time
+    bool measuring = time_us + bmp280_measurement_time_typ_us(profile) >= this->conversion_end;
+    this->regs[BMP280_REG_STATUS] = measuring ? 0b1000 : 0;
+}
+
+SimI2cBus::SimI2cBus(uint32_t baudrate, SimClock* clock) {
+    this->target_baudrate = baudrate;
+    this->baudrate = baudrate;
+    this->clock = clock;
+}
+
+bool SimI2cBus::attach(SimI2cDevice* device) {
+    if (this->devices_count >= SIM_I2C_MAX_DEVICES) return false;
+    this->devices[this->devices_count++] = device;
+    return true;
+}
+
+SimI2cDevice* SimI2cBus::find(uint8_t addr) {
+    for (uint8_t i = 0; i < this->devices_count; i++) {
+        if (this->devices[i]->get_addr() == addr) return this->devices[i]->follows(this->baudrate) ? this->devices[i] : nullptr;
+    }
+    return nullptr;
+}
+
+uint32_t SimI2cBus::transfer_time_us(uint32_t baudrate, size_t len) {
+    uint32_t clocks = (len + 1) * 9 + 2;
+    return clocks * 1000000 / baudrate;
+}
+
+uint32_t SimI2cBus::read_time_us(uint32_t baudrate, size_t len) {
+    return transfer_time_us(baudrate, 1) + transfer_time_us(baudrate, len);
+}
+
+void SimI2cBus::reset_stats() {
+    this->bus_time_us = 0;
+    this->transfers = 0;
+}
+
+uint32_t SimI2cBus::set_baudrate(uint32_t baudrate) {
+    this->wait_idle();
+    this->target_baudrate = baudrate;
+    this->baudrate = baudrate;
+    return this->baudrate;
+}
+
+i2c_status SimI2cBus::write(uint8_t addr, const uint8_t* data, size_t len) {
+    this->wait_idle();
+    SimI2cDevice* device = this->find(addr);
+    // A missing slave NACKs its address, only the address byte is clocked
+    uint32_t duration = transfer_time_us(this->baudrate, device ? len : 0);
+    this->bus_time_us += duration;
+    this->transfers++;
+    this->clock->advance(duration);
+
+    if (device == nullptr) return I2C_NACK;
+    device->update(this->clock->now());
+    device->write(data, len, this->clock->now());
+    return I2C_OK;
+}
+
+i2c_status SimI2cBus::read_register(uint8_t addr, uint8_t reg, uint8_t* data, size_t len) {
+    i2c_status status = this->write(addr, &reg, 1);
+    if (status != I2C_OK) return status;
+
+    SimI2cDevice* device = this->find(addr);
+    uint32_t duration = transfer_time_us(this->baudrate, len);
+    this->bus_time_us += duration;
+    this->clock->advance(duration);
+
+    device->update(this->clock->now());
+    device->read(data, len);
+    return I2C_OK;
+}
+
+void SimI2cBus::recover() {
+    this->recoveries++;
+    this->stuck = false;
+}
+
+void SimI2cBus::start(i2c_transaction_t* transaction) {
+    SimI2cDevice* device = this->find(transaction->addr);
+    uint64_t now = this->clock->now();
+    this->transfers++;
+
+    this->transfer_nack = device == nullptr;
+    if (this->transfer_nack) {
+        this->transfer_end = now + transfer_time_us(this->baudrate, 0);
+        this->bus_time_us += transfer_time_us(this->baudrate, 0);
+        return;
+    }
+
+    // The registers are sampled at the start, the data shows up once the transfer time has elapsed
+    device->write(&transaction->reg, 1, now);
+    device->update(now);
+    device->read(transaction->data, transaction->len);
+
+    uint32_t duration = read_time_us(this->baudrate, transaction->len);
+    this->transfer_end = now + duration;
+    this->bus_time_us += duration;
+}
+
+i2c_transaction_status SimI2cBus::check(i2c_transaction_t* transaction) {
+    if (this->stuck) return I2C_TRANSACTION_PENDING;
+    if (this->clock->now() < this->transfer_end) return I2C_TRANSACTION_PENDING;
+    return this->transfer_nack ? I2C_TRANSACTION_ERROR : I2C_TRANSACTION_DONE;
+}
+
+void SimI2cBus::abort(i2c_transaction_t* transaction) {
+    this->transfer_end = 0;
+}
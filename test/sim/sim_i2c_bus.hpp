@@ -0,0 +1,152 @@
+#ifndef SIM_I2C_BUS_HPP
+#define SIM_I2C_BUS_HPP
+
+#include "i2c_bus.hpp"
+#include "MPU6050.hpp"
+#include "BMP280.hpp"
+#include "sim_clock.hpp"
+
+#define SIM_I2C_MAX_DEVICES 4
+
+// Register file of one simulated slave. A write sets the register pointer with its first byte
+// and stores the rest, a read streams from the pointer, both auto-increment like the real parts.
+class SimI2cDevice {
+protected:
+    uint8_t addr;
+    uint8_t regs[256] = {};
+    uint8_t pointer = 0;
+
+    uint32_t noise;
+    uint32_t seed = 0x12345678;
+    // Fastest clock the slave follows, 0 for any. Above it the address is not acknowledged.
+    uint32_t max_baudrate = 0;
+    // Uniform noise in [-noise, noise] counts
+    int32_t noise_sample();
+
+public:
+    SimI2cDevice(uint8_t addr, uint32_t noise);
+
+    uint8_t get_addr() { return this->addr; }
+    void set_noise(uint32_t noise) { this->noise = noise; }
+    void set_max_baudrate(uint32_t baudrate) { this->max_baudrate = baudrate; }
+    bool follows(uint32_t baudrate) { return this->max_baudrate == 0 || baudrate <= this->max_baudrate; }
+
+    // Refresh the output registers, called before every read
+    virtual void update(uint64_t time_us) {}
+    // time_us is when the write ends on the bus
+    virtual void write(const uint8_t* data, size_t len, uint64_t time_us);
+    virtual void read(uint8_t* data, size_t len);
+};
+
+// Burst layout, WHO_AM_I, the config registers, the FIFO, the self-test and the auxiliary master
+// slave 0 of the MPU6050, outputs are raw counts. Sleep and the gyro standby bits are honoured,
+// cycle mode still samples at the output data rate.
+// Samples are produced at the rate set by SMPLRT_DIV and CONFIG.
+class SimMPU6050: public SimI2cDevice {
+    vector3<int16_t> acc = {0, 0, 2048};
+    vector3<int16_t> gyro = {0, 0, 0};
+    int16_t temp = 0;
+
+    // Output shift of each axis with its self-test enabled, the factory trims by default
+    vector3<int16_t> acc_self_test;
+    vector3<int16_t> gyro_self_test;
+
+    uint64_t next_sample_time = 0;
+    uint8_t fifo[MPU_FIFO_SIZE];
+    uint16_t fifo_head = 0;
+    uint16_t fifo_count = 0;
+
+    // Slave wired to the auxiliary bus, read by slave 0 of the master after every sample
+    SimI2cDevice* aux = nullptr;
+
+    uint32_t sample_period_us();
+    void sample(uint64_t time_us);
+    void push_fifo(const uint8_t* data, uint8_t len);
+
+public:
+    SimMPU6050(uint8_t addr, uint32_t noise);
+
+    void set_acc(vector3<int16_t> acc) { this->acc = acc; }
+    void set_gyro(vector3<int16_t> gyro) { this->gyro = gyro; }
+    void set_temp(int16_t temp) { this->temp = temp; }
+    void attach_aux(SimI2cDevice* aux) { this->aux = aux; }
+    // Zero an axis to model a dead one
+    void set_self_test_response(vector3<int16_t> acc, vector3<int16_t> gyro);
+
+    void update(uint64_t time_us) override;
+    void write(const uint8_t* data, size_t len, uint64_t time_us) override;
+    void read(uint8_t* data, size_t len) override;
+};
+
+// Chip id, datasheet calibration block and 20 bits ADC outputs of the BMP280.
+// The defaults are the datasheet compensation example: 25.08 degC and 100653 Pa.
+// Results land at the typical conversion time of CTRL_MEAS and CONFIG, STATUS shows the conversion.
+// A forced conversion goes back to sleep once done.
+class SimBMP280: public SimI2cDevice {
+    int32_t adc_temp = 519888;
+    int32_t adc_pressure = 415148;
+
+    uint64_t conversion_end = 0;
+    uint32_t conversions = 0;
+
+    bmp280_profile_t get_profile();
+    void convert();
+
+public:
+    SimBMP280(uint8_t addr, uint32_t noise);
+
+    void set_adc(int32_t adc_temp, int32_t adc_pressure);
+    uint32_t get_conversions() { return this->conversions; }
+    uint64_t get_conversion_end() { return this->conversion_end; }
+
+    void update(uint64_t time_us) override;
+    void write(const uint8_t* data, size_t len, uint64_t time_us) override;
+};
+
+// I2C bus backed by register models instead of wires. Transfers complete after the time
+// the real bus would take at the configured baudrate, and that time is accounted.
+// Blocking transfers advance the clock by their duration, async ones are done once it has passed.
+class SimI2cBus: public I2cBus {
+protected:
+    SimClock* clock;
+    SimI2cDevice* devices[SIM_I2C_MAX_DEVICES];
+    uint8_t devices_count = 0;
+
+    uint64_t transfer_end = 0;
+    bool transfer_nack = false;
+    // A slave holding SDA low, async transfers never end until recover()
+    bool stuck = false;
+
+    uint64_t bus_time_us = 0;
+    uint32_t transfers = 0;
+
+    SimI2cDevice* find(uint8_t addr);
+
+public:
+    SimI2cBus(uint32_t baudrate, SimClock* clock);
+
+    // Bus time of len bytes plus the address and the start/stop conditions
+    static uint32_t transfer_time_us(uint32_t baudrate, size_t len);
+    // Bus time of a register read: address + register, then address + len bytes.
+    // I2cScheduler::transfer_cost_us estimates it in one piece, within a few clocks.
+    static uint32_t read_time_us(uint32_t baudrate, size_t len);
+
+    bool attach(SimI2cDevice* device);
+
+    uint64_t get_bus_time_us() { return this->bus_time_us; }
+    uint32_t get_transfers() { return this->transfers; }
+    void reset_stats();
+    void set_stuck(bool stuck) { this->stuck = stuck; }
+
+    uint32_t set_baudrate(uint32_t baudrate) override;
+    i2c_status write(uint8_t addr, const uint8_t* data, size_t len) override;
+    i2c_status read_register(uint8_t addr, uint8_t reg, uint8_t* data, size_t len) override;
+    void recover() override;
+
+protected:
+    void start(i2c_transaction_t* transaction) override;
+    i2c_transaction_status check(i2c_transaction_t* transaction) override;
+    void abort(i2c_transaction_t* transaction) override;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "sim_pio_i2c_bus.hpp"
+#include "PioI2C.pio.h"
+#include <cstring>
+
+// State machine cycles of a data record (8 bits and the ACK) and of an executed instruction
+#define PIO_I2C_BYTE_CYCLES (9 * PIO_I2C_CYCLES_PER_BIT)
+#define PIO_I2C_INSTRUCTION_CYCLES 8
+
+SimPioI2cBus::SimPioI2cBus(PIO pio, uint sm, uint32_t baudrate, SimClock* clock)
+    : SimI2cBus(baudrate, clock), pio_i2c(pio, sm, 0, 1, baudrate) {}
+
+i2c_status SimPioI2cBus::execute(const uint16_t* cmd, uint count, uint8_t* rx, uint rx_len, uint64_t time_us, uint32_t* duration_us) {
+    bool scl = true, sda = true;
+    bool addressing = false;
+    bool reading = false;
+    SimI2cDevice* device = nullptr;
+    uint8_t written[I2C_BUS_MAX_TRANSFER + 1];
+    uint written_len = 0;
+    uint received = 0;
+    uint64_t cycles = 0;
+    i2c_status status = I2C_OK;
+
+    auto now = [&]() { return time_us + cycles * 1000000 / ((uint64_t)PIO_I2C_CYCLES_PER_BIT * this->baudrate); };
+    // The register pointer write lands before a repeated start or a stop
+    auto flush = [&]() {
+        if (device != nullptr && !reading && written_len) {
+            device->update(now());
+            device->write(written, written_len, now());
+        }
+        written_len = 0;
+    };
+
+    for (uint i = 0; i < count; i++) {
+        uint16_t record = cmd[i];
+        uint instructions = record >> PioI2C::ICOUNT_LSB;
+        if (instructions) {
+            // The next instructions + 1 records are set pindirs with SCL side-set
+            for (uint j = 0; j <= instructions && i + 1 < count; j++) {
+                uint16_t instruction = cmd[++i];
+                bool next_scl = (instruction >> 11) & 1;
+                bool next_sda = instruction & 1;
+                if (scl && next_scl && sda && !next_sda) {
+                    flush();
+                    addressing = true;
+                } else if (scl && next_scl && !sda && next_sda) {
+                    flush();
+                    device = nullptr;
+                }
+                scl = next_scl;
+                sda = next_sda;
+                cycles += PIO_I2C_INSTRUCTION_CYCLES;
+            }
+            continue;
+        }
+
+        bool final = (record >> PioI2C::FINAL_LSB) & 1;
+        uint8_t byte = (record >> PioI2C::DATA_LSB) & 0xFF;
+        bool ack;
+        if (addressing) {
+            addressing = false;
+            reading = byte & 1;
+            device = this->find(byte >> 1);
+            ack = device != nullptr;
+            if (ack && reading) device->update(now());
+        } else if (reading) {
+            // The slave drives the data, the master the ACK bit
+            if (device != nullptr) device->read(&byte, 1);
+            ack = !(record & (1u << PioI2C::NAK_LSB));
+        } else {
+            if (written_len < sizeof(written)) written[written_len++] = byte;
+            ack = device != nullptr;
+        }
+        cycles += PIO_I2C_BYTE_CYCLES;
+        if (received < rx_len) rx[received++] = byte;
+
+        // A NAK on a record without Final stops the machine on its IRQ
+        if (!ack && !final) {
+            status = I2C_NACK;
+            break;
+        }
+    }
+    if (status == I2C_OK) flush();
+
+    *duration_us = (cycles * 1000000 + (uint64_t)PIO_I2C_CYCLES_PER_BIT * this->baudrate - 1) / ((uint64_t)PIO_I2C_CYCLES_PER_BIT * this->baudrate);
+    return status;
+}
+
+uint32_t SimPioI2cBus::set_baudrate(uint32_t baudrate) {
+    this->wait_idle();
+    this->target_baudrate = baudrate;
+    this->baudrate = this->pio_i2c.setBaudrate(baudrate);
+    return this->baudrate;
+}
+
+i2c_status SimPioI2cBus::write(uint8_t addr, const uint8_t* data, size_t len) {
+    if (len > I2C_BUS_MAX_TRANSFER) return I2C_NACK;
+    this->wait_idle();
+    uint count = this->pio_i2c.buildWrite(this->cmd, addr, data, len);
+    uint32_t duration;
+    i2c_status status = this->execute(this->cmd, count, this->rx, len + 1, this->clock->now(), &duration);
+    this->bus_time_us += duration;
+    this->transfers++;
+    this->clock->advance(duration);
+    return status;
+}
+
+i2c_status SimPioI2cBus::read_register(uint8_t addr, uint8_t reg, uint8_t* data, size_t len) {
+    if (len > I2C_BUS_MAX_TRANSFER) return I2C_NACK;
+    this->wait_idle();
+    uint count = this->pio_i2c.buildReadRegister(this->cmd, addr, reg, len);
+    uint32_t duration;
+    i2c_status status = this->execute(this->cmd, count, this->rx, len + PioI2C::READ_REGISTER_ECHO, this->clock->now(), &duration);
+    this->bus_time_us += duration;
+    this->transfers++;
+    this->clock->advance(duration);
+    if (status == I2C_OK) std::memcpy(data, this->rx + PioI2C::READ_REGISTER_ECHO, len);
+    return status;
+}
+
+void SimPioI2cBus::start(i2c_transaction_t* transaction) {
+    // The whole command stream runs at once, the data shows up once its bus time has elapsed
+    uint count = this->pio_i2c.buildReadRegister(this->cmd, transaction->addr, transaction->reg, transaction->len);
+    uint32_t duration;
+    uint64_t now = this->clock->now();
+    i2c_status status = this->execute(this->cmd, count, this->rx, transaction->len + PioI2C::READ_REGISTER_ECHO, now, &duration);
+    if (status == I2C_OK) std::memcpy(transaction->data, this->rx + PioI2C::READ_REGISTER_ECHO, transaction->len);
+
+    this->transfer_nack = status != I2C_OK;
+    this->transfer_end = now + duration;
+    this->bus_time_us += duration;
+    this->transfers++;
+}
@@ -0,0 +1,31 @@
+#ifndef SIM_PIO_I2C_BUS_HPP
+#define SIM_PIO_I2C_BUS_HPP
+
+#include "sim_i2c_bus.hpp"
+#include "PioI2C.hpp"
+
+// PIO I2C master on the simulated bus: transfers are the command streams PioI2C builds for the
+// state machine, executed record by record the way PioI2C.pio does against the register models.
+// Start, repeated start and stop come from the SCL/SDA levels of the instruction records, every
+// clocked byte is echoed in RX and an unexpected NAK stops the machine.
+class SimPioI2cBus: public SimI2cBus {
+    PioI2C pio_i2c;
+    uint16_t cmd[PioI2C::readRegisterLength(I2C_BUS_MAX_TRANSFER)];
+    uint8_t rx[I2C_BUS_MAX_TRANSFER + PioI2C::READ_REGISTER_ECHO];
+
+public:
+    SimPioI2cBus(PIO pio, uint sm, uint32_t baudrate, SimClock* clock);
+
+    // Run count records from time_us, fill rx with up to rx_len clocked bytes.
+    // Return I2C_NACK where the machine would raise its IRQ, duration_us is the bus time used.
+    i2c_status execute(const uint16_t* cmd, uint count, uint8_t* rx, uint rx_len, uint64_t time_us, uint32_t* duration_us);
+
+    uint32_t set_baudrate(uint32_t baudrate) override;
+    i2c_status write(uint8_t addr, const uint8_t* data, size_t len) override;
+    i2c_status read_register(uint8_t addr, uint8_t reg, uint8_t* data, size_t len) override;
+
+protected:
+    void start(i2c_transaction_t* transaction) override;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include <cstdlib>
+#include <new>
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+#include "i2c_scheduler.hpp"
+
+// The acquisition path must not touch the heap: every operator new of the process is counted
+// and the count may not move across the sample loops
+
+static uint32_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* pointer = malloc(size ? size : 1);
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t size) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t size) noexcept {
+    free(pointer);
+}
+
+#define SAMPLES 1000
+
+// Blocking updates, the burst path of the flight loop
+static void test_burst_updates() {
+    SimSensorsFixture rig(100, 10);
+
+    uint32_t before = allocations;
+    uint32_t samples = 0;
+    while (samples < SAMPLES) {
+        if (rig.mpu6050.update() == I2C_OK) samples++;
+        rig.bmp280.update();
+        sdk_clock.advance(100);
+    }
+    printf("burst: %u allocations for %u samples\n", allocations - before, samples);
+    CHECK_EQ(allocations - before, 0);
+}
+
+// The single sensor reads and the connection checks
+static void test_partial_updates() {
+    SimSensorsFixture rig(100, 10);
+
+    uint32_t before = allocations;
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        rig.mpu6050.update_only_acc();
+        rig.mpu6050.update_only_gyro();
+        rig.mpu6050.update_only_temp();
+        CHECK(rig.bmp280.test_connection());
+    }
+    printf("partial: %u allocations for %u samples\n", allocations - before, SAMPLES);
+    CHECK_EQ(allocations - before, 0);
+}
+
+// FIFO batches and the BMP280 through the scheduler, the async path of the flight loop
+static void test_scheduled_fifo_updates() {
+    SimSensorsFixture rig(100, 10);
+    rig.mpu6050.enable_fifo();
+    I2cScheduler scheduler(sdk_clock_now);
+    int mpu6050_slot = scheduler.add(&rig.mpu6050);
+    scheduler.add(&rig.bmp280);
+
+    uint32_t before = allocations;
+    uint32_t samples = 0;
+    while (samples < SAMPLES) {
+        if (scheduler.run() & (1u << mpu6050_slot)) samples += rig.mpu6050.batch.count;
+        sdk_clock.advance(10);
+    }
+    printf("scheduled fifo: %u allocations for %u samples\n", allocations - before, samples);
+    CHECK_EQ(allocations - before, 0);
+}
+
+int main() {
+    // The counter itself works
+    uint32_t before = allocations;
+    int* volatile pointer = new int(1);
+    delete pointer;
+    CHECK_EQ(allocations - before, 1);
+
+    test_burst_updates();
+    test_partial_updates();
+    test_scheduled_fifo_updates();
+    return check_result();
+}
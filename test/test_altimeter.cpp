@@ -0,0 +1,59 @@
+#include <cmath>
+#include "check.hpp"
+#include "altimeter.hpp"
+
+// Table lookup against the standard atmosphere formula in double, every Q24.8 step from 10km to
+// sea level, and the ground reference and clamping around it
+
+static double standard_altitude_mm(uint32_t pressure) {
+    return 44330.77 * (1 - std::pow(pressure / 256.0 / ALTIMETER_SEA_LEVEL_PA, 0.190263)) * 1000;
+}
+
+static void test_error_0_to_10km() {
+    // 26436Pa is the standard atmosphere pressure at 10km
+    double max_error = 0;
+    for (uint32_t pressure = 26436 << 8; pressure <= ALTIMETER_SEA_LEVEL_PA << 8; pressure++) {
+        double error = std::fabs(Altimeter::to_standard_altitude_mm(pressure) - standard_altitude_mm(pressure));
+        if (error > max_error) max_error = error;
+    }
+    printf("max error 0 to 10km: %.1fmm\n", max_error);
+    CHECK(max_error < 100);
+}
+
+static void test_monotonic() {
+    int32_t previous = Altimeter::to_standard_altitude_mm(0);
+    for (uint32_t pressure = 1; pressure <= (ALTIMETER_PRESSURE_MAX_PA + 1000) << 8; pressure += 7) {
+        int32_t altitude = Altimeter::to_standard_altitude_mm(pressure);
+        CHECK(altitude <= previous);
+        previous = altitude;
+    }
+}
+
+static void test_clamped() {
+    CHECK_EQ(Altimeter::to_standard_altitude_mm(0), Altimeter::to_standard_altitude_mm(ALTIMETER_PRESSURE_MIN_PA << 8));
+    CHECK_EQ(Altimeter::to_standard_altitude_mm(0xFFFFFFFF), Altimeter::to_standard_altitude_mm(ALTIMETER_PRESSURE_MAX_PA << 8));
+}
+
+static void test_ground_reference() {
+    Altimeter altimeter;
+    CHECK(!altimeter.has_ground());
+    // A pad at about 500m
+    uint32_t ground = 95461 << 8;
+    altimeter.set_ground(ground);
+    CHECK(altimeter.has_ground());
+    CHECK_EQ(altimeter.get_ground_pressure(), ground);
+    CHECK_EQ(altimeter.get_altitude_mm(ground), 0);
+
+    // 1km above the pad, against the formula difference
+    uint32_t apogee = 84556 << 8;
+    double expected = standard_altitude_mm(apogee) - standard_altitude_mm(ground);
+    CHECK(std::fabs(altimeter.get_altitude_mm(apogee) - expected) < 200);
+}
+
+int main() {
+    test_error_0_to_10km();
+    test_monotonic();
+    test_clamped();
+    test_ground_reference();
+    return check_result();
+}
@@ -0,0 +1,62 @@
+#include <cmath>
+#include "check.hpp"
+#include "BMP280.hpp"
+
+// The 32 bits compensation against the 64 bits one over every raw pressure code, at every
+// degree from -25 to 62 degC, with the datasheet example calibration
+
+#define SWEEP_MIN_PA 30000
+#define SWEEP_MAX_PA 110000
+// fine_temp is in 1/5120 degC
+#define FINE_TEMP_PER_DEGC 5120
+
+static constexpr BMP280_calib_param calib_example = {27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000};
+
+static void test_full_range_sweep() {
+    double max_error = 0, total_error = 0;
+    uint64_t in_range = 0;
+    uint32_t non_monotonic = 0;
+    for (int32_t temperature = -25; temperature <= 62; temperature++) {
+        int32_t fine_temp = temperature * FINE_TEMP_PER_DEGC;
+        uint32_t previous = UINT32_MAX;
+        for (int32_t raw = 0; raw < (1 << 20); raw++) {
+            uint32_t pressure_64 = bmp280_compensate_pressure_64(calib_example, raw, fine_temp);
+            double pressure = pressure_64 / 256.0;
+            if (pressure < SWEEP_MIN_PA || pressure > SWEEP_MAX_PA) continue;
+
+            // A higher raw code is a lower pressure
+            if (pressure_64 > previous) non_monotonic++;
+            previous = pressure_64;
+
+            double error = fabs((double)bmp280_compensate_pressure_32(calib_example, raw, fine_temp) - pressure);
+            if (error > max_error) max_error = error;
+            total_error += error;
+            in_range++;
+        }
+    }
+    printf("%llu codes from 300 to 1100hPa, 32 bits within %.2fPa, %.2fPa on average\n", (unsigned long long)in_range, max_error, total_error / in_range);
+    CHECK(in_range > 88 * 300000);
+    CHECK_EQ(non_monotonic, 0);
+    CHECK(max_error < 6);
+    CHECK(total_error / in_range < 1.5);
+}
+
+static void test_datasheet_example() {
+    CHECK_EQ(bmp280_compensate_pressure_64(calib_example, 415148, 128422), 25767233);
+    CHECK_EQ(bmp280_compensate_pressure_32(calib_example, 415148, 128422), 100656);
+}
+
+// A zero dig_P1 (erased or unread calibration) must not divide by zero
+static void test_zero_calibration() {
+    BMP280_calib_param calib = calib_example;
+    calib.dig_P1 = 0;
+    CHECK_EQ(bmp280_compensate_pressure_64(calib, 415148, 128422), 0);
+    CHECK_EQ(bmp280_compensate_pressure_32(calib, 415148, 128422), 0);
+}
+
+int main() {
+    test_datasheet_example();
+    test_zero_calibration();
+    test_full_range_sweep();
+    return check_result();
+}
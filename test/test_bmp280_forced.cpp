@@ -0,0 +1,92 @@
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+
+// Forced mode: one conversion per trigger, read once it is guaranteed done, with the trigger
+// and the estimated completion time in the result
+
+static void test_no_trigger() {
+    SimBMP280Fixture rig(20);
+    rig.bmp280.set_mode(BMP280_MODE_FORCED);
+    CHECK_EQ(rig.bmp280.get_mode(), BMP280_MODE_FORCED);
+
+    // The conversion started by entering forced mode is the only one
+    uint32_t conversions = rig.sim_bmp280.get_conversions();
+    rig.bus.reset_stats();
+    uint64_t end = sdk_clock.now() + 100000;
+    while (sdk_clock.now() < end) {
+        CHECK_EQ(rig.bmp280.update(), I2C_NOT_DUE);
+        sdk_clock.advance(10);
+    }
+    CHECK(rig.sim_bmp280.get_conversions() - conversions <= 1);
+    CHECK_EQ(rig.bus.get_transfers(), 0);
+    CHECK(!rig.bmp280.is_triggered());
+}
+
+static void test_triggered_loop() {
+    SimBMP280Fixture rig(20);
+    rig.bmp280.set_profile(BMP280_PROFILE_ASCENT);
+    rig.bmp280.set_mode(BMP280_MODE_FORCED);
+    sdk_clock.advance(bmp280_measurement_time_us(BMP280_PROFILE_ASCENT));
+    uint32_t conversions = rig.sim_bmp280.get_conversions();
+
+    // 100Hz triggers, the ascent profile converts in 6.4ms at most and the update loop collects in between
+    uint32_t triggers = 0;
+    uint32_t results = 0;
+    uint64_t next_trigger = sdk_clock.now();
+    uint64_t end = sdk_clock.now() + 1000000;
+    while (sdk_clock.now() < end) {
+        if (sdk_clock.now() >= next_trigger) {
+            CHECK_EQ(rig.bmp280.trigger(), I2C_OK);
+            CHECK(rig.bmp280.is_triggered());
+            // Nothing new until the pending one is read
+            CHECK_EQ(rig.bmp280.trigger(), I2C_BUSY);
+            triggers++;
+            next_trigger += 10000;
+        }
+        uint64_t read_time = sdk_clock.now();
+        if (rig.bmp280.update() == I2C_OK) {
+            results++;
+            CHECK(rig.bmp280.data.fresh);
+            CHECK(!rig.bmp280.is_triggered());
+            // Collected after the maximum measurement time, stamped at the typical one
+            CHECK(read_time >= rig.bmp280.data.trigger_time + bmp280_measurement_time_us(BMP280_PROFILE_ASCENT));
+            CHECK_EQ(rig.bmp280.data.timestamp - rig.bmp280.data.trigger_time, bmp280_measurement_time_typ_us(BMP280_PROFILE_ASCENT));
+            // The model finished it in between
+            CHECK_EQ(rig.sim_bmp280.get_conversion_end(), 0);
+        }
+        sdk_clock.advance(10);
+    }
+    CHECK_EQ(triggers, 100);
+    CHECK(results >= 99 && results <= 100);
+    CHECK_EQ(rig.sim_bmp280.get_conversions() - conversions, triggers);
+}
+
+// Back to normal mode free-runs again and clears the forced bookkeeping
+static void test_back_to_normal() {
+    SimBMP280Fixture rig(20);
+    rig.bmp280.set_mode(BMP280_MODE_FORCED);
+    CHECK_EQ(rig.bmp280.trigger(), I2C_OK);
+    rig.bmp280.set_mode(BMP280_MODE_NORMAL);
+    CHECK(!rig.bmp280.is_triggered());
+    CHECK_EQ(rig.bmp280.trigger(), I2C_NOT_DUE);
+
+    uint32_t results = 0;
+    uint64_t end = sdk_clock.now() + 100000;
+    while (sdk_clock.now() < end) {
+        if (rig.bmp280.update() == I2C_OK) {
+            results++;
+            CHECK_EQ(rig.bmp280.data.trigger_time, 0);
+        }
+        sdk_clock.advance(10);
+    }
+    CHECK(results >= 100000 / rig.bmp280.get_measurement_period_us() - 1);
+}
+
+int main() {
+    test_no_trigger();
+    test_triggered_loop();
+    test_back_to_normal();
+    return check_result();
+}
@@ -0,0 +1,44 @@
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+
+// The CTRL_MEAS and CONFIG bytes each profile writes, spelled out from the datasheet fields:
+// osrs_t[7:5] osrs_p[4:2] mode[1:0] and t_sb[7:5] filter[4:2]
+
+static uint8_t read_register(SimI2cBus* bus, uint8_t reg) {
+    uint8_t value = 0;
+    CHECK_EQ(bus->read_register(0x76, reg, &value, 1), I2C_OK);
+    return value;
+}
+
+static void test_profile(const bmp280_profile_t& profile, uint8_t ctrl_meas, uint8_t config) {
+    SimBMP280Fixture rig;
+    rig.bmp280.set_mode(BMP280_MODE_NORMAL);
+
+    // Three writes, the last one leaves sleep and restarts the conversions with the new settings
+    rig.bus.reset_stats();
+    rig.bmp280.set_profile(profile);
+    CHECK_EQ(rig.bus.get_transfers(), 3);
+    CHECK_EQ(rig.sim_bmp280.get_conversion_end(), sdk_clock.now() + bmp280_measurement_time_typ_us(profile));
+    CHECK_EQ(read_register(&rig.bus, BMP280_REG_CTRL_MEAS), ctrl_meas | BMP280_MODE_NORMAL);
+    CHECK_EQ(read_register(&rig.bus, BMP280_REG_CONFIG), config);
+
+    // The read period follows the profile
+    CHECK_EQ(rig.bmp280.get_measurement_period_us(), bmp280_measurement_period_us(profile));
+    CHECK_EQ(rig.bmp280.get_freq(), BMP280_POLLS_PER_RESULT * 1000000 / bmp280_measurement_period_us(profile));
+
+    // In forced mode the profile is written with the part left asleep until the next trigger
+    rig.bmp280.set_mode(BMP280_MODE_FORCED);
+    rig.bmp280.set_profile(profile);
+    CHECK_EQ(read_register(&rig.bus, BMP280_REG_CTRL_MEAS), ctrl_meas | BMP280_MODE_SLEEP);
+    CHECK_EQ(read_register(&rig.bus, BMP280_REG_CONFIG), config);
+}
+
+int main() {
+    test_profile(BMP280_PROFILE_ASCENT, 0b00100100, 0b00000000);
+    test_profile(BMP280_PROFILE_STANDARD, 0b00101100, 0b00001000);
+    test_profile(BMP280_PROFILE_APOGEE, 0b00110000, 0b00001000);
+    test_profile(BMP280_PROFILE_PAD, 0b01010100, 0b00010000);
+    return check_result();
+}
@@ -0,0 +1,86 @@
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+
+// Normal mode polling: reads that find the previous conversion again are counted and not
+// compensated, polls before a conversion can be there cost no transfer, and the timestamps
+// land near the modelled end of the conversion
+
+struct poll_result {
+    uint32_t fresh;
+    uint32_t stale_changed;
+    uint64_t max_error_us;
+    uint64_t total_error_us;
+};
+
+static poll_result poll_for(BMP280* bmp280, SimBMP280* sim_bmp280, uint64_t duration_us) {
+    poll_result result = {};
+    uint32_t period_typ = bmp280_measurement_period_typ_us(bmp280->get_profile());
+    uint64_t end = sdk_clock.now() + duration_us;
+    while (sdk_clock.now() < end) {
+        BMP280_DATA previous = bmp280->data;
+        i2c_status status = bmp280->update();
+        if (status == I2C_OK) {
+            CHECK(bmp280->data.fresh);
+            result.fresh++;
+            // The last conversion the model finished before the read
+            uint64_t conversion_end = sim_bmp280->get_conversion_end() - period_typ;
+            uint64_t error = bmp280->data.timestamp > conversion_end ? bmp280->data.timestamp - conversion_end : conversion_end - bmp280->data.timestamp;
+            if (error > result.max_error_us) result.max_error_us = error;
+            result.total_error_us += error;
+        } else if (bmp280->data.pressure != previous.pressure || bmp280->data.timestamp != previous.timestamp) {
+            result.stale_changed++;
+        }
+        sdk_clock.advance(10);
+    }
+    return result;
+}
+
+static void test_ascent_polling() {
+    SimBMP280Fixture rig(20);
+    rig.bmp280.set_profile(BMP280_PROFILE_ASCENT);
+    uint32_t period = rig.bmp280.get_measurement_period_us();
+
+    // Skip the first result, its conversion is only known within a period
+    poll_for(&rig.bmp280, &rig.sim_bmp280, period);
+    rig.bus.reset_stats();
+    uint32_t conversions = rig.sim_bmp280.get_conversions();
+    uint32_t stale_reads = rig.bmp280.get_stale_reads();
+
+    poll_result result = poll_for(&rig.bmp280, &rig.sim_bmp280, 1000000);
+    conversions = rig.sim_bmp280.get_conversions() - conversions;
+    stale_reads = rig.bmp280.get_stale_reads() - stale_reads;
+
+    // Every conversion is read once, the polls in between cost nothing on the rig.bus
+    CHECK(result.fresh + 1 >= conversions && result.fresh <= conversions);
+    CHECK_EQ(rig.bmp280.get_freq(), BMP280_POLLS_PER_RESULT * 1000000 / period);
+    CHECK(2 * rig.bus.get_transfers() < rig.bmp280.get_freq());
+    CHECK(rig.bus.get_transfers() <= result.fresh + stale_reads);
+    CHECK(stale_reads * 10 <= result.fresh);
+    CHECK_EQ(result.stale_changed, 0);
+
+    // Within a poll interval of the conversion end, and closer on average
+    CHECK(result.max_error_us <= period / BMP280_POLLS_PER_RESULT);
+    CHECK(result.total_error_us / result.fresh <= period / (2 * BMP280_POLLS_PER_RESULT));
+}
+
+// A steady pressure gives the same bytes every conversion, still fresh once one had to end
+static void test_constant_pressure() {
+    SimBMP280Fixture rig;
+    rig.bmp280.set_profile(BMP280_PROFILE_STANDARD);
+
+    poll_for(&rig.bmp280, &rig.sim_bmp280, rig.bmp280.get_measurement_period_us());
+    uint32_t conversions = rig.sim_bmp280.get_conversions();
+    poll_result result = poll_for(&rig.bmp280, &rig.sim_bmp280, 1000000);
+    conversions = rig.sim_bmp280.get_conversions() - conversions;
+
+    CHECK(result.fresh + 2 >= conversions && result.fresh <= conversions);
+    CHECK_EQ(result.stale_changed, 0);
+}
+
+int main() {
+    test_ascent_polling();
+    test_constant_pressure();
+    return check_result();
+}
@@ -0,0 +1,94 @@
+#include <cstdlib>
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+#include "i2c_scheduler.hpp"
+
+// Timing model of the bus layouts: the MPU6050 and BMP280 bursts due on the same tick,
+// on one shared controller or on one each
+
+// A scheduler timebase well away from time_us_64
+#define SHIFTED_CLOCK_OFFSET_US 1000000000ull
+
+static uint64_t shifted_clock_now() {
+    return sdk_clock.now() + SHIFTED_CLOCK_OFFSET_US;
+}
+
+// From the tick both reads are submitted to the tick both are joined
+static uint32_t acquisition_time_us(uint32_t baudrate, bool dual_bus) {
+    SimI2cBus bus0(baudrate, &sdk_clock);
+    SimI2cBus bus1(baudrate, &sdk_clock);
+    SimMPU6050 sim_mpu6050(MPU_DEFAULT_I2C_ADDR, 0);
+    SimBMP280 sim_bmp280(0x76, 0);
+    bus0.attach(&sim_mpu6050);
+    (dual_bus ? bus1 : bus0).attach(&sim_bmp280);
+    MPU6050 mpu6050(MPU_DEFAULT_I2C_ADDR, 1000, &bus0);
+    BMP280 bmp280(0x76, dual_bus ? &bus1 : &bus0);
+
+    I2cScheduler scheduler(sdk_clock_now);
+    scheduler.add(&mpu6050, 0);
+    scheduler.add(&bmp280, 0);
+    uint64_t start = sdk_clock.now();
+    scheduler.run();
+    CHECK(bus0.is_busy());
+    CHECK_EQ(bus1.is_busy(), dual_bus);
+    while (bus0.is_busy() || bus1.is_busy()) {
+        sdk_clock.advance(1);
+        scheduler.run();
+    }
+    return sdk_clock.now() - start;
+}
+
+static void test_overlap(uint32_t baudrate) {
+    uint32_t mpu6050_time = SimI2cBus::read_time_us(baudrate, mpu6050_burst_map::size);
+    uint32_t bmp280_time = SimI2cBus::read_time_us(baudrate, bmp280_burst_map::size);
+    uint32_t single = acquisition_time_us(baudrate, false);
+    uint32_t dual = acquisition_time_us(baudrate, true);
+    printf("%7u Hz: shared bus %u us, one bus each %u us (MPU6050 %u us, BMP280 %u us)\n", baudrate, single, dual, mpu6050_time, bmp280_time);
+
+    // Serialized on one controller, joined on the longer transfer with two
+    CHECK_EQ(single, mpu6050_time + bmp280_time);
+    CHECK_EQ(dual, mpu6050_time > bmp280_time ? mpu6050_time : bmp280_time);
+
+    // The scheduler cost model is within a few clocks of the simulated bus, the simulated stop
+    // between the two halves is one condition more
+    int32_t mpu6050_cost = I2cScheduler::transfer_cost_us(mpu6050_burst_map::size, baudrate);
+    int32_t bmp280_cost = I2cScheduler::transfer_cost_us(bmp280_burst_map::size, baudrate);
+    CHECK(abs(mpu6050_cost - (int32_t)mpu6050_time) <= 3);
+    CHECK(abs(bmp280_cost - (int32_t)bmp280_time) <= 3);
+}
+
+// The scheduled devices stamp their samples with the scheduler clock, not the hardware timer
+static void test_injected_clock() {
+    SimSensorsFixture rig;
+
+    I2cScheduler scheduler(shifted_clock_now);
+    int mpu6050_slot = scheduler.add(&rig.mpu6050);
+    int bmp280_slot = scheduler.add(&rig.bmp280);
+    CHECK(mpu6050_slot >= 0 && bmp280_slot >= 0);
+
+    uint32_t updated = 0;
+    uint64_t end = sdk_clock.now() + 100000;
+    while (sdk_clock.now() < end) {
+        uint64_t before = shifted_clock_now();
+        uint32_t slots = scheduler.run();
+        if (slots & (1u << mpu6050_slot)) {
+            CHECK(rig.mpu6050.data.timestamp >= SHIFTED_CLOCK_OFFSET_US && rig.mpu6050.data.timestamp <= before);
+        }
+        // The conversion time is only bounded by the reads, the first one by a period before it
+        if (slots & (1u << bmp280_slot)) {
+            CHECK(rig.bmp280.data.timestamp + rig.bmp280.get_measurement_period_us() >= SHIFTED_CLOCK_OFFSET_US && rig.bmp280.data.timestamp <= before);
+        }
+        updated |= slots;
+        sdk_clock.advance(1);
+    }
+    CHECK_EQ(updated, (1u << mpu6050_slot) | (1u << bmp280_slot));
+}
+
+int main() {
+    test_injected_clock();
+    test_overlap(I2C_FAST_MODE_BAUDRATE);
+    test_overlap(I2C_FAST_MODE_PLUS_BAUDRATE);
+    return check_result();
+}
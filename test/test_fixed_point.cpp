@@ -0,0 +1,84 @@
+#include <cmath>
+#include <cstdlib>
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+
+// The Q16 conversions of MPU6050 over every int16 count of every range and scale, against the
+// exact product and against the float division they replaced
+
+struct conversion_error
+{
+    // Distance to the exact value
+    double max_exact;
+    // Distance to the float path rounded to the same unit
+    int32_t max_float;
+} typedef conversion_error_t;
+
+static conversion_error_t sweep(int32_t (*convert)(MPU6050*, int16_t), MPU6050* mpu6050, double numerator, float lsb_per_unit, double offset) {
+    conversion_error_t error = {0, 0};
+    for (int32_t count = INT16_MIN; count <= INT16_MAX; count++) {
+        int32_t fixed = convert(mpu6050, (int16_t)count);
+        double exact = count * numerator / lsb_per_unit + offset;
+        if (fabs(fixed - exact) > error.max_exact) error.max_exact = fabs(fixed - exact);
+        // The float path: a division by the LSB per unit, then the unit change
+        int32_t float_path = (int32_t)lroundf((float)count / lsb_per_unit * (float)numerator + (float)offset);
+        if (abs(fixed - float_path) > error.max_float) error.max_float = abs(fixed - float_path);
+    }
+    return error;
+}
+
+static int32_t to_mdps(MPU6050* mpu6050, int16_t count) {
+    return mpu6050->to_mdps(count);
+}
+
+static int32_t to_mg(MPU6050* mpu6050, int16_t count) {
+    return mpu6050->to_mg(count);
+}
+
+static int32_t to_centi_celsius(MPU6050* mpu6050, int16_t count) {
+    return MPU6050::to_centi_celsius(count);
+}
+
+static void test_exhaustive_bounds() {
+    SimMPU6050Fixture rig;
+
+    for (uint8_t scale = MPU6050_SCALE_250DPS; scale <= MPU6050_SCALE_2000DPS; scale++) {
+        rig.mpu6050.set_gyro_scale((mpu_6050_scale)scale);
+        conversion_error_t error = sweep(to_mdps, &rig.mpu6050, 1000, rig.mpu6050.get_config().dps_per_digit, 0);
+        printf("gyro %4.1f LSB/dps: %.3f mdps from exact, %d from float\n", rig.mpu6050.get_config().dps_per_digit, error.max_exact, error.max_float);
+        CHECK(error.max_exact < 1);
+        CHECK(error.max_float <= 1);
+    }
+    for (uint8_t range = MPU6050_RANGE_2G; range <= MPU6050_RANGE_16G; range++) {
+        rig.mpu6050.set_accel_range((mpu_6050_range)range);
+        conversion_error_t error = sweep(to_mg, &rig.mpu6050, 1000, rig.mpu6050.get_config().range_per_digit, 0);
+        printf("acc %5.0f LSB/g: %.3f mg from exact, %d from float\n", rig.mpu6050.get_config().range_per_digit, error.max_exact, error.max_float);
+        CHECK(error.max_exact < 1);
+        CHECK(error.max_float <= 1);
+    }
+    // 340 LSB/degC, 36.53 degC at 0
+    conversion_error_t error = sweep(to_centi_celsius, &rig.mpu6050, 100, 340, 3653);
+    printf("temp 340 LSB/degC: %.3f cdegC from exact, %d from float\n", error.max_exact, error.max_float);
+    CHECK(error.max_exact < 1);
+    CHECK(error.max_float <= 1);
+}
+
+// Ranges with a power of two LSB per unit are exact up to the rounding of the result
+static void test_exact_ranges() {
+    SimMPU6050Fixture rig;
+    rig.mpu6050.set_accel_range(MPU6050_RANGE_16G);
+    CHECK_EQ(rig.mpu6050.to_mg(2048), 1000);
+    CHECK_EQ(rig.mpu6050.to_mg(-2048), -1000);
+    CHECK_EQ(rig.mpu6050.to_mg(INT16_MIN), -16000);
+    rig.mpu6050.set_gyro_scale(MPU6050_SCALE_2000DPS);
+    CHECK_EQ(rig.mpu6050.to_mdps(164), 10000);
+    CHECK_EQ(MPU6050::to_centi_celsius(-340), 3553);
+}
+
+int main() {
+    test_exact_ranges();
+    test_exhaustive_bounds();
+    return check_result();
+}
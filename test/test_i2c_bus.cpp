@@ -0,0 +1,96 @@
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+
+// Exposes the protected register accessors of I2cSensor
+class FieldSensor: public I2cSensor<int> {
+public:
+    FieldSensor(uint8_t addr, I2cBus* bus): I2cSensor(addr, 100, bus) {}
+    void init() override {}
+    bool test_connection() override { return true; }
+    bool submit_read() override { return false; }
+    bool complete_update() override { return false; }
+    uint8_t get_burst_length() override { return 0; }
+
+    using I2cSensor::read_field;
+    using I2cSensor::write_field;
+};
+
+static void test_read_field_status() {
+    SimI2cBus bus(I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimMPU6050 sim_mpu6050(MPU_DEFAULT_I2C_ADDR, 0);
+    bus.attach(&sim_mpu6050);
+    sim_mpu6050.set_acc({-1234, 0, 2048});
+    uint8_t wake[2] = {MPU_REG_PWR_MGMT_1, 0};
+    CHECK_EQ(bus.write(MPU_DEFAULT_I2C_ADDR, wake, sizeof(wake)), I2C_OK);
+    sdk_clock.advance(1000);
+
+    FieldSensor sensor(MPU_DEFAULT_I2C_ADDR, &bus);
+    int16_t value = 0;
+    CHECK_EQ(sensor.read_field<mpu6050_burst_map::acc_x>(MPU_REG_ACCEL_XOUT_H, value), I2C_OK);
+    CHECK_EQ(value, -1234);
+    CHECK_EQ(sensor.read_field<mpu6050_burst_map::acc_z>(MPU_REG_ACCEL_XOUT_H, value), I2C_OK);
+    CHECK_EQ(value, 2048);
+
+    // A NACK after the retry budget is reported and the value is left alone
+    FieldSensor missing(MPU_AD0_I2C_ADDR, &bus);
+    value = 42;
+    CHECK_EQ(missing.read_field<mpu6050_burst_map::acc_z>(MPU_REG_ACCEL_XOUT_H, value), I2C_NACK);
+    CHECK_EQ(value, 42);
+    CHECK_EQ(missing.get_error_counters().nack, I2C_RETRY_BUDGET + 1);
+    CHECK_EQ(missing.write_field<mpu6050_burst_map::acc_z>(MPU_REG_ACCEL_XOUT_H, 1), I2C_NACK);
+}
+
+static void test_recover_keeps_target_rate() {
+    HardwareI2cBus* bus = HardwareI2cBus::get(i2c1);
+    sdk_clk_peri_hz = 125000000;
+    CHECK_EQ(bus->init(I2C_FAST_MODE_BAUDRATE, 2, 3), 399361);
+    CHECK_EQ(bus->get_target_baudrate(), I2C_FAST_MODE_BAUDRATE);
+
+    // Every recovery starts again from the rate asked for, not from the rounded one
+    for (uint8_t i = 0; i < 4; i++) {
+        bus->recover();
+        CHECK_EQ(sdk_i2c_init_baudrate, I2C_FAST_MODE_BAUDRATE);
+        CHECK_EQ(bus->get_baudrate(), 399361);
+    }
+    CHECK_EQ(bus->get_recoveries(), 4);
+
+    CHECK_EQ(bus->set_baudrate(I2C_FAST_MODE_PLUS_BAUDRATE), 1000000);
+    bus->recover();
+    CHECK_EQ(sdk_i2c_init_baudrate, I2C_FAST_MODE_PLUS_BAUDRATE);
+}
+
+// The MPU6050 only follows fast mode, the BMP280 any clock
+static void test_negotiate_ladder() {
+    SimSensorsFixture rig(0, 0, I2C_STANDARD_MODE_BAUDRATE);
+    I2cDevice* devices[] = {&rig.mpu6050, &rig.bmp280};
+
+    // Every device answers at 1MHz
+    CHECK_EQ(rig.bus.negotiate_baudrate(devices, 2), I2C_FAST_MODE_PLUS_BAUDRATE);
+    CHECK_EQ(rig.bus.get_baudrate(), I2C_FAST_MODE_PLUS_BAUDRATE);
+
+    // One failing at 1MHz pulls the rig.bus down one step, and only one
+    rig.sim_mpu6050.set_max_baudrate(I2C_FAST_MODE_BAUDRATE);
+    CHECK_EQ(rig.bus.negotiate_baudrate(devices, 2), I2C_FAST_MODE_BAUDRATE);
+    CHECK_EQ(rig.bus.get_baudrate(), I2C_FAST_MODE_BAUDRATE);
+    CHECK(rig.mpu6050.test_connection());
+
+    rig.sim_bmp280.set_max_baudrate(I2C_STANDARD_MODE_BAUDRATE);
+    CHECK_EQ(rig.bus.negotiate_baudrate(devices, 2), I2C_STANDARD_MODE_BAUDRATE);
+    CHECK_EQ(rig.bus.get_baudrate(), I2C_STANDARD_MODE_BAUDRATE);
+
+    // Nothing reliable even in standard mode: 0, the rig.bus is left at 100kHz
+    rig.sim_bmp280.set_max_baudrate(I2C_STANDARD_MODE_BAUDRATE / 2);
+    CHECK_EQ(rig.bus.negotiate_baudrate(devices, 2), 0);
+    CHECK_EQ(rig.bus.get_baudrate(), I2C_STANDARD_MODE_BAUDRATE);
+    CHECK(!rig.bmp280.test_connection());
+    CHECK(rig.mpu6050.test_connection());
+}
+
+int main() {
+    test_read_field_status();
+    test_recover_keeps_target_rate();
+    test_negotiate_ladder();
+    return check_result();
+}
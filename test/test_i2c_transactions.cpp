@@ -0,0 +1,175 @@
+#include <chrono>
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+
+// The submit / poll / callback state machine of I2cBus on the simulated transport
+
+struct completion
+{
+    uint8_t order[4];
+    i2c_transaction_status status[4];
+    uint64_t time[4];
+    uint8_t count;
+} typedef completion_t;
+
+static void on_complete(i2c_transaction_t* transaction) {
+    completion_t* completion = (completion_t*)transaction->context;
+    completion->order[completion->count] = transaction->reg;
+    completion->status[completion->count] = transaction->status;
+    completion->time[completion->count] = sdk_clock.now();
+    completion->count++;
+}
+
+static i2c_transaction_t make_transaction(uint8_t addr, uint8_t reg, uint8_t* data, uint8_t len, completion_t* completion) {
+    i2c_transaction_t transaction = {};
+    transaction.addr = addr;
+    transaction.reg = reg;
+    transaction.data = data;
+    transaction.len = len;
+    transaction.callback = on_complete;
+    transaction.context = completion;
+    return transaction;
+}
+
+// Poll every microsecond until the queue drains
+static void drain(SimI2cBus* bus) {
+    while (bus->poll()) sdk_clock.advance(1);
+}
+
+// Queued transactions run back to back in submit order, each one ends after its bus time
+static void test_queue_order_and_timing() {
+    SimI2cBus bus(I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimMPU6050 sim_mpu6050(MPU_DEFAULT_I2C_ADDR, 0);
+    SimBMP280 sim_bmp280(0x76, 0);
+    bus.attach(&sim_mpu6050);
+    bus.attach(&sim_bmp280);
+
+    completion_t completion = {};
+    uint8_t mpu6050_data[mpu6050_burst_map::size];
+    uint8_t bmp280_data[bmp280_burst_map::size];
+    i2c_transaction_t first = make_transaction(MPU_DEFAULT_I2C_ADDR, MPU_REG_ACCEL_XOUT_H, mpu6050_data, sizeof(mpu6050_data), &completion);
+    i2c_transaction_t second = make_transaction(0x76, BMP280_REG_PRESSURE_MSB, bmp280_data, sizeof(bmp280_data), &completion);
+
+    uint64_t start = sdk_clock.now();
+    CHECK(bus.submit(&first));
+    CHECK(bus.submit(&second));
+    CHECK(bus.is_busy());
+    // Pending transactions cannot be queued twice
+    CHECK(!bus.submit(&first));
+    CHECK_EQ(second.status, I2C_TRANSACTION_PENDING);
+
+    drain(&bus);
+    CHECK(!bus.is_busy());
+    CHECK_EQ(completion.count, 2);
+    CHECK_EQ(completion.order[0], MPU_REG_ACCEL_XOUT_H);
+    CHECK_EQ(completion.order[1], BMP280_REG_PRESSURE_MSB);
+    CHECK_EQ(completion.status[0], I2C_TRANSACTION_DONE);
+    CHECK_EQ(completion.status[1], I2C_TRANSACTION_DONE);
+    uint32_t first_time = SimI2cBus::read_time_us(I2C_FAST_MODE_BAUDRATE, mpu6050_burst_map::size);
+    uint32_t second_time = SimI2cBus::read_time_us(I2C_FAST_MODE_BAUDRATE, bmp280_burst_map::size);
+    CHECK_EQ(completion.time[0] - start, first_time);
+    CHECK_EQ(completion.time[1] - start, first_time + second_time);
+    CHECK_EQ(bus.get_bus_time_us(), first_time + second_time);
+    // No conversion started yet, the ADC registers hold their reset value
+    CHECK_EQ(bmp280_burst_map::pressure::decode(bmp280_data), 0x80000);
+}
+
+static void test_rejected_lengths() {
+    SimI2cBus bus(I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    uint8_t data[I2C_BUS_MAX_TRANSFER + 1];
+    i2c_transaction_t empty = make_transaction(MPU_DEFAULT_I2C_ADDR, 0, data, 0, nullptr);
+    CHECK(!bus.submit(&empty));
+    CHECK_EQ(empty.status, I2C_TRANSACTION_ERROR);
+    i2c_transaction_t longest = make_transaction(MPU_DEFAULT_I2C_ADDR, 0, data, I2C_BUS_MAX_TRANSFER, nullptr);
+    longest.callback = nullptr;
+    CHECK(bus.submit(&longest));
+    drain(&bus);
+    // Accepted, then NACKed as nothing answers on this bus
+    CHECK_EQ(longest.status, I2C_TRANSACTION_ERROR);
+}
+
+// A NACK fails its own transaction only, the next one still runs
+static void test_nack_does_not_block_queue() {
+    SimI2cBus bus(I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimBMP280 sim_bmp280(0x76, 0);
+    bus.attach(&sim_bmp280);
+
+    completion_t completion = {};
+    uint8_t missing_data[2];
+    uint8_t bmp280_data[bmp280_burst_map::size];
+    i2c_transaction_t missing = make_transaction(0x77, 1, missing_data, sizeof(missing_data), &completion);
+    i2c_transaction_t present = make_transaction(0x76, 2, bmp280_data, sizeof(bmp280_data), &completion);
+    CHECK(bus.submit(&missing));
+    CHECK(bus.submit(&present));
+    drain(&bus);
+    CHECK_EQ(completion.count, 2);
+    CHECK_EQ(completion.status[0], I2C_TRANSACTION_ERROR);
+    CHECK_EQ(completion.status[1], I2C_TRANSACTION_DONE);
+}
+
+// A stuck transfer times out after timeout_us of its length, then the queue moves on
+static void test_stuck_transfer_times_out() {
+    SimI2cBus bus(I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimBMP280 sim_bmp280(0x76, 0);
+    bus.attach(&sim_bmp280);
+
+    completion_t completion = {};
+    uint8_t data[2][bmp280_burst_map::size];
+    i2c_transaction_t stuck = make_transaction(0x76, 1, data[0], bmp280_burst_map::size, &completion);
+    i2c_transaction_t next = make_transaction(0x76, 2, data[1], bmp280_burst_map::size, &completion);
+    bus.set_stuck(true);
+    uint64_t start = sdk_clock.now();
+    CHECK(bus.submit(&stuck));
+    CHECK(bus.submit(&next));
+
+    // The next transaction starts on the stuck bus as well, recover between the two
+    while (completion.count == 0) {
+        bus.poll();
+        sdk_clock.advance(1);
+    }
+    CHECK_EQ(completion.status[0], I2C_TRANSACTION_TIMEOUT);
+    CHECK_EQ(completion.time[0] - start, bus.timeout_us(bmp280_burst_map::size + 3));
+    bus.recover();
+    drain(&bus);
+    CHECK_EQ(completion.count, 2);
+    CHECK_EQ(completion.status[1], I2C_TRANSACTION_DONE);
+    CHECK_EQ(bus.get_recoveries(), 1);
+}
+
+// Host cost of the state machine around a transfer: submit, the polls that find it pending, completion
+static void test_state_machine_cost() {
+    SimI2cBus bus(I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimMPU6050 sim_mpu6050(MPU_DEFAULT_I2C_ADDR, 0);
+    bus.attach(&sim_mpu6050);
+
+    uint8_t data[mpu6050_burst_map::size];
+    i2c_transaction_t transaction = make_transaction(MPU_DEFAULT_I2C_ADDR, MPU_REG_ACCEL_XOUT_H, data, sizeof(data), nullptr);
+    transaction.callback = nullptr;
+    uint32_t transfer_time = SimI2cBus::read_time_us(I2C_FAST_MODE_BAUDRATE, sizeof(data));
+    uint32_t polls = 0;
+    double total_ns = 0;
+    for (uint32_t i = 0; i < 10000; i++) {
+        auto start = std::chrono::steady_clock::now();
+        bus.submit(&transaction);
+        // Ten pending polls over the transfer, the main loop is free in between
+        for (uint32_t j = 0; j < 10; j++) {
+            sdk_clock.advance(transfer_time / 10);
+            polls++;
+            if (!bus.poll()) break;
+        }
+        total_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        drain(&bus);
+        CHECK_EQ(transaction.status, I2C_TRANSACTION_DONE);
+    }
+    printf("submit + %.1f polls: %.1f host ns per %u us transfer\n", polls / 10000.0, total_ns / 10000, transfer_time);
+}
+
+int main() {
+    test_queue_order_and_timing();
+    test_rejected_lengths();
+    test_nack_does_not_block_queue();
+    test_stuck_transfer_times_out();
+    test_state_machine_cost();
+    return check_result();
+}
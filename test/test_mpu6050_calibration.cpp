@@ -0,0 +1,196 @@
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+
+// Gyro bias calibration on a still part, the temperature drift from two of them, and the
+// 6-position accel calibration
+
+#define CALIBRATION_SAMPLES 200
+
+// The registers hold the new values from the next sample on, 1ms at the default rate
+static void set_still(SimMPU6050* sim_mpu6050, vector3<int16_t> gyro, int16_t temp) {
+    sim_mpu6050->set_gyro(gyro);
+    sim_mpu6050->set_temp(temp);
+    sdk_clock.advance(1000);
+}
+
+static void test_single_calibration() {
+    SimMPU6050Fixture rig;
+    set_still(&rig.sim_mpu6050, {100, -50, 20}, -3000);
+
+    rig.mpu6050.calibrate(CALIBRATION_SAMPLES);
+    mpu6050_calibration_t calibration = rig.mpu6050.get_calibration();
+    CHECK_EQ(calibration.gyro_offset.x, 100);
+    CHECK_EQ(calibration.gyro_offset.y, -50);
+    CHECK_EQ(calibration.gyro_offset.z, 20);
+    CHECK_EQ(calibration.temp, -3000);
+    CHECK_EQ(calibration.gyro_temp_coeff_q16.x, 0);
+    CHECK(rig.mpu6050.verify_calibration(calibration, 16));
+}
+
+static void test_two_point_drift() {
+    SimMPU6050Fixture rig;
+
+    // 10degC apart, the x bias drifts by 60 counts (1.8dps) and z by -20
+    set_still(&rig.sim_mpu6050, {100, -50, 20}, -3000);
+    rig.mpu6050.calibrate(CALIBRATION_SAMPLES);
+    mpu6050_calibration_t first = rig.mpu6050.get_calibration();
+
+    set_still(&rig.sim_mpu6050, {160, -50, 0}, 400);
+    CHECK(!rig.mpu6050.verify_calibration(first, 16));
+    rig.mpu6050.calibrate(CALIBRATION_SAMPLES, &first);
+    mpu6050_calibration_t second = rig.mpu6050.get_calibration();
+    CHECK_EQ(second.gyro_temp_coeff_q16.x, 60 * 65536 / 3400);
+    CHECK_EQ(second.gyro_temp_coeff_q16.y, 0);
+    CHECK_EQ(second.gyro_temp_coeff_q16.z, -20 * 65536 / 3400);
+
+    // Halfway, the drift is removed from the samples and the stored calibration still holds
+    set_still(&rig.sim_mpu6050, {130, -50, 10}, -1300);
+    CHECK(rig.mpu6050.verify_calibration(second, 16));
+    CHECK_EQ(rig.mpu6050.update(), I2C_OK);
+    CHECK(abs(rig.mpu6050.data.gyro.x) <= 1);
+    CHECK_EQ(rig.mpu6050.data.gyro.y, 0);
+    CHECK(abs(rig.mpu6050.data.gyro.z) <= 1);
+
+    // Too close in temperature to tell, the previous drift is kept
+    set_still(&rig.sim_mpu6050, {130, -50, 10}, -1000);
+    rig.mpu6050.calibrate(CALIBRATION_SAMPLES, &second);
+    CHECK_EQ(rig.mpu6050.get_calibration().gyro_temp_coeff_q16.x, second.gyro_temp_coeff_q16.x);
+    CHECK_EQ(rig.mpu6050.get_calibration().gyro_temp_coeff_q16.z, second.gyro_temp_coeff_q16.z);
+}
+
+static void test_implausible_drift() {
+    SimMPU6050Fixture rig;
+
+    set_still(&rig.sim_mpu6050, {100, -50, 20}, 0);
+    rig.mpu6050.calibrate(CALIBRATION_SAMPLES);
+    mpu6050_calibration_t first = rig.mpu6050.get_calibration();
+
+    // 30dps over 5degC is no temperature drift
+    set_still(&rig.sim_mpu6050, {1084, -50, 20}, 1700);
+    rig.mpu6050.calibrate(CALIBRATION_SAMPLES, &first);
+    CHECK_EQ(rig.mpu6050.get_calibration().gyro_temp_coeff_q16.x, 0);
+    CHECK_EQ(rig.mpu6050.get_calibration().gyro_offset.x, 1084);
+
+    // A bias swing across most of the int16 range does not overflow the coefficient
+    set_still(&rig.sim_mpu6050, {-30000, -50, 20}, 0);
+    rig.mpu6050.calibrate(CALIBRATION_SAMPLES);
+    mpu6050_calibration_t low = rig.mpu6050.get_calibration();
+    set_still(&rig.sim_mpu6050, {30000, -50, 20}, 1700);
+    rig.mpu6050.calibrate(CALIBRATION_SAMPLES, &low);
+    CHECK_EQ(rig.mpu6050.get_calibration().gyro_temp_coeff_q16.x, 0);
+    CHECK_EQ(rig.mpu6050.get_calibration().gyro_offset.x, 30000);
+
+    // Nor is one taken at another scale
+    rig.mpu6050.set_gyro_scale(MPU6050_SCALE_2000DPS);
+    set_still(&rig.sim_mpu6050, {80, -50, 20}, -3400);
+    rig.mpu6050.calibrate(CALIBRATION_SAMPLES, &first);
+    CHECK_EQ(rig.mpu6050.get_calibration().gyro_temp_coeff_q16.x, 0);
+}
+
+// A part with these zero-g offsets and sensitivities, at 16g where 1g is 2048 counts
+static const vector3<int16_t> acc_offset = {30, -40, 60};
+static const float acc_gain[3] = {1.02f, 0.98f, 1.0f};
+
+// Rest the simulated part on a face: the axis pointing up reads +1g, down -1g
+static void set_face(SimMPU6050* sim_mpu6050, mpu6050_accel_position position) {
+    int16_t values[3] = {acc_offset.x, acc_offset.y, acc_offset.z};
+    uint8_t axis = position / 2;
+    int16_t one_g = (int16_t)(acc_gain[axis] * 2048 + 0.5f);
+    values[axis] += position % 2 ? -one_g : one_g;
+    sim_mpu6050->set_acc({values[0], values[1], values[2]});
+    sdk_clock.advance(1000);
+}
+
+static void test_accel_six_position() {
+    SimMPU6050Fixture rig;
+    rig.mpu6050.set_accel_range(MPU6050_RANGE_16G);
+
+    // Any order, a face taken twice replaces the first reading
+    const mpu6050_accel_position order[] = {MPU6050_ACCEL_Z_UP, MPU6050_ACCEL_X_DOWN, MPU6050_ACCEL_Y_UP,
+        MPU6050_ACCEL_Z_DOWN, MPU6050_ACCEL_Z_UP, MPU6050_ACCEL_X_UP, MPU6050_ACCEL_Y_DOWN};
+    rig.mpu6050.start_accel_calibration();
+    for (mpu6050_accel_position position : order) {
+        CHECK(!rig.mpu6050.is_accel_calibration_complete());
+        set_face(&rig.sim_mpu6050, position);
+        CHECK_EQ(rig.mpu6050.add_accel_position(CALIBRATION_SAMPLES), position);
+    }
+    CHECK(rig.mpu6050.is_accel_calibration_complete());
+    CHECK(rig.mpu6050.finish_accel_calibration());
+
+    mpu6050_calibration_t calibration = rig.mpu6050.get_calibration();
+    CHECK_EQ(calibration.acc_offset.x, 30);
+    CHECK_EQ(calibration.acc_offset.y, -40);
+    CHECK_EQ(calibration.acc_offset.z, 60);
+    CHECK(abs(calibration.acc_scale_q16.x - (int32_t)(65536 / 1.02f)) <= 64);
+    CHECK(abs(calibration.acc_scale_q16.y - (int32_t)(65536 / 0.98f)) <= 64);
+    CHECK_EQ(calibration.acc_scale_q16.z, 1 << 16);
+
+    // The samples now read 1g on the axis along gravity and 0g on the others
+    for (uint8_t position = MPU6050_ACCEL_X_UP; position < MPU6050_ACCEL_POSITION_NONE; position++) {
+        set_face(&rig.sim_mpu6050, (mpu6050_accel_position)position);
+        CHECK_EQ(rig.mpu6050.update(), I2C_OK);
+        int16_t expected[3] = {0, 0, 0};
+        expected[position / 2] = position % 2 ? -2048 : 2048;
+        CHECK(abs(rig.mpu6050.data.acc.x - expected[0]) <= 1);
+        CHECK(abs(rig.mpu6050.data.acc.y - expected[1]) <= 1);
+        CHECK(abs(rig.mpu6050.data.acc.z - expected[2]) <= 1);
+    }
+
+    // Stored and restored at the same range, ignored at another one
+    MPU6050 restored(MPU_DEFAULT_I2C_ADDR, 1000, &rig.bus);
+    restored.set_accel_range(MPU6050_RANGE_16G);
+    restored.set_calibration(calibration);
+    CHECK_EQ(restored.get_config().acc_offset.y, -40);
+    CHECK_EQ(restored.get_config().acc_scale_q16.x, calibration.acc_scale_q16.x);
+    restored.set_accel_range(MPU6050_RANGE_2G);
+    restored.set_calibration(calibration);
+    CHECK_EQ(restored.get_config().acc_offset.y, 0);
+    CHECK_EQ(restored.get_config().acc_scale_q16.x, 1 << 16);
+}
+
+static void test_accel_refused() {
+    SimMPU6050Fixture rig;
+    rig.mpu6050.set_accel_range(MPU6050_RANGE_16G);
+    rig.mpu6050.start_accel_calibration();
+
+    // Tilted by 45 degrees or in free fall, no axis is along gravity
+    rig.sim_mpu6050.set_acc({1448, 0, 1448});
+    sdk_clock.advance(1000);
+    CHECK_EQ(rig.mpu6050.add_accel_position(CALIBRATION_SAMPLES), MPU6050_ACCEL_POSITION_NONE);
+    rig.sim_mpu6050.set_acc({0, 0, 0});
+    sdk_clock.advance(1000);
+    CHECK_EQ(rig.mpu6050.add_accel_position(CALIBRATION_SAMPLES), MPU6050_ACCEL_POSITION_NONE);
+
+    // A face missing
+    for (uint8_t position = MPU6050_ACCEL_X_UP; position < MPU6050_ACCEL_Z_DOWN; position++) {
+        set_face(&rig.sim_mpu6050, (mpu6050_accel_position)position);
+        rig.mpu6050.add_accel_position(CALIBRATION_SAMPLES);
+    }
+    CHECK(!rig.mpu6050.is_accel_calibration_complete());
+    CHECK(!rig.mpu6050.finish_accel_calibration());
+
+    // 1.1g between the X faces, past the sensitivity tolerance: nothing applied
+    set_face(&rig.sim_mpu6050, MPU6050_ACCEL_Z_DOWN);
+    rig.mpu6050.add_accel_position(CALIBRATION_SAMPLES);
+    rig.sim_mpu6050.set_acc({30 + 2253, -40, 60});
+    sdk_clock.advance(1000);
+    CHECK_EQ(rig.mpu6050.add_accel_position(CALIBRATION_SAMPLES), MPU6050_ACCEL_X_UP);
+    rig.sim_mpu6050.set_acc({30 - 2253, -40, 60});
+    sdk_clock.advance(1000);
+    CHECK_EQ(rig.mpu6050.add_accel_position(CALIBRATION_SAMPLES), MPU6050_ACCEL_X_DOWN);
+    CHECK(rig.mpu6050.is_accel_calibration_complete());
+    CHECK(!rig.mpu6050.finish_accel_calibration());
+    CHECK_EQ(rig.mpu6050.get_config().acc_offset.x, 0);
+    CHECK_EQ(rig.mpu6050.get_config().acc_scale_q16.x, 1 << 16);
+}
+
+int main() {
+    test_single_calibration();
+    test_two_point_drift();
+    test_implausible_drift();
+    test_accel_six_position();
+    test_accel_refused();
+    return check_result();
+}
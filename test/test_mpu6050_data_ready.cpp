@@ -0,0 +1,91 @@
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+#include "i2c_scheduler.hpp"
+#include "hardware/sync.h"
+
+// Reads driven by the data ready interrupt: one read per pulse, stamped with the pulse time
+
+#define DATA_READY_GPIO 21
+
+static void data_ready_pulse() {
+    sdk_shim_gpio_irq(DATA_READY_GPIO, GPIO_IRQ_EDGE_RISE);
+}
+
+static void test_blocking_reads() {
+    SimMPU6050Fixture rig;
+    rig.mpu6050.enable_data_ready_interrupt(DATA_READY_GPIO);
+    CHECK(rig.mpu6050.is_interrupt_driven());
+
+    // No pulse, no transfer however long the wait
+    sdk_clock.advance(10000);
+    rig.bus.reset_stats();
+    CHECK_EQ(rig.mpu6050.update(), I2C_NOT_DUE);
+    CHECK_EQ(rig.bus.get_transfers(), 0);
+
+    // Past 2^32 us the timestamps still carry the high half
+    sdk_clock.advance_to(0x100000000ull + 5000);
+    uint64_t pulse_time = sdk_clock.now();
+    data_ready_pulse();
+    CHECK(rig.mpu6050.is_data_ready());
+    sdk_clock.advance(300);
+    CHECK_EQ(rig.mpu6050.update(), I2C_OK);
+    CHECK_EQ(rig.mpu6050.data.timestamp, pulse_time);
+    CHECK(!rig.mpu6050.is_data_ready());
+    CHECK_EQ(rig.mpu6050.update(), I2C_NOT_DUE);
+    CHECK_EQ(rig.mpu6050.get_data_ready_overruns(), 0);
+
+    // Two pulses before a read: one overrun, the read is stamped with the newest
+    data_ready_pulse();
+    sdk_clock.advance(1000);
+    pulse_time = sdk_clock.now();
+    data_ready_pulse();
+    CHECK_EQ(rig.mpu6050.get_data_ready_overruns(), 1);
+    CHECK_EQ(rig.mpu6050.update(), I2C_OK);
+    CHECK_EQ(rig.mpu6050.data.timestamp, pulse_time);
+
+    // A pulse while interrupts are masked around the timestamp is held until they are back, not lost
+    uint32_t interrupts = save_and_disable_interrupts();
+    data_ready_pulse();
+    CHECK(!rig.mpu6050.is_data_ready());
+    restore_interrupts(interrupts);
+    CHECK(rig.mpu6050.is_data_ready());
+    CHECK_EQ(rig.mpu6050.update(), I2C_OK);
+}
+
+// The scheduler starts an interrupt driven read on the pulse only, whatever the rate
+static void test_scheduled_reads() {
+    SimMPU6050Fixture rig;
+    rig.mpu6050.enable_data_ready_interrupt(DATA_READY_GPIO);
+
+    I2cScheduler scheduler(sdk_clock_now);
+    int slot = scheduler.add(&rig.mpu6050);
+    CHECK(slot >= 0);
+
+    rig.bus.reset_stats();
+    uint32_t updates = 0;
+    uint64_t last_pulse = 0;
+    uint64_t end = sdk_clock.now() + 100000;
+    while (sdk_clock.now() < end) {
+        // A pulse every 2ms, half the 1kHz read rate
+        if (sdk_clock.now() % 2000 == 0) {
+            last_pulse = sdk_clock.now();
+            data_ready_pulse();
+        }
+        if (scheduler.run() & (1u << slot)) {
+            updates++;
+            CHECK_EQ(rig.mpu6050.data.timestamp, last_pulse);
+        }
+        sdk_clock.advance(1);
+    }
+    CHECK(updates >= 49 && updates <= 50);
+    CHECK_EQ(rig.bus.get_transfers(), updates);
+    CHECK_EQ(rig.mpu6050.get_data_ready_overruns(), 0);
+}
+
+int main() {
+    test_blocking_reads();
+    test_scheduled_reads();
+    return check_result();
+}
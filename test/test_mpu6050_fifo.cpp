@@ -0,0 +1,47 @@
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+
+// Drain until a read brings samples back
+static i2c_status read_batch(MPU6050& mpu6050) {
+    for (uint32_t i = 0; i < 100000; i++) {
+        i2c_status status = mpu6050.update();
+        if (status != I2C_NOT_DUE) return status;
+        sdk_clock.advance(10);
+    }
+    return I2C_NOT_DUE;
+}
+
+static void test_overflow(uint8_t ext_length) {
+    // The BMP280 sits on the auxiliary bus of the MPU6050
+    SimBMP280 sim_bmp280(0x76, 0);
+    SimMPU6050Fixture rig;
+    rig.sim_mpu6050.attach_aux(&sim_bmp280);
+
+    if (ext_length) rig.mpu6050.enable_aux_slave(0x76, BMP280_REG_PRESSURE_MSB, ext_length);
+    rig.mpu6050.enable_fifo();
+
+    CHECK_EQ(read_batch(rig.mpu6050), I2C_OK);
+    CHECK(!rig.mpu6050.batch.overflow);
+    CHECK_EQ(rig.mpu6050.get_fifo_overflows(), 0);
+
+    // Nobody reads for 200 samples, the full FIFO drops its oldest records
+    sdk_clock.advance(200000);
+    CHECK_EQ(rig.mpu6050.update(), I2C_NOT_DUE);
+    CHECK_EQ(rig.mpu6050.get_fifo_overflows(), 1);
+
+    // Restarted from an empty FIFO, the next batch reports the loss
+    CHECK_EQ(read_batch(rig.mpu6050), I2C_OK);
+    CHECK(rig.mpu6050.batch.overflow);
+    CHECK(rig.mpu6050.batch.count > 0);
+    CHECK_EQ(read_batch(rig.mpu6050), I2C_OK);
+    CHECK(!rig.mpu6050.batch.overflow);
+}
+
+int main() {
+    // 14 bytes records do not divide the FIFO, 16 bytes ones (2 mirrored bytes) do
+    test_overflow(0);
+    test_overflow(2);
+    return check_result();
+}
@@ -0,0 +1,106 @@
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+
+// CONFIG and SMPLRT_DIV encodings of set_sample_rate, and the read pacing that follows from them
+
+static uint8_t read_register(SimI2cBus* bus, uint8_t reg) {
+    uint8_t value = 0;
+    CHECK_EQ(bus->read_register(MPU_DEFAULT_I2C_ADDR, reg, &value, 1), I2C_OK);
+    return value;
+}
+
+static void test_register_encodings() {
+    SimMPU6050Fixture rig;
+
+    // init keeps 1kHz with the 184Hz filter
+    CHECK_EQ(read_register(&rig.bus, MPU_REG_CONFIG), MPU6050_DLPF_184HZ);
+    CHECK_EQ(read_register(&rig.bus, MPU_REG_SMPLRT_DIV), 0);
+    CHECK_EQ(rig.mpu6050.get_config().sample_rate_hz, 1000);
+
+    const uint8_t dividers[] = {0, 1, 4, 7, 9, 255};
+    for (uint8_t dlpf = MPU6050_DLPF_260HZ; dlpf <= MPU6050_DLPF_5HZ; dlpf++) {
+        for (uint8_t divider : dividers) {
+            rig.mpu6050.set_sample_rate((mpu_6050_dlpf)dlpf, divider);
+            CHECK_EQ(read_register(&rig.bus, MPU_REG_CONFIG), dlpf);
+            CHECK_EQ(read_register(&rig.bus, MPU_REG_SMPLRT_DIV), divider);
+            uint32_t gyro_rate = dlpf == MPU6050_DLPF_260HZ ? 8000 : 1000;
+            CHECK_EQ(rig.mpu6050.get_config().dlpf, dlpf);
+            CHECK_EQ(rig.mpu6050.get_config().sample_rate_div, divider);
+            CHECK_EQ(rig.mpu6050.get_config().sample_rate_hz, gyro_rate / (1 + divider));
+        }
+    }
+}
+
+// Polled reads never outrun the output data rate: every read brings a new sample, one period apart
+static void test_polled_pacing() {
+    SimMPU6050Fixture rig(100);
+    rig.mpu6050.set_sample_rate(MPU6050_DLPF_44HZ, 9);
+    CHECK_EQ(rig.mpu6050.get_freq(), 100);
+
+    uint32_t reads = 0;
+    uint32_t repeated = 0;
+    vector3<int16_t> previous = {0, 0, 0};
+    uint64_t end = sdk_clock.now() + 1000000;
+    while (sdk_clock.now() < end) {
+        if (rig.mpu6050.update() == I2C_OK) {
+            reads++;
+            const vector3<int16_t>& gyro = rig.mpu6050.data.gyro;
+            if (gyro.x == previous.x && gyro.y == previous.y && gyro.z == previous.z) repeated++;
+            previous = gyro;
+        }
+        sdk_clock.advance(10);
+    }
+    CHECK(reads >= 99 && reads <= 101);
+    CHECK_EQ(repeated, 0);
+}
+
+// FIFO reads twice per batch worth of samples, the timestamps are exactly one divided period apart
+static void test_fifo_pacing() {
+    SimMPU6050Fixture rig(100);
+    rig.mpu6050.enable_fifo();
+    // 8kHz / 24, 333Hz
+    rig.mpu6050.set_sample_rate(MPU6050_DLPF_260HZ, 23);
+    CHECK_EQ(rig.mpu6050.get_config().sample_rate_hz, 333);
+    CHECK_EQ(rig.mpu6050.get_freq(), 2 * 333 / MPU_FIFO_BATCH_SAMPLES);
+
+    uint32_t samples = 0;
+    uint32_t misspaced = 0;
+    uint64_t previous = 0;
+    uint64_t end = sdk_clock.now() + 1000000;
+    while (sdk_clock.now() < end) {
+        if (rig.mpu6050.update() == I2C_OK) {
+            for (uint8_t i = 0; i < rig.mpu6050.batch.count; i++) {
+                uint64_t timestamp = rig.mpu6050.batch.samples[i].timestamp;
+                if (previous != 0 && timestamp - previous != 3000) misspaced++;
+                previous = timestamp;
+            }
+            samples += rig.mpu6050.batch.count;
+        }
+        sdk_clock.advance(10);
+    }
+    CHECK(samples >= 333 - MPU_FIFO_BATCH_SAMPLES && samples <= 334);
+    CHECK_EQ(misspaced, 0);
+    CHECK_EQ(rig.mpu6050.get_fifo_overflows(), 0);
+}
+
+// A re-init goes back to 1kHz and to the rate asked for at construction, not to a clamped one
+static void test_reinit_keeps_requested_rate() {
+    SimMPU6050Fixture rig(0, 500);
+    CHECK_EQ(rig.mpu6050.get_freq(), 500);
+
+    rig.mpu6050.set_sample_rate(MPU6050_DLPF_44HZ, 9);
+    CHECK_EQ(rig.mpu6050.get_freq(), 100);
+    rig.mpu6050.init();
+    CHECK_EQ(rig.mpu6050.get_config().sample_rate_hz, 1000);
+    CHECK_EQ(rig.mpu6050.get_freq(), 500);
+}
+
+int main() {
+    test_register_encodings();
+    test_polled_pacing();
+    test_fifo_pacing();
+    test_reinit_keeps_requested_rate();
+    return check_result();
+}
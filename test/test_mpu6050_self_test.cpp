@@ -0,0 +1,108 @@
+#include <cstdlib>
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+
+// The self-test state machine stepped on the simulated clock, against the factory trims of the
+// simulated part and against axes whose response was broken
+
+#define SELF_TEST_STEP_US 100
+// Two settle times and two rounds of samples at 1kHz, with room for the transfers
+#define SELF_TEST_DEADLINE_US (2 * MPU_SELF_TEST_SETTLE_US + 2 * MPU_SELF_TEST_SAMPLES * 1000 + 20000)
+
+static uint8_t read_register(SimI2cBus* bus, uint8_t reg) {
+    uint8_t value = 0;
+    CHECK_EQ(bus->read_register(MPU_DEFAULT_I2C_ADDR, reg, &value, 1), I2C_OK);
+    return value;
+}
+
+// Steps the test like the init code does between its other work, returns the number of steps
+static uint32_t run_self_test(MPU6050& mpu6050) {
+    uint64_t deadline = sdk_clock.now() + SELF_TEST_DEADLINE_US;
+    uint32_t steps = 0;
+    mpu6050.start_self_test();
+    while (mpu6050.step_self_test() != MPU6050_SELF_TEST_DONE && sdk_clock.now() < deadline) {
+        sdk_clock.advance(SELF_TEST_STEP_US);
+        steps++;
+    }
+    CHECK_EQ(mpu6050.get_self_test().state, MPU6050_SELF_TEST_DONE);
+    return steps;
+}
+
+static void test_healthy_part(uint32_t noise) {
+    SimMPU6050Fixture rig(noise);
+    rig.mpu6050.set_accel_range(MPU6050_RANGE_16G);
+    rig.mpu6050.set_gyro_scale(MPU6050_SCALE_1000DPS);
+
+    uint64_t start = sdk_clock.now();
+    run_self_test(rig.mpu6050);
+    // Never done before both settle times
+    CHECK(sdk_clock.now() - start >= 2 * MPU_SELF_TEST_SETTLE_US);
+
+    // The simulated response is the factory trim truncated to counts, the noise averages out
+    const mpu6050_self_test_t& result = rig.mpu6050.get_self_test();
+    CHECK(result.passed);
+    const int16_t deviations[] = {result.acc_deviation.x, result.acc_deviation.y, result.acc_deviation.z,
+        result.gyro_deviation.x, result.gyro_deviation.y, result.gyro_deviation.z};
+    for (int16_t deviation : deviations) CHECK(abs(deviation) <= 2);
+
+    // Scale and range are back to what was set before the test
+    CHECK_EQ(read_register(&rig.bus, MPU_REG_GYRO_CONFIG), MPU6050_SCALE_1000DPS << 3);
+    CHECK_EQ(read_register(&rig.bus, MPU_REG_ACCEL_CONFIG), MPU6050_RANGE_16G << 3);
+}
+
+// Once done the state machine stays put and reads nothing
+static void test_done_is_idle() {
+    SimMPU6050Fixture rig;
+    CHECK_EQ(rig.mpu6050.step_self_test(), MPU6050_SELF_TEST_IDLE);
+
+    run_self_test(rig.mpu6050);
+    uint32_t transfers = rig.bus.get_transfers();
+    for (uint8_t i = 0; i < 10; i++) {
+        sdk_clock.advance(1000);
+        CHECK_EQ(rig.mpu6050.step_self_test(), MPU6050_SELF_TEST_DONE);
+    }
+    CHECK_EQ(rig.bus.get_transfers(), transfers);
+}
+
+// One axis responding with response_percent of its trim, the others healthy
+static void test_broken_axis(bool gyro, uint8_t axis, int32_t response_percent) {
+    SimMPU6050Fixture rig;
+
+    // Same trims as the simulated SELF_TEST_* codes
+    vector3<int16_t> acc = {(int16_t)MPU6050::accel_factory_trim(17), (int16_t)MPU6050::accel_factory_trim(14), (int16_t)MPU6050::accel_factory_trim(19)};
+    vector3<int16_t> gyro_response = {(int16_t)MPU6050::gyro_factory_trim(14), (int16_t)-MPU6050::gyro_factory_trim(15), (int16_t)MPU6050::gyro_factory_trim(16)};
+    int16_t* broken = gyro ? (axis == 0 ? &gyro_response.x : axis == 1 ? &gyro_response.y : &gyro_response.z)
+        : (axis == 0 ? &acc.x : axis == 1 ? &acc.y : &acc.z);
+    *broken = (int16_t)(*broken * response_percent / 100);
+    rig.sim_mpu6050.set_self_test_response(acc, gyro_response);
+
+    run_self_test(rig.mpu6050);
+    const mpu6050_self_test_t& result = rig.mpu6050.get_self_test();
+    CHECK(!result.passed);
+
+    const vector3<int16_t>& deviations = gyro ? result.gyro_deviation : result.acc_deviation;
+    const vector3<int16_t>& healthy = gyro ? result.acc_deviation : result.gyro_deviation;
+    const int16_t values[] = {deviations.x, deviations.y, deviations.z};
+    for (uint8_t i = 0; i < 3; i++) {
+        if (i == axis) {
+            CHECK(abs(values[i] - (response_percent - 100)) <= 2);
+        } else {
+            CHECK(abs(values[i]) <= 2);
+        }
+    }
+    CHECK(abs(healthy.x) <= 2 && abs(healthy.y) <= 2 && abs(healthy.z) <= 2);
+}
+
+int main() {
+    test_healthy_part(0);
+    test_healthy_part(20);
+    test_done_is_idle();
+    // Dead, weak and overdriven axes, just out of the tolerance for the last two
+    test_broken_axis(false, 0, 0);
+    test_broken_axis(false, 2, 100 - MPU_SELF_TEST_TOLERANCE_PERCENT - 4);
+    test_broken_axis(true, 1, 0);
+    test_broken_axis(true, 2, 100 + MPU_SELF_TEST_TOLERANCE_PERCENT + 4);
+    return check_result();
+}
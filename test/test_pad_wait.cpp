@@ -0,0 +1,81 @@
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+#include "gyro_bias_estimator.hpp"
+
+#define MOTION_GPIO 7
+
+// The pad wait gyro window of main.cpp: gyros on, start-up skipped, one estimator window fed
+static uint16_t gyro_window(MPU6050& mpu6050, GyroBiasEstimator& gyro_bias) {
+    mpu6050.set_motion_wakeup_gyro(true);
+    uint64_t settled = sdk_clock.now() + 30000;
+    gyro_bias.reset_window();
+
+    uint16_t samples = 0;
+    while (samples < GYRO_BIAS_WINDOW_SAMPLES && !mpu6050.is_motion_detected()) {
+        sdk_clock.advance(10);
+        if (mpu6050.update() != I2C_OK) continue;
+        for (uint8_t i = 0; i < mpu6050.batch.count && samples < GYRO_BIAS_WINDOW_SAMPLES; i++) {
+            if (mpu6050.batch.samples[i].timestamp < settled) continue;
+            if (gyro_bias.add_sample(mpu6050.batch.samples[i].acc, mpu6050.batch.samples[i].gyro)) mpu6050.set_gyro_offset(gyro_bias.get_bias());
+            samples++;
+        }
+    }
+    mpu6050.set_motion_wakeup_gyro(false);
+    return samples;
+}
+
+static void test_bias_tracked_during_wait() {
+    SimMPU6050Fixture rig(3);
+    rig.sim_mpu6050.set_acc({0, 0, 16384});
+    rig.sim_mpu6050.set_gyro({40, -24, 8});
+
+    rig.mpu6050.enable_fifo();
+    GyroBiasEstimator gyro_bias(rig.mpu6050.get_config().dps_per_digit, rig.mpu6050.get_config().range_per_digit, {0, 0, 0});
+    rig.mpu6050.enable_motion_wakeup(MOTION_GPIO, 100, 2, MPU6050_WAKE_5HZ);
+
+    // In cycle mode the gyros are off, whatever is read there says nothing about their bias
+    sdk_clock.advance(20000);
+    CHECK_EQ(rig.mpu6050.update(), I2C_OK);
+    CHECK_EQ(rig.mpu6050.data.gyro.x, 0);
+
+    // Every window brings the bias 1/16 closer
+    for (uint8_t i = 0; i < 64; i++) {
+        CHECK_EQ(gyro_window(rig.mpu6050, gyro_bias), GYRO_BIAS_WINDOW_SAMPLES);
+        sdk_clock.advance(10000000);
+    }
+    vector3<int16_t> bias = gyro_bias.get_bias();
+    CHECK(bias.x >= 39 && bias.x <= 41);
+    CHECK(bias.y >= -25 && bias.y <= -23);
+    CHECK(bias.z >= 7 && bias.z <= 9);
+    CHECK_EQ(gyro_bias.get_still_windows(), 64);
+
+    // A motion interrupt ends the window early and keeps its own timestamp
+    uint64_t motion_time = sdk_clock.now();
+    sdk_shim_gpio_irq(MOTION_GPIO, GPIO_IRQ_EDGE_RISE);
+    CHECK(rig.mpu6050.is_motion_detected());
+    sdk_clock.advance(500);
+    CHECK_EQ(gyro_window(rig.mpu6050, gyro_bias), 0);
+    CHECK_EQ(rig.mpu6050.get_motion_time(), motion_time);
+    rig.mpu6050.disable_motion_wakeup();
+}
+
+static void test_speeds_follow_clock_changes() {
+    HardwareI2cBus* bus = HardwareI2cBus::get(i2c0);
+    sdk_clk_peri_hz = 125000000;
+    bus->init(I2C_FAST_MODE_BAUDRATE, 4, 5);
+
+    // The divider computed at 125MHz gives 153kHz at 48MHz, the target is applied again instead
+    sdk_clk_peri_hz = 48000000;
+    CHECK_EQ(bus->reapply_baudrate(), 400000);
+    sdk_clk_peri_hz = 125000000;
+    CHECK_EQ(bus->reapply_baudrate(), 399361);
+    CHECK_EQ(bus->get_target_baudrate(), I2C_FAST_MODE_BAUDRATE);
+}
+
+int main() {
+    test_bias_tracked_during_wait();
+    test_speeds_follow_clock_changes();
+    return check_result();
+}
@@ -0,0 +1,134 @@
+#include <cstring>
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_pio_i2c_bus.hpp"
+#include "i2c_scheduler.hpp"
+
+// The PIO I2C command streams run against the register models, and the drivers unchanged on a
+// PIO bus next to the two hardware ones
+
+static void wake(I2cBus* bus, uint8_t addr) {
+    uint8_t data[2] = {MPU_REG_PWR_MGMT_1, 0};
+    CHECK_EQ(bus->write(addr, data, sizeof(data)), I2C_OK);
+    sdk_clock.advance(1000);
+}
+
+// Start, address, register, repeated start, address, data with the last byte NAKed, stop
+static void test_read_register_stream() {
+    SimPioI2cBus bus(pio0, 0, I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimMPU6050 sim_mpu6050(MPU_DEFAULT_I2C_ADDR, 0);
+    bus.attach(&sim_mpu6050);
+
+    PioI2C pio_i2c(pio1, 0, 2, 3, I2C_FAST_MODE_BAUDRATE);
+    uint16_t cmd[PioI2C::readRegisterLength(2)];
+    uint count = pio_i2c.buildReadRegister(cmd, MPU_DEFAULT_I2C_ADDR, MPU_REG_WHO_AM_I, 2);
+    CHECK_EQ(count, PioI2C::readRegisterLength(2));
+
+    uint8_t rx[2 + PioI2C::READ_REGISTER_ECHO];
+    uint32_t duration;
+    CHECK_EQ(bus.execute(cmd, count, rx, sizeof(rx), sdk_clock.now(), &duration), I2C_OK);
+    // Every clocked byte is echoed: address + W, register, address + R, then the data
+    CHECK_EQ(rx[0], MPU_DEFAULT_I2C_ADDR << 1);
+    CHECK_EQ(rx[1], MPU_REG_WHO_AM_I);
+    CHECK_EQ(rx[2], (MPU_DEFAULT_I2C_ADDR << 1) | 1);
+    CHECK_EQ(rx[3], MPU_DEFAULT_I2C_ADDR);
+
+    // A missing slave NAKs its address and stops the machine after the first byte
+    rx[1] = 0;
+    CHECK_EQ(bus.execute(cmd, pio_i2c.buildReadRegister(cmd, MPU_AD0_I2C_ADDR, MPU_REG_WHO_AM_I, 2), rx, sizeof(rx), sdk_clock.now(), &duration), I2C_NACK);
+    CHECK_EQ(rx[0], MPU_AD0_I2C_ADDR << 1);
+    CHECK_EQ(rx[1], 0);
+}
+
+static void test_write_stream() {
+    SimPioI2cBus bus(pio0, 0, I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimMPU6050 sim_mpu6050(MPU_DEFAULT_I2C_ADDR, 0);
+    bus.attach(&sim_mpu6050);
+
+    PioI2C pio_i2c(pio1, 0, 2, 3, I2C_FAST_MODE_BAUDRATE);
+    uint8_t data[2] = {MPU_REG_PWR_MGMT_1, 0x01};
+    uint16_t cmd[PioI2C::writeLength(sizeof(data))];
+    CHECK_EQ(pio_i2c.buildWrite(cmd, MPU_DEFAULT_I2C_ADDR, data, sizeof(data)), PioI2C::writeLength(sizeof(data)));
+
+    uint8_t value = 0;
+    CHECK_EQ(bus.write(MPU_DEFAULT_I2C_ADDR, data, sizeof(data)), I2C_OK);
+    CHECK_EQ(bus.read_register(MPU_DEFAULT_I2C_ADDR, MPU_REG_PWR_MGMT_1, &value, 1), I2C_OK);
+    CHECK_EQ(value, 0x01);
+    CHECK_EQ(bus.write(MPU_AD0_I2C_ADDR, data, sizeof(data)), I2C_NACK);
+}
+
+// Same bytes and within 10% of the bus time of the hardware controller
+static void test_matches_hardware_bus() {
+    SimI2cBus hardware_bus(I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimPioI2cBus pio_bus(pio0, 0, I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimMPU6050 hardware_mpu6050(MPU_DEFAULT_I2C_ADDR, 0);
+    SimMPU6050 pio_mpu6050(MPU_DEFAULT_I2C_ADDR, 0);
+    hardware_bus.attach(&hardware_mpu6050);
+    pio_bus.attach(&pio_mpu6050);
+    hardware_mpu6050.set_acc({-1234, 567, 2048});
+    pio_mpu6050.set_acc({-1234, 567, 2048});
+    wake(&hardware_bus, MPU_DEFAULT_I2C_ADDR);
+    wake(&pio_bus, MPU_DEFAULT_I2C_ADDR);
+
+    uint8_t hardware_data[mpu6050_burst_map::size];
+    uint8_t pio_data[mpu6050_burst_map::size];
+    hardware_bus.reset_stats();
+    pio_bus.reset_stats();
+    CHECK_EQ(hardware_bus.read_register(MPU_DEFAULT_I2C_ADDR, MPU_REG_ACCEL_XOUT_H, hardware_data, sizeof(hardware_data)), I2C_OK);
+    CHECK_EQ(pio_bus.read_register(MPU_DEFAULT_I2C_ADDR, MPU_REG_ACCEL_XOUT_H, pio_data, sizeof(pio_data)), I2C_OK);
+    CHECK(memcmp(hardware_data, pio_data, sizeof(pio_data)) == 0);
+    CHECK_EQ(mpu6050_burst_map::acc_x::decode(pio_data), -1234);
+
+    printf("14 bytes read at 400kHz: hardware %llu us, PIO %llu us\n", (unsigned long long)hardware_bus.get_bus_time_us(), (unsigned long long)pio_bus.get_bus_time_us());
+    CHECK(pio_bus.get_bus_time_us() * 10 >= hardware_bus.get_bus_time_us() * 9);
+    CHECK(pio_bus.get_bus_time_us() * 10 <= hardware_bus.get_bus_time_us() * 11);
+}
+
+// A second MPU6050 on the PIO bus, the drivers and the scheduler as they are on the hardware buses
+static void test_third_bus() {
+    SimI2cBus bus0(I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimI2cBus bus1(I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimPioI2cBus bus2(pio0, 0, I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimMPU6050 sim_mpu6050(MPU_DEFAULT_I2C_ADDR, 0);
+    SimBMP280 sim_bmp280(0x76, 0);
+    SimMPU6050 sim_second_mpu6050(MPU_AD0_I2C_ADDR, 0);
+    sim_second_mpu6050.set_acc({0, 0, -2048});
+    bus0.attach(&sim_mpu6050);
+    bus1.attach(&sim_bmp280);
+    bus2.attach(&sim_second_mpu6050);
+
+    MPU6050 mpu6050(MPU_DEFAULT_I2C_ADDR, 1000, &bus0);
+    BMP280 bmp280(0x76, &bus1);
+    MPU6050 second_mpu6050(MPU_AD0_I2C_ADDR, 1000, &bus2);
+    second_mpu6050.enable_fifo();
+
+    I2cScheduler scheduler(sdk_clock_now);
+    int mpu6050_slot = scheduler.add(&mpu6050);
+    int bmp280_slot = scheduler.add(&bmp280);
+    int second_slot = scheduler.add(&second_mpu6050);
+
+    uint32_t samples = 0, second_samples = 0, bmp280_results = 0;
+    uint64_t end = sdk_clock.now() + 100000;
+    while (sdk_clock.now() < end) {
+        uint32_t updated = scheduler.run();
+        if (updated & (1u << mpu6050_slot)) samples++;
+        if (updated & (1u << second_slot)) second_samples += second_mpu6050.batch.count;
+        if ((updated & (1u << bmp280_slot)) && bmp280.data.fresh) bmp280_results++;
+        sdk_clock.advance(10);
+    }
+    CHECK(samples >= 99);
+    CHECK(second_samples >= 100 - MPU_FIFO_BATCH_SAMPLES);
+    CHECK(bmp280_results >= 1);
+    CHECK_EQ(second_mpu6050.batch.samples[0].acc.z, -2048);
+    CHECK_EQ(second_mpu6050.get_fifo_overflows(), 0);
+    CHECK_EQ(bmp280.data.pressure, 25767233);
+}
+
+int main() {
+    test_read_register_stream();
+    test_write_stream();
+    test_matches_hardware_bus();
+    test_third_bus();
+    return check_result();
+}
@@ -0,0 +1,125 @@
+#include <cstring>
+#include "check.hpp"
+#include "MPU6050.hpp"
+#include "BMP280.hpp"
+
+// Every value of the 8 and 16 bits fields, every value of the 20 bits ones, against a decode
+// written from the datasheets. A field must leave the bytes around it alone.
+
+#define SENTINEL 0xA5
+
+template <class Field>
+static int32_t hand_decode(const uint8_t* buf) {
+    const uint8_t* field = buf + Field::offset;
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < Field::bytes; i++) value = (value << 8) | field[i];
+    return (int32_t)value;
+}
+
+// Sensor bytes of a 16 bits field are hi, lo when MSB first and lo, hi when LSB first
+template <class Field, bool MsbFirst>
+static void check_field_16(const char* name) {
+    uint8_t buf[32];
+    uint8_t encoded[32];
+    uint32_t failures = 0;
+    for (uint32_t value = 0; value <= 0xFFFF; value++) {
+        memset(buf, SENTINEL, sizeof(buf));
+        buf[Field::offset + (MsbFirst ? 0 : 1)] = (uint8_t)(value >> 8);
+        buf[Field::offset + (MsbFirst ? 1 : 0)] = (uint8_t)value;
+        int32_t expected = std::is_signed<typename Field::value_type>::value ? (int32_t)(int16_t)value : (int32_t)value;
+        if ((int32_t)Field::decode(buf) != expected) failures++;
+
+        memset(encoded, SENTINEL, sizeof(encoded));
+        Field::encode(Field::decode(buf), encoded);
+        if (memcmp(buf, encoded, sizeof(buf)) != 0) failures++;
+    }
+    if (failures) printf("%s: %u mismatches\n", name, failures);
+    CHECK_EQ(failures, 0);
+}
+
+// 20 bits left aligned in msb, lsb, xlsb[7:4], the low nibble of xlsb is not part of the value
+template <class Field>
+static void check_field_20(const char* name) {
+    uint8_t buf[8];
+    uint8_t encoded[8];
+    uint32_t failures = 0;
+    for (uint32_t value = 0; value < (1u << 20); value++) {
+        memset(buf, SENTINEL, sizeof(buf));
+        buf[Field::offset] = (uint8_t)(value >> 12);
+        buf[Field::offset + 1] = (uint8_t)(value >> 4);
+        buf[Field::offset + 2] = (uint8_t)((value << 4) | (value & 0xF));
+        if (Field::decode(buf) != value) failures++;
+
+        memset(encoded, SENTINEL, sizeof(encoded));
+        Field::encode(Field::decode(buf), encoded);
+        encoded[Field::offset + 2] |= value & 0xF;
+        if (memcmp(buf, encoded, sizeof(buf)) != 0) failures++;
+    }
+    if (failures) printf("%s: %u mismatches\n", name, failures);
+    CHECK_EQ(failures, 0);
+}
+
+static void test_mpu6050_maps() {
+    check_field_16<mpu6050_burst_map::acc_x, true>("burst acc_x");
+    check_field_16<mpu6050_burst_map::acc_y, true>("burst acc_y");
+    check_field_16<mpu6050_burst_map::acc_z, true>("burst acc_z");
+    check_field_16<mpu6050_burst_map::temp, true>("burst temp");
+    check_field_16<mpu6050_burst_map::gyro_x, true>("burst gyro_x");
+    check_field_16<mpu6050_burst_map::gyro_y, true>("burst gyro_y");
+    check_field_16<mpu6050_burst_map::gyro_z, true>("burst gyro_z");
+    check_field_16<mpu6050_fifo_count_map::count, true>("fifo count");
+
+    // Register order of the burst, from MPU_REG_ACCEL_XOUT_H
+    uint8_t burst[mpu6050_burst_map::size] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x8D, 0x0E};
+    CHECK_EQ(mpu6050_burst_map::acc_x::decode(burst), 0x0102);
+    CHECK_EQ(mpu6050_burst_map::acc_z::decode(burst), 0x0506);
+    CHECK_EQ(mpu6050_burst_map::temp::decode(burst), 0x0708);
+    CHECK_EQ(mpu6050_burst_map::gyro_x::decode(burst), 0x090A);
+    CHECK_EQ(mpu6050_burst_map::gyro_z::decode(burst), (int16_t)0x8D0E);
+}
+
+static void test_bmp280_maps() {
+    check_field_16<bmp280_calib_map::dig_T1, false>("calib dig_T1");
+    check_field_16<bmp280_calib_map::dig_T2, false>("calib dig_T2");
+    check_field_16<bmp280_calib_map::dig_T3, false>("calib dig_T3");
+    check_field_16<bmp280_calib_map::dig_P1, false>("calib dig_P1");
+    check_field_16<bmp280_calib_map::dig_P2, false>("calib dig_P2");
+    check_field_16<bmp280_calib_map::dig_P3, false>("calib dig_P3");
+    check_field_16<bmp280_calib_map::dig_P4, false>("calib dig_P4");
+    check_field_16<bmp280_calib_map::dig_P5, false>("calib dig_P5");
+    check_field_16<bmp280_calib_map::dig_P6, false>("calib dig_P6");
+    check_field_16<bmp280_calib_map::dig_P7, false>("calib dig_P7");
+    check_field_16<bmp280_calib_map::dig_P8, false>("calib dig_P8");
+    check_field_16<bmp280_calib_map::dig_P9, false>("calib dig_P9");
+
+    check_field_20<bmp280_burst_map::pressure>("burst pressure");
+    check_field_20<bmp280_burst_map::temp>("burst temp");
+
+    // Datasheet example calibration as it sits in registers 0x88 to 0x9F
+    uint8_t calib[bmp280_calib_map::size] = {
+        0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC, 0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B,
+        0x27, 0x0B, 0x8C, 0x00, 0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6, 0x70, 0x17};
+    CHECK_EQ(bmp280_calib_map::dig_T1::decode(calib), 27504);
+    CHECK_EQ(bmp280_calib_map::dig_T2::decode(calib), 26435);
+    CHECK_EQ(bmp280_calib_map::dig_T3::decode(calib), -1000);
+    CHECK_EQ(bmp280_calib_map::dig_P1::decode(calib), 36477);
+    CHECK_EQ(bmp280_calib_map::dig_P2::decode(calib), -10685);
+    CHECK_EQ(bmp280_calib_map::dig_P3::decode(calib), 3024);
+    CHECK_EQ(bmp280_calib_map::dig_P4::decode(calib), 2855);
+    CHECK_EQ(bmp280_calib_map::dig_P5::decode(calib), 140);
+    CHECK_EQ(bmp280_calib_map::dig_P6::decode(calib), -7);
+    CHECK_EQ(bmp280_calib_map::dig_P7::decode(calib), 15500);
+    CHECK_EQ(bmp280_calib_map::dig_P8::decode(calib), -14600);
+    CHECK_EQ(bmp280_calib_map::dig_P9::decode(calib), 6000);
+
+    // Datasheet example ADC values, 415148 and 519888, from 0xF7
+    uint8_t burst[bmp280_burst_map::size] = {0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00};
+    CHECK_EQ(bmp280_burst_map::pressure::decode(burst), 415148);
+    CHECK_EQ(bmp280_burst_map::temp::decode(burst), 519888);
+}
+
+int main() {
+    test_mpu6050_maps();
+    test_bmp280_maps();
+    return check_result();
+}
@@ -0,0 +1,79 @@
+#include "check.hpp"
+#include "sdk_shim.hpp"
+#include "sim_i2c_bus.hpp"
+#include "sim_fixture.hpp"
+
+static void test_drivers_on_models() {
+    SimSensorsFixture rig;
+    CHECK(rig.mpu6050.test_connection());
+    CHECK(rig.bmp280.test_connection());
+
+    // A missing slave NACKs its address
+    MPU6050 missing(MPU_AD0_I2C_ADDR, 1000, &rig.bus);
+    CHECK(!missing.test_connection());
+}
+
+static void test_blocking_transfer_advances_clock() {
+    SimClock clock;
+    SimI2cBus bus(I2C_FAST_MODE_BAUDRATE, &clock);
+    SimMPU6050 sim_mpu6050(MPU_DEFAULT_I2C_ADDR, 0);
+    bus.attach(&sim_mpu6050);
+
+    uint8_t data[14];
+    uint64_t start = clock.now();
+    CHECK_EQ(bus.read_register(MPU_DEFAULT_I2C_ADDR, MPU_REG_ACCEL_XOUT_H, data, sizeof(data)), I2C_OK);
+    CHECK_EQ(clock.now() - start, SimI2cBus::read_time_us(I2C_FAST_MODE_BAUDRATE, 14));
+    CHECK_EQ(bus.get_bus_time_us(), SimI2cBus::read_time_us(I2C_FAST_MODE_BAUDRATE, 14));
+}
+
+static void test_async_transfer_follows_clock() {
+    SimI2cBus bus(I2C_FAST_MODE_BAUDRATE, &sdk_clock);
+    SimMPU6050 sim_mpu6050(MPU_DEFAULT_I2C_ADDR, 0);
+    bus.attach(&sim_mpu6050);
+    // Out of sleep, the part powers up with it set
+    uint8_t wake[2] = {MPU_REG_PWR_MGMT_1, 0};
+    CHECK_EQ(bus.write(MPU_DEFAULT_I2C_ADDR, wake, sizeof(wake)), I2C_OK);
+    sdk_clock.advance(1000);
+
+    uint8_t data[14];
+    i2c_transaction_t transaction = {};
+    transaction.addr = MPU_DEFAULT_I2C_ADDR;
+    transaction.reg = MPU_REG_ACCEL_XOUT_H;
+    transaction.data = data;
+    transaction.len = sizeof(data);
+    uint64_t start = sdk_clock.now();
+    CHECK(bus.submit(&transaction));
+
+    // Nothing completes until the simulated clock has moved past the transfer time
+    CHECK(bus.poll());
+    CHECK_EQ(transaction.status, I2C_TRANSACTION_PENDING);
+    sdk_clock.advance_to(start + SimI2cBus::read_time_us(I2C_FAST_MODE_BAUDRATE, 14) - 1);
+    CHECK(bus.poll());
+    sdk_clock.advance_to(start + SimI2cBus::read_time_us(I2C_FAST_MODE_BAUDRATE, 14));
+    CHECK(!bus.poll());
+    CHECK_EQ(transaction.status, I2C_TRANSACTION_DONE);
+    CHECK_EQ(mpu6050_burst_map::acc_z::decode(data), 2048);
+}
+
+static void test_sample_rate_follows_clock() {
+    SimMPU6050Fixture rig;
+    rig.mpu6050.enable_fifo();
+
+    // 1kHz output data rate, read twice per batch: at most a batch is still in the FIFO at the end
+    uint64_t end = sdk_clock.now() + 100000;
+    uint32_t samples = 0;
+    while (sdk_clock.now() < end) {
+        if (rig.mpu6050.update() == I2C_OK) samples += rig.mpu6050.batch.count;
+        sdk_clock.advance(10);
+    }
+    CHECK(samples >= 100 - MPU_FIFO_BATCH_SAMPLES && samples <= 101);
+    CHECK_EQ(rig.mpu6050.get_fifo_overflows(), 0);
+}
+
+int main() {
+    test_drivers_on_models();
+    test_blocking_transfer_advances_clock();
+    test_async_transfer_follows_clock();
+    test_sample_rate_follows_clock();
+    return check_result();
+}